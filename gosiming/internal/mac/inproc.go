@@ -1,6 +1,6 @@
 package mac
 
-import "fmt"
+import "sync"
 
 // InProcMacFunc In process MAC function type
 type InProcMacFunc func(deveui string, endpoint string)
@@ -8,19 +8,83 @@ type InProcMacFunc func(deveui string, endpoint string)
 // InProcMac MAC is running in a different process
 type InProcMac struct {
 	macBackend
-	f InProcMacFunc
+	f       InProcMacFunc
+	mux     sync.Mutex //  Guards exited and stopped
+	exited  chan struct{}
+	stopped chan struct{}
 }
 
 // Start the MAC
 func (mac *InProcMac) Start() (err error) {
-	rpc.AddBackend(mac)
-	go mac.f(mac.deveui, rpc.bendpoint)
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+
+	mac.stopped = make(chan struct{})
+	mac.start()
 	return nil
 }
 
-// Stop the MAC
-func (mac InProcMac) Stop() {
-	fmt.Printf("InProcMac Stop not implemented\n")
+// Restart Runs the MAC function again after it returned, unless the MAC
+// was stopped
+func (mac *InProcMac) Restart() (err error) {
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+
+	select {
+	case <-mac.stopped:
+		return ErrMacStopped
+	default:
+	}
+	mac.start()
+	return nil
+}
+
+// start Runs the MAC function, with mux held
+func (mac *InProcMac) start() {
+	exited := make(chan struct{})
+	mac.exited = exited
+
+	rpc.AddBackend(mac)
+	go func() {
+		mac.f(mac.deveui, rpc.BackendEndpoint(mac.deveui))
+		close(exited)
+	}()
+}
+
+// Stop the MAC. An in-process MAC can not be interrupted: the supervisor
+// stops restarting it, the MAC function runs until it returns.
+func (mac *InProcMac) Stop() {
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+
+	if mac.stopped == nil {
+		return
+	}
+	select {
+	case <-mac.stopped:
+	default:
+		close(mac.stopped)
+	}
+}
+
+// Kill Does nothing, the MAC function can not be interrupted. The
+// supervisor restarts it once it returns.
+func (mac *InProcMac) Kill() {
+}
+
+// Exited Returns a channel closed when the MAC function started last
+// returns
+func (mac *InProcMac) Exited() <-chan struct{} {
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+	return mac.exited
+}
+
+// Stopped Returns a channel closed when the MAC is stopped
+func (mac *InProcMac) Stopped() <-chan struct{} {
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+	return mac.stopped
 }
 
 // NewInProcMac Return MAC Instance
@@ -1,20 +1,25 @@
 package mac
 
 import (
+	"context"
 	"fmt"
 	"log"
+	"runtime"
 	"sync"
+	"sync/atomic"
 )
 
 const (
 	rpcFrontEnd           = "inproc://mac.rpc"
 	rpcBackEnd            = "ipc:///opt/siming/zmq/mac.rpc"
 	loraMacNodeExecutable = "/opt/siming/bin/loRaMac-node"
+	nvmContextDir         = "/opt/siming/var/nvm"
 )
 
 var (
 	initMacOnce sync.Once
 	rpc         *RPC
+	supervisor  *Supervisor
 	macs        map[string]Mac
 )
 
@@ -26,22 +31,22 @@ type Mac interface {
 	IsConnected() bool
 	SetConnectedState(connected bool)
 	Request(command string) (reply string, err error)
+	RequestContext(ctx context.Context, command string) (reply string, err error)
 }
 
 type macBackend struct {
 	deveui    string
 	identity  string
-	connected bool
-	rpc       *RPCRequest
+	connected int32 //  Accessed atomically
+	rpc       *RPCClient
 }
 
 // NewMacBackend Construct a MAC Backend
 func newMacBackend(deveui string) (backend macBackend, err error) {
 
 	backend = macBackend{
-		deveui:    deveui,
-		connected: false,
-		rpc:       rpc.NewRPCRequest(),
+		deveui: deveui,
+		rpc:    rpc.Client(deveui),
 	}
 
 	return backend, nil
@@ -50,7 +55,7 @@ func newMacBackend(deveui string) (backend macBackend, err error) {
 func (mac *macBackend) worker(command <-chan string, response chan<- string) {
 	for {
 		cmd := <-command
-		reply, err := mac.rpc.Send(mac.deveui, cmd)
+		reply, err := mac.rpc.Send(context.Background(), mac.deveui, cmd)
 		fmt.Printf("Received %s,%v", cmd, err)
 		if err == nil {
 			response <- err.Error()
@@ -61,31 +66,41 @@ func (mac *macBackend) worker(command <-chan string, response chan<- string) {
 }
 
 func (mac *macBackend) SetConnectedState(connected bool) {
-	fmt.Printf("Set mac backend %s connected %v => %v\n", mac.deveui, mac.connected, connected)
-	mac.connected = connected
+	var value int32
+	if connected {
+		value = 1
+	}
+	fmt.Printf("Set mac backend %s connected %v => %v\n", mac.deveui, atomic.SwapInt32(&mac.connected, value) != 0,
+		connected)
 }
 
-func (mac macBackend) IsConnected() bool {
-	return mac.connected
+func (mac *macBackend) IsConnected() bool {
+	return atomic.LoadInt32(&mac.connected) != 0
 }
 
-func (mac macBackend) DevEui() string {
+func (mac *macBackend) DevEui() string {
 	return mac.deveui
 }
 
 // Backend Identity
-func (mac macBackend) Identity() string {
+func (mac *macBackend) Identity() string {
 	return mac.deveui
 }
 
-// Command Send MAC command and return the response
-func (mac macBackend) Request(cmd string) (reply string, err error) {
+// Command Send MAC command and return the response, within DefaultRPCTimeout
+func (mac *macBackend) Request(cmd string) (reply string, err error) {
+	return mac.RequestContext(context.Background(), cmd)
+}
+
+// RequestContext Send MAC command and return the response, unless ctx is
+// done first
+func (mac *macBackend) RequestContext(ctx context.Context, cmd string) (reply string, err error) {
 	// Check the backend is connected
 	if !mac.IsConnected() {
 		return "", fmt.Errorf(fmt.Sprintf("%s is not connected", mac.deveui))
 	}
 
-	return mac.rpc.Send(mac.deveui, cmd)
+	return mac.rpc.Send(ctx, mac.deveui, cmd)
 
 }
 
@@ -95,12 +110,13 @@ func Run() error {
 
 	onceBody := func() {
 		macs = make(map[string]Mac)
-		rpc, err = NewRPC(rpcFrontEnd, rpcBackEnd)
+		rpc, err = NewRPC(rpcFrontEnd, rpcBackEnd, runtime.NumCPU())
 		if err != nil {
 			log.Fatal(err)
 		}
 		fmt.Printf("MAC Initializing RPC\n")
 		err = rpc.Run()
+		supervisor = NewSupervisor(DefaultSupervisorConfig)
 	}
 
 	initMacOnce.Do(onceBody)
@@ -108,15 +124,19 @@ func Run() error {
 	return err
 }
 
-// StartLoRaMac Add a Node configured with the LoRaMac-node stack
+// StartLoRaMac Add a Node configured with the LoRaMac-node stack, restarted
+// by the supervisor when its process fails
 func StartLoRaMac(deveui string) (mac Mac, err error) {
-	mac, err = NewProcessMac(deveui, loraMacNodeExecutable)
+	processMac, err := NewProcessMac(deveui, loraMacNodeExecutable)
 	if err == nil {
-		err = mac.Start()
+		err = processMac.Start()
+	}
+	if err == nil {
+		supervisor.Supervise(processMac)
 	}
 
-	macs[deveui] = mac
-	return mac, err
+	macs[deveui] = processMac
+	return processMac, err
 }
 
 // StartInProcMac  Adds an Inproc  test MAC for testing obviously
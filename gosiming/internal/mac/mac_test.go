@@ -1,11 +1,15 @@
 package mac
 
 import (
+	"context"
 	"fmt"
+	"io/ioutil"
 	"log"
 	"os"
+	"path/filepath"
 	"strconv"
 	"sync"
+	"sync/atomic"
 	"testing"
 	"time"
 
@@ -103,7 +107,323 @@ func TestInProcMac(t *testing.T) {
 	fmt.Println("DONE Waiting")
 }
 
-var testMAC InProcMacFunc = func(deveui string, endpoint string) {
+func TestInProcMacConcurrentRequests(t *testing.T) {
+	var wg sync.WaitGroup
+	deveui := "c0ffee"
+	requestCount := 1000
+
+	mac, err := StartInProcMac(deveui, testMAC)
+	if err != nil {
+		t.Fatalf("StartInProcMac %s error %v", deveui, err)
+	}
+
+	for !mac.IsConnected() {
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	// Requests of one device share its client, each must get its own reply
+	for i := 0; i < requestCount; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			request := fmt.Sprintf("Hello #%d", i)
+			reply, err := mac.Request(request)
+			if err != nil {
+				t.Errorf("Request %s error %v", request, err)
+			} else if want := fmt.Sprintf("%s from %s\n", request, deveui); reply != want {
+				t.Errorf("Request %s reply %q, want %q", request, reply, want)
+			}
+		}(i)
+	}
+
+	wg.Wait()
+
+	//  Completed requests leave the deadline heap before their deadline
+	client := rpc.Client(deveui)
+	client.mux.Lock()
+	pending, deadlines := len(client.pending), len(client.deadlines)
+	client.mux.Unlock()
+	if pending != 0 || deadlines != 0 {
+		t.Errorf("%d requests and %d deadlines left after the replies", pending, deadlines)
+	}
+}
+
+func TestShardedRPCRouting(t *testing.T) {
+	var wg sync.WaitGroup
+	var deveuis []string
+	var macs []*macBackend
+	devEuiCount := 16
+	requestCount := 50
+
+	// A broker of its own, the one of the package has a shard per CPU
+	broker, err := NewRPC("inproc://mac.rpc.sharded", "inproc://mac.rpc.sharded.backend", 4)
+	if err != nil {
+		t.Fatalf("NewRPC error %v", err)
+	}
+	if err = broker.Run(); err != nil {
+		t.Fatalf("Run error %v", err)
+	}
+
+	shards := make(map[*rpcShard]bool)
+	for i := 0; i < devEuiCount; i++ {
+		deveui := fmt.Sprintf("5a%02x", i)
+		deveuis = append(deveuis, deveui)
+		shards[broker.shard(deveui)] = true
+
+		mac := &macBackend{deveui: deveui, rpc: broker.Client(deveui)}
+		broker.AddBackend(mac)
+		macs = append(macs, mac)
+		go testMACWorker(deveui, broker.BackendEndpoint(deveui), 0)
+	}
+	if len(shards) < 2 {
+		t.Fatalf("%d devices routed through %d shard", devEuiCount, len(shards))
+	}
+
+	for _, mac := range macs {
+		for !mac.IsConnected() {
+			time.Sleep(10 * time.Millisecond)
+		}
+	}
+
+	// The requests of all the devices at once, each reply must come back
+	// to its requester through the shard of its device
+	for _, deveui := range deveuis {
+		for i := 0; i < requestCount; i++ {
+			wg.Add(1)
+			go func(deveui string, i int) {
+				defer wg.Done()
+				request := fmt.Sprintf("Hello #%d", i)
+				reply, err := broker.Client(deveui).Send(context.Background(), deveui, request)
+				if err != nil {
+					t.Errorf("Request %s to %s error %v", request, deveui, err)
+				} else if want := fmt.Sprintf("%s from %s\n", request, deveui); reply != want {
+					t.Errorf("Request %s to %s reply %q, want %q", request, deveui, reply, want)
+				}
+			}(deveui, i)
+		}
+	}
+
+	wg.Wait()
+
+	if stats := broker.Stats(); stats != (RPCStats{}) {
+		t.Errorf("Stats %+v, want none dropped", stats)
+	}
+}
+
+func TestInProcMacDeadline(t *testing.T) {
+	deveui := "5104"
+
+	mac, err := StartInProcMac(deveui, newTestMAC(200*time.Millisecond))
+	if err != nil {
+		t.Fatalf("StartInProcMac %s error %v", deveui, err)
+	}
+
+	for !mac.IsConnected() {
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	before := rpc.Stats()
+	request := func(ctx context.Context, want error) {
+		start := time.Now()
+		_, err := mac.RequestContext(ctx, "Hello "+deveui)
+		if err != want {
+			t.Errorf("Request error %v, want %v", err, want)
+		}
+		if elapsed := time.Since(start); elapsed > 150*time.Millisecond {
+			t.Errorf("Request gave up after %v", elapsed)
+		}
+	}
+
+	// The first request times out while the backend works on it, its reply
+	// comes late. The second one expires queued behind it.
+	var wg sync.WaitGroup
+	for _, timeout := range []time.Duration{50 * time.Millisecond, 100 * time.Millisecond} {
+		wg.Add(1)
+		go func(timeout time.Duration) {
+			defer wg.Done()
+			ctx, cancel := context.WithTimeout(context.Background(), timeout)
+			defer cancel()
+			request(ctx, context.DeadlineExceeded)
+		}(timeout)
+		time.Sleep(10 * time.Millisecond)
+	}
+	wg.Wait()
+
+	// The third one is cancelled, its reply comes after that
+	ctx, cancel := context.WithCancel(context.Background())
+	time.AfterFunc(20*time.Millisecond, cancel)
+	request(ctx, context.Canceled)
+
+	want := RPCStats{Expired: 1, TimedOut: 2, Cancelled: 1, LateReplies: 2}
+	var got RPCStats
+	for start := time.Now(); time.Since(start) < 2*time.Second; time.Sleep(10 * time.Millisecond) {
+		after := rpc.Stats()
+		got = RPCStats{Expired: after.Expired - before.Expired,
+			TimedOut:    after.TimedOut - before.TimedOut,
+			Cancelled:   after.Cancelled - before.Cancelled,
+			LateReplies: after.LateReplies - before.LateReplies}
+		if got == want {
+			return
+		}
+	}
+	t.Errorf("Stats %+v, want %+v", got, want)
+}
+
+func TestSupervisorRestart(t *testing.T) {
+	deveui := "5afe"
+	var starts int32
+
+	// The worker crashes first, then hangs, then works
+	f := func(deveui string, endpoint string) {
+		switch atomic.AddInt32(&starts, 1) {
+		case 1:
+			return
+		case 2:
+			sock, _ := zmq.NewSocket(zmq.REQ)
+			defer sock.Close()
+			sock.SetIdentity(deveui)
+			sock.Connect(endpoint)
+			sock.SendMessage(BackendReady)
+			time.Sleep(300 * time.Millisecond)
+		default:
+			testMACWorker(deveui, endpoint, 0)
+		}
+	}
+
+	s := NewSupervisor(SupervisorConfig{
+		HeartbeatInterval: 20 * time.Millisecond,
+		HeartbeatTimeout:  20 * time.Millisecond,
+		HeartbeatLiveness: 2,
+		MinBackoff:        10 * time.Millisecond,
+		MaxBackoff:        time.Second,
+	})
+	defer s.Stop()
+
+	mac, err := NewInProcMac(deveui, f)
+	if err == nil {
+		err = mac.Start()
+	}
+	if err != nil {
+		t.Fatalf("StartInProcMac %s error %v", deveui, err)
+	}
+	s.Supervise(mac)
+
+	for start := time.Now(); atomic.LoadInt32(&starts) < 3 || !mac.IsConnected(); time.Sleep(10 * time.Millisecond) {
+		if time.Since(start) > 5*time.Second {
+			t.Fatalf("Worker started %d times, connected %v", atomic.LoadInt32(&starts), mac.IsConnected())
+		}
+	}
+
+	if _, err := mac.Request("Hello " + deveui); err != nil {
+		t.Errorf("Request after restart error %v", err)
+	}
+	if s.Restarts() != 2 {
+		t.Errorf("Restarts %d, want 2", s.Restarts())
+	}
+}
+
+func TestSupervisorStop(t *testing.T) {
+	var starts int32
+	release := make(chan struct{})
+
+	f := func(deveui string, endpoint string) {
+		atomic.AddInt32(&starts, 1)
+		<-release
+	}
+
+	s := NewSupervisor(SupervisorConfig{
+		HeartbeatInterval: time.Hour,
+		HeartbeatTimeout:  time.Second,
+		HeartbeatLiveness: 1,
+		MinBackoff:        time.Millisecond,
+		MaxBackoff:        time.Second,
+	})
+	defer s.Stop()
+
+	mac, err := NewInProcMac("5a0f", f)
+	if err == nil {
+		err = mac.Start()
+	}
+	if err != nil {
+		t.Fatalf("StartInProcMac error %v", err)
+	}
+	s.Supervise(mac)
+
+	//  The worker returns after the stop, the supervisor must not restart it
+	mac.Stop()
+	close(release)
+	<-mac.Exited()
+	time.Sleep(50 * time.Millisecond)
+
+	if n := atomic.LoadInt32(&starts); n != 1 || s.Restarts() != 0 {
+		t.Errorf("Worker started %d times, restarted %d times after Stop", n, s.Restarts())
+	}
+	if err := mac.Restart(); err != ErrMacStopped {
+		t.Errorf("Restart after Stop error %v, want %v", err, ErrMacStopped)
+	}
+}
+
+func TestSupervisorStopProcess(t *testing.T) {
+	if err := os.MkdirAll(nvmContextDir, 0755); err != nil {
+		t.Skipf("No NVM context directory: %v", err)
+	}
+
+	//  Worker process that stays up until killed
+	executable := filepath.Join(t.TempDir(), "worker")
+	if err := ioutil.WriteFile(executable, []byte("#!/bin/sh\nexec sleep 60\n"), 0755); err != nil {
+		t.Fatal(err)
+	}
+
+	s := NewSupervisor(SupervisorConfig{
+		HeartbeatInterval: time.Hour,
+		HeartbeatTimeout:  time.Second,
+		HeartbeatLiveness: 1,
+		MinBackoff:        time.Millisecond,
+		MaxBackoff:        time.Second,
+	})
+	defer s.Stop()
+
+	mac, err := NewProcessMac("5a1f", executable)
+	if err == nil {
+		err = mac.Start()
+	}
+	if err != nil {
+		t.Fatalf("Start error %v", err)
+	}
+	s.Supervise(mac)
+
+	stopped := make(chan struct{})
+	go func() {
+		mac.Stop()
+		close(stopped)
+	}()
+	select {
+	case <-stopped:
+	case <-time.After(5 * time.Second):
+		t.Fatal("Stop did not return")
+	}
+	time.Sleep(50 * time.Millisecond)
+
+	select {
+	case <-mac.Exited():
+	default:
+		t.Error("Process restarted after Stop")
+	}
+	if s.Restarts() != 0 {
+		t.Errorf("Restarted %d times after Stop", s.Restarts())
+	}
+}
+
+var testMAC = newTestMAC(0)
+
+// newTestMAC Returns a test MAC taking delay to process a request
+func newTestMAC(delay time.Duration) InProcMacFunc {
+	return func(deveui string, endpoint string) {
+		testMACWorker(deveui, endpoint, delay)
+	}
+}
+
+func testMACWorker(deveui string, endpoint string, delay time.Duration) {
 	sock, _ := zmq.NewSocket(zmq.REQ)
 	defer sock.Close()
 
@@ -124,18 +444,25 @@ var testMAC InProcMacFunc = func(deveui string, endpoint string) {
 	for {
 
 		//  Read and save all frames until we get an empty frame
-		//  In this example there is only 0 but it could be more
-		identity, _ := sock.Recv(0)
-		empty, _ := sock.Recv(0)
-		if empty != "" {
-			panic(fmt.Sprintf("empty is not \"\":%q", empty))
-
+		//  Here the client identity, the request correlation ID and deadline
+		var envelope []string
+		for {
+			frame, _ := sock.Recv(0)
+			if frame == "" {
+				break
+			}
+			envelope = append(envelope, frame)
 		}
 
 		request, _ := sock.Recv(0)
 
-		sock.Send(identity, zmq.SNDMORE)
-		sock.Send("", zmq.SNDMORE)
-		sock.Send(fmt.Sprintf("%s from %s\n", request, deveui), 0)
+		//  The deadline is the last envelope frame
+		if expired(envelope[len(envelope)-1], time.Now()) {
+			sock.SendMessage(BackendExpired, envelope)
+			continue
+		}
+
+		time.Sleep(delay)
+		sock.SendMessage(envelope, "", fmt.Sprintf("%s from %s\n", request, deveui))
 	}
 }
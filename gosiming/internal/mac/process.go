@@ -1,15 +1,21 @@
 package mac
 
 import (
+	"context"
 	"fmt"
 	"os"
 	"os/exec"
+	"path/filepath"
+	"sync"
 )
 
 // ProcessMac MAC is running in a different process
 type ProcessMac struct {
 	executable string
+	mux        sync.Mutex //  Guards cmd, exited and stopped
 	cmd        *exec.Cmd
+	exited     chan struct{}
+	stopped    chan struct{}
 	macBackend
 }
 
@@ -22,23 +28,113 @@ func NewProcessMac(deveui string, executable string) (mac *ProcessMac, err error
 	return mac, err
 }
 
+// NvmContextFile Returns the file the device state is kept in, across
+// restarts of its process
+func (mac *ProcessMac) NvmContextFile() string {
+	return filepath.Join(nvmContextDir, mac.deveui+".nvm")
+}
+
 // Start the MAC
 func (mac *ProcessMac) Start() (err error) {
-	mac.cmd = exec.Command(mac.executable, "--deveui", mac.deveui)
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+
+	mac.stopped = make(chan struct{})
+	return mac.start()
+}
+
+// Restart Starts the process again after it failed, unless the MAC was
+// stopped
+func (mac *ProcessMac) Restart() (err error) {
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+
+	select {
+	case <-mac.stopped:
+		return ErrMacStopped
+	default:
+	}
+	return mac.start()
+}
+
+// start Starts the process, with mux held
+func (mac *ProcessMac) start() (err error) {
+	mac.exited = make(chan struct{})
+
+	if err = os.MkdirAll(nvmContextDir, 0755); err != nil {
+		close(mac.exited)
+		return err
+	}
+
+	mac.cmd = exec.Command(mac.executable, "--deveui", mac.deveui, "--nvm", mac.NvmContextFile())
 	mac.cmd.Env = append(os.Environ(),
-		fmt.Sprintf("MAC_RPC_BACKEND_ADDRESS=%s", rpcBackEnd))
+		fmt.Sprintf("MAC_RPC_BACKEND_ADDRESS=%s", rpc.BackendEndpoint(mac.deveui)))
 
 	rpc.AddBackend(mac)
-	return mac.cmd.Start()
+	if err = mac.cmd.Start(); err != nil {
+		close(mac.exited)
+		return err
+	}
+
+	// Reap the process, and tell the supervisor
+	go func(cmd *exec.Cmd, exited chan struct{}) {
+		cmd.Wait()
+		close(exited)
+	}(mac.cmd, mac.exited)
+
+	return nil
+}
+
+// Stop the MAC, killing its process. The supervisor does not restart it.
+func (mac *ProcessMac) Stop() {
+	mac.mux.Lock()
+	if mac.stopped == nil {
+		mac.mux.Unlock()
+		return
+	}
+	select {
+	case <-mac.stopped:
+	default:
+		//  Before the kill, the supervisor sees the exit as intended
+		close(mac.stopped)
+	}
+	exited := mac.exited
+	mac.kill()
+	mac.mux.Unlock()
+
+	<-exited
+}
+
+// Kill Kills the process, the supervisor restarts it
+func (mac *ProcessMac) Kill() {
+	mac.mux.Lock()
+	mac.kill()
+	mac.mux.Unlock()
+}
+
+// kill Kills the process, with mux held
+func (mac *ProcessMac) kill() {
+	if mac.cmd != nil && mac.cmd.Process != nil {
+		mac.cmd.Process.Kill()
+	}
+}
+
+// Exited Returns a channel closed when the process started last exits
+func (mac *ProcessMac) Exited() <-chan struct{} {
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+	return mac.exited
 }
 
-// Stop the MAC
-func (mac ProcessMac) Stop() {
-	fmt.Printf("ProcessMac Stop not implemented\n")
+// Stopped Returns a channel closed when the MAC is stopped
+func (mac *ProcessMac) Stopped() <-chan struct{} {
+	mac.mux.Lock()
+	defer mac.mux.Unlock()
+	return mac.stopped
 }
 
 // Command Send MAC command and return the response
 func (mac *ProcessMac) Command(cmd string) (response string, err error) {
-	response, err = mac.rpc.Send(mac.deveui, cmd)
+	response, err = mac.rpc.Send(context.Background(), mac.deveui, cmd)
 	return response, err
 }
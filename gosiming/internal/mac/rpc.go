@@ -6,7 +6,11 @@ package mac
 
 import (
 	"fmt"
+	"hash/fnv"
+	"runtime"
+	"strconv"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	zmq "github.com/pebbe/zmq4"
@@ -14,18 +18,32 @@ import (
 
 // Constants
 const (
-	BackendReady = "\001" //  Signals service is ready
+	BackendReady   = "\001" //  Signals service is ready
+	BackendExpired = "\002" //  Signals a request was dropped past its deadline, followed by its envelope
 )
 
 // RPC  Sends requests to backend service and returns responses to requestor
+//
+// The broker is split in shards, each with its own frontend and backend
+// ROUTER sockets, reactor goroutine and backends. A backend and the clients
+// requesting it are routed through the shard picked by hashing the backend
+// identity, so the shards route in parallel and a slow backend only holds
+// up its own shard.
 type RPC struct {
+	shards []*rpcShard
+}
+
+// rpcShard One frontend/backend socket pair of the broker
+type rpcShard struct {
 	frontend  *zmq.Socket //  Listen to clients
 	backend   *zmq.Socket //  Listen to services
 	reactor   *zmq.Reactor
 	backends  map[string]Backend
+	client    *RPCClient //  Requests of the backends of the shard
 	bendpoint string
 	fendpoint string
 	mux       sync.Mutex
+	stats     RPCStats
 }
 
 // Backend defines the interface used to track backend service
@@ -35,19 +53,33 @@ type Backend interface {
 	IsConnected() bool
 }
 
-// RPCRequest RPC Requester
-type RPCRequest struct {
-	sock     *zmq.Socket
-	frontend string
+// shardEndpoint Returns the endpoint of a shard, the ipc or inproc endpoint
+// given to NewRPC suffixed with the shard number
+func shardEndpoint(endpoint string, shard int) string {
+	return fmt.Sprintf("%s.%d", endpoint, shard)
 }
 
-// FrontEnd RPC transport name
-func (request RPCRequest) FrontEnd() string {
-	return request.frontend
+// NewRPC Creates a New RPC Broker with the given number of shards
+func NewRPC(frontend string, backend string, shards int) (rpc *RPC, err error) {
+	if shards < 1 {
+		shards = 1
+	}
+
+	rpc = &RPC{}
+
+	for i := 0; i < shards; i++ {
+		shard, err := newRPCShard(shardEndpoint(frontend, i), shardEndpoint(backend, i))
+		if err != nil {
+			return nil, err
+		}
+		rpc.shards = append(rpc.shards, shard)
+	}
+
+	return rpc, nil
 }
 
-// NewRPC Creates a New RPC Broker
-func NewRPC(frontend string, backend string) (rpc *RPC, err error) {
+// newRPCShard Creates and binds the sockets of a shard
+func newRPCShard(frontend string, backend string) (shard *rpcShard, err error) {
 	fsock, err := zmq.NewSocket(zmq.ROUTER)
 	if err != nil {
 		return nil, err
@@ -59,68 +91,122 @@ func NewRPC(frontend string, backend string) (rpc *RPC, err error) {
 	}
 
 	bsock, err := zmq.NewSocket(zmq.ROUTER)
+	if err != nil {
+		return nil, err
+	}
+
 	err = bsock.Bind(backend)
 	if err != nil {
 		return nil, err
 	}
 
-	b := &RPC{frontend: fsock,
+	client, err := newRPCClient(frontend)
+	if err != nil {
+		return nil, err
+	}
+
+	s := &rpcShard{frontend: fsock,
 		backend:   bsock,
 		reactor:   zmq.NewReactor(),
+		client:    client,
 		fendpoint: frontend,
 		bendpoint: backend,
 		backends:  make(map[string]Backend)}
 
-	return b, nil
+	return s, nil
+}
+
+// shard Returns the shard routing a backend identity
+func (rpc *RPC) shard(identity string) *rpcShard {
+	h := fnv.New32a()
+	h.Write([]byte(identity))
+	return rpc.shards[h.Sum32()%uint32(len(rpc.shards))]
+}
+
+// BackendEndpoint Returns the endpoint the backend with this identity
+// connects to
+func (rpc *RPC) BackendEndpoint(identity string) string {
+	return rpc.shard(identity).bendpoint
 }
 
 //  In the reactor design, each time a message arrives on a socket, the
 //  reactor passes it to a handler function. We have two handlers; one
 //  for the frontend, one for the backend:
 
-//handleFrontEnd Handles input from frontend
-func handleFrontend(rpc *RPC) error {
-	//  Get client request, routed with identity added by client
-	msg, err := rpc.frontend.RecvMessage(0)
+// expired Checks a request deadline, in milliseconds since the epoch
+func expired(deadline string, now time.Time) bool {
+	ms, err := strconv.ParseInt(deadline, 10, 64)
+	return err == nil && now.UnixNano()/int64(time.Millisecond) >= ms
+}
+
+// handleFrontend Handles input from frontend
+func handleFrontend(shard *rpcShard) error {
+	//  Get client request [client, correlation, deadline, backend, request],
+	//  routed with identity added by client
+	msg, err := shard.frontend.RecvMessage(0)
 	if err != nil {
 		return err
 	}
 
 	client, msg := unwrap(msg)
+	correlation, msg := unwrap(msg)
+	deadline, msg := unwrap(msg)
 	backend, msg := unwrap(msg)
 
-	rpc.backend.Send(backend, zmq.SNDMORE)
-	rpc.backend.Send("", zmq.SNDMORE)
-	rpc.backend.Send(client, zmq.SNDMORE)
-	rpc.backend.Send("", zmq.SNDMORE)
-	rpc.backend.Send(msg[0], 0)
+	//  Nobody waits for the reply anymore
+	if expired(deadline, time.Now()) {
+		atomic.AddUint64(&shard.stats.Expired, 1)
+		return nil
+	}
+
+	//  The backend replies with the envelope [client, correlation, deadline]
+	shard.backend.Send(backend, zmq.SNDMORE)
+	shard.backend.Send("", zmq.SNDMORE)
+	shard.backend.Send(client, zmq.SNDMORE)
+	shard.backend.Send(correlation, zmq.SNDMORE)
+	shard.backend.Send(deadline, zmq.SNDMORE)
+	shard.backend.Send("", zmq.SNDMORE)
+	shard.backend.Send(msg[0], 0)
 
 	return nil
 }
 
 // handleBackend Handles input from backend
-// func handleBackend(fsock *zmq.Socket, bsock *zmq.Socket) error {
-func handleBackend(rpc *RPC) error {
+func handleBackend(shard *rpcShard) error {
 
-	msg, err := rpc.backend.RecvMessage(0)
+	msg, err := shard.backend.RecvMessage(0)
 	if err != nil {
 		fmt.Printf("[BACKEND] RecvMessage error %v\n", err)
 		return err
 	}
 	backend, msg := unwrap(msg)
 
-	//  Forward message to client if it's not a READY
-	if msg[0] != BackendReady {
-		rpc.frontend.SendMessage(msg)
-	} else {
-		rpc.mux.Lock()
-		b, _ := rpc.backends[backend]
+	//  Forward message [client, correlation, deadline, "", reply] to client
+	//  if it's not a READY or EXPIRED, and still waited for. The commands
+	//  come in a frame of their own, where the replies have the client
+	//  identity, so no reply content is mistaken for one.
+	switch msg[0] {
+	case BackendReady:
+		shard.mux.Lock()
+		b, _ := shard.backends[backend]
 		if b != nil {
 			b.SetConnectedState(true)
 		} else {
 			fmt.Printf("[BACKEND] received connected from unknown backend %s\n", backend)
 		}
-		rpc.mux.Unlock()
+		shard.mux.Unlock()
+
+	case BackendExpired:
+		//  [EXPIRED, client, correlation, deadline], the client gives up on
+		//  the request at its deadline
+		atomic.AddUint64(&shard.stats.Expired, 1)
+
+	default:
+		if len(msg) > 2 && expired(msg[2], time.Now()) {
+			atomic.AddUint64(&shard.stats.LateReplies, 1)
+		} else {
+			shard.frontend.SendMessage(msg)
+		}
 	}
 
 	return nil
@@ -128,53 +214,67 @@ func handleBackend(rpc *RPC) error {
 
 // AddBackend Adds RPC service
 func (rpc *RPC) AddBackend(backend Backend) {
+	shard := rpc.shard(backend.Identity())
+
 	backend.SetConnectedState(false)
-	rpc.mux.Lock()
-	rpc.backends[backend.Identity()] = backend
-	rpc.mux.Unlock()
+	shard.mux.Lock()
+	shard.backends[backend.Identity()] = backend
+	shard.mux.Unlock()
 }
 
-//Run Fires up the RPC Broker
+// Run Fires up the RPC Broker, one reactor goroutine per shard
 func (rpc *RPC) Run() (err error) {
-	rpc.reactor.AddSocket(rpc.backend, zmq.POLLIN,
-		func(e zmq.State) error { return handleBackend(rpc) })
+	//  A reactor and a client per shard, none of them blocks on exit
+	errs := make(chan error, 2*len(rpc.shards))
+
+	for _, shard := range rpc.shards {
+		shard := shard
 
-	rpc.reactor.AddSocket(rpc.frontend, zmq.POLLIN,
-		func(e zmq.State) error { return handleFrontend(rpc) })
+		shard.reactor.AddSocket(shard.backend, zmq.POLLIN,
+			func(e zmq.State) error { return handleBackend(shard) })
 
-	go func() {
-		err = rpc.reactor.Run(-1)
-	}()
+		shard.reactor.AddSocket(shard.frontend, zmq.POLLIN,
+			func(e zmq.State) error { return handleFrontend(shard) })
 
-	// Wait for reactor to start
-	timeout := time.After(2 * time.Second)
-	<-timeout
+		go func() {
+			// The shard sockets are only used from this thread
+			runtime.LockOSThread()
+			errs <- shard.reactor.Run(-1)
+		}()
+
+		go func() {
+			errs <- shard.client.run()
+		}()
+	}
+
+	// Wait for reactors to start
+	select {
+	case err = <-errs:
+	case <-time.After(2 * time.Second):
+	}
 
 	return err
 }
 
-// NewRPCRequest Creates and connects a RPC client
-func (rpc *RPC) NewRPCRequest() *RPCRequest {
-	sock, _ := zmq.NewSocket(zmq.REQ)
-	sock.Connect(rpc.fendpoint)
-	r := &RPCRequest{sock: sock, frontend: rpc.fendpoint}
-	return r
+// Stats Returns the counters of the requests that did not get a reply in
+// time, summed over the shards and their clients
+func (rpc *RPC) Stats() (stats RPCStats) {
+	for _, shard := range rpc.shards {
+		stats.add(&shard.stats)
+		stats.add(&shard.client.stats)
+	}
+	return stats
 }
 
-//Send Request
-func (request *RPCRequest) Send(service string, msg string) (reply string, err error) {
-	// Send request
-	request.sock.Send(service, zmq.SNDMORE)
-	request.sock.Send("", zmq.SNDMORE)
-	request.sock.Send(msg, 0)
-
-	// Wait for reply
-	return request.sock.Recv(0)
+// Client Returns the client sending the requests of a backend, through the
+// shard routing it
+func (rpc *RPC) Client(identity string) *RPCClient {
+	return rpc.shard(identity).client
 }
 
-//  unwrap  pops frame off front of message and returns it as 'head'
-//  If next frame is empty, pops that empty frame.
-//  Return remaining frames of message as 'tail'
+// unwrap Pops frame off front of message and returns it as 'head'
+// If next frame is empty, pops that empty frame.
+// Return remaining frames of message as 'tail'
 func unwrap(msg []string) (head string, tail []string) {
 	head = msg[0]
 
@@ -0,0 +1,284 @@
+//
+//  Siming Mac layer RPC client
+//
+
+package mac
+
+import (
+	"container/heap"
+	"context"
+	"fmt"
+	"runtime"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	zmq "github.com/pebbe/zmq4"
+)
+
+// DefaultRPCTimeout Deadline of the requests whose context has none
+const DefaultRPCTimeout = 5 * time.Second
+
+// RPCReply Reply, or error, of a request
+type RPCReply struct {
+	Reply string
+	Err   error
+}
+
+// RPCStats Counters of the requests that did not get a reply in time
+type RPCStats struct {
+	Expired     uint64 //  Dropped by the broker or the backend, past their deadline
+	TimedOut    uint64 //  Given up by the client at their deadline
+	Cancelled   uint64 //  Given up by the client when their context was cancelled
+	LateReplies uint64 //  Replies dropped as no longer waited for
+}
+
+func (stats *RPCStats) add(other *RPCStats) {
+	stats.Expired += atomic.LoadUint64(&other.Expired)
+	stats.TimedOut += atomic.LoadUint64(&other.TimedOut)
+	stats.Cancelled += atomic.LoadUint64(&other.Cancelled)
+	stats.LateReplies += atomic.LoadUint64(&other.LateReplies)
+}
+
+// rpcCall Request waiting for its reply
+type rpcCall struct {
+	reply    chan RPCReply
+	done     chan struct{} //  Closed once the reply is handed over
+	deadline *rpcDeadline
+}
+
+// rpcDeadline Deadline of a request, in the deadline heap
+type rpcDeadline struct {
+	at          time.Time
+	correlation string
+	index       int //  Position in the heap, -1 once out of it
+}
+
+// rpcDeadlines Min-heap of the deadlines of the pending requests, indexed so
+// that a completed request leaves the heap at once
+type rpcDeadlines []*rpcDeadline
+
+func (h rpcDeadlines) Len() int           { return len(h) }
+func (h rpcDeadlines) Less(i, j int) bool { return h[i].at.Before(h[j].at) }
+func (h rpcDeadlines) Swap(i, j int) {
+	h[i], h[j] = h[j], h[i]
+	h[i].index = i
+	h[j].index = j
+}
+func (h *rpcDeadlines) Push(x interface{}) {
+	d := x.(*rpcDeadline)
+	d.index = len(*h)
+	*h = append(*h, d)
+}
+func (h *rpcDeadlines) Pop() interface{} {
+	old := *h
+	d := old[len(old)-1]
+	old[len(old)-1] = nil
+	d.index = -1
+	*h = old[:len(old)-1]
+	return d
+}
+
+// RPCClient Sends the requests of many backends through one DEALER socket
+//
+// Each request is tagged with a correlation ID, which the broker and the
+// backend hand back with the reply, so any number of requests can be in
+// flight at once and their replies come back in any order. The DEALER
+// socket is owned by a single goroutine; requests are handed to it
+// through an inproc PUSH/PULL pipe.
+//
+// Each request also carries its deadline. The broker and the backend drop
+// the requests that are past it, and the client goroutine gives up on them
+// when it passes, so a stalled backend never holds up its requesters.
+type RPCClient struct {
+	frontend  string
+	pipe      string
+	push      *zmq.Socket //  Requests to the client goroutine, guarded by pushMux
+	pull      *zmq.Socket
+	dealer    *zmq.Socket
+	pushMux   sync.Mutex
+	pending   map[string]*rpcCall
+	deadlines rpcDeadlines
+	mux       sync.Mutex //  Guards pending and deadlines
+	next      uint64
+	stats     RPCStats
+}
+
+var rpcClientCount uint64
+
+// newRPCClient Creates a client of a broker frontend
+func newRPCClient(frontend string) (client *RPCClient, err error) {
+	c := &RPCClient{frontend: frontend,
+		pipe:    fmt.Sprintf("inproc://mac.rpc.client.%d", atomic.AddUint64(&rpcClientCount, 1)),
+		pending: make(map[string]*rpcCall)}
+
+	if c.pull, err = zmq.NewSocket(zmq.PULL); err != nil {
+		return nil, err
+	}
+	if err = c.pull.Bind(c.pipe); err != nil {
+		return nil, err
+	}
+
+	if c.push, err = zmq.NewSocket(zmq.PUSH); err != nil {
+		return nil, err
+	}
+	if err = c.push.Connect(c.pipe); err != nil {
+		return nil, err
+	}
+
+	if c.dealer, err = zmq.NewSocket(zmq.DEALER); err != nil {
+		return nil, err
+	}
+	if err = c.dealer.Connect(frontend); err != nil {
+		return nil, err
+	}
+
+	return c, nil
+}
+
+// FrontEnd RPC transport name
+func (client *RPCClient) FrontEnd() string {
+	return client.frontend
+}
+
+// run Forwards the requests to the broker and the replies to the requesters,
+// and times out the requests past their deadline
+func (client *RPCClient) run() error {
+	// The pull and dealer sockets are only used from this thread
+	runtime.LockOSThread()
+
+	poller := zmq.NewPoller()
+	poller.Add(client.pull, zmq.POLLIN)
+	poller.Add(client.dealer, zmq.POLLIN)
+
+	for {
+		sockets, err := poller.Poll(client.expire(time.Now()))
+		if err != nil {
+			return err
+		}
+
+		for _, socket := range sockets {
+			switch s := socket.Socket; s {
+			case client.pull:
+				//  [correlation, deadline, service, request]
+				msg, err := s.RecvMessage(0)
+				if err != nil {
+					return err
+				}
+				client.dealer.SendMessage(msg)
+
+			case client.dealer:
+				//  [correlation, deadline, "", reply]
+				msg, err := s.RecvMessage(0)
+				if err != nil {
+					return err
+				}
+				if !client.complete(msg[0], RPCReply{Reply: msg[len(msg)-1]}) {
+					atomic.AddUint64(&client.stats.LateReplies, 1)
+				}
+			}
+		}
+	}
+}
+
+// expire Times out the requests whose deadline has passed
+//
+// Returns the time left until the next deadline, -1 if there is none.
+func (client *RPCClient) expire(now time.Time) time.Duration {
+	var expired []string
+
+	client.mux.Lock()
+	for len(client.deadlines) > 0 && !client.deadlines[0].at.After(now) {
+		expired = append(expired, heap.Pop(&client.deadlines).(*rpcDeadline).correlation)
+	}
+	next := time.Duration(-1)
+	if len(client.deadlines) > 0 {
+		next = client.deadlines[0].at.Sub(now)
+	}
+	client.mux.Unlock()
+
+	for _, correlation := range expired {
+		if client.complete(correlation, RPCReply{Err: context.DeadlineExceeded}) {
+			atomic.AddUint64(&client.stats.TimedOut, 1)
+		}
+	}
+	return next
+}
+
+// complete Hands a reply to its requester
+//
+// Returns false when the request is no longer waited for.
+func (client *RPCClient) complete(correlation string, reply RPCReply) bool {
+	client.mux.Lock()
+	call, ok := client.pending[correlation]
+	if ok {
+		delete(client.pending, correlation)
+		if call.deadline.index >= 0 {
+			heap.Remove(&client.deadlines, call.deadline.index)
+		}
+	}
+	client.mux.Unlock()
+
+	if ok {
+		call.reply <- reply
+		close(call.done)
+	}
+	return ok
+}
+
+// Go Sends a request without waiting for its reply
+//
+// The reply is sent on the returned channel, which has room for it, so
+// the requester may receive it whenever it wants. The request is given up
+// with ctx.Err() when ctx is cancelled, and with context.DeadlineExceeded
+// at the deadline of ctx, or DefaultRPCTimeout from now when ctx has none.
+func (client *RPCClient) Go(ctx context.Context, service string, msg string) <-chan RPCReply {
+	correlation := strconv.FormatUint(atomic.AddUint64(&client.next, 1), 16)
+	deadline, ok := ctx.Deadline()
+	if !ok {
+		deadline = time.Now().Add(DefaultRPCTimeout)
+	}
+
+	call := &rpcCall{reply: make(chan RPCReply, 1), done: make(chan struct{}),
+		deadline: &rpcDeadline{at: deadline, correlation: correlation}}
+
+	client.mux.Lock()
+	client.pending[correlation] = call
+	heap.Push(&client.deadlines, call.deadline)
+	client.mux.Unlock()
+
+	if ctx.Done() != nil {
+		go func() {
+			select {
+			case <-ctx.Done():
+				if client.complete(correlation, RPCReply{Err: ctx.Err()}) {
+					if ctx.Err() == context.Canceled {
+						atomic.AddUint64(&client.stats.Cancelled, 1)
+					} else {
+						atomic.AddUint64(&client.stats.TimedOut, 1)
+					}
+				}
+			case <-call.done:
+			}
+		}()
+	}
+
+	//  The deadline travels as milliseconds since the epoch, which the
+	//  broker and the backends, on the same host, compare to their clock
+	client.pushMux.Lock()
+	_, err := client.push.SendMessage(correlation, strconv.FormatInt(deadline.UnixNano()/int64(time.Millisecond), 10),
+		service, msg)
+	client.pushMux.Unlock()
+
+	if err != nil {
+		client.complete(correlation, RPCReply{Err: err})
+	}
+	return call.reply
+}
+
+// Send Sends a request and waits for its reply, see Go
+func (client *RPCClient) Send(ctx context.Context, service string, msg string) (reply string, err error) {
+	r := <-client.Go(ctx, service, msg)
+	return r.Reply, r.Err
+}
@@ -0,0 +1,190 @@
+//
+//  Siming Mac worker supervision
+//
+
+package mac
+
+import (
+	"context"
+	"errors"
+	"fmt"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// BackendHeartbeat Request the supervisor checks a worker is alive with,
+// any reply will do
+const BackendHeartbeat = "\003"
+
+// ErrMacStopped Restart of a MAC stopped since its last Start
+var ErrMacStopped = errors.New("MAC stopped")
+
+// Supervised MAC the supervisor can restart
+//
+// Stop ends the supervision of the MAC: it closes the Stopped channel
+// before the worker exits, and Restart fails with ErrMacStopped from then
+// on, until the MAC is started again.
+type Supervised interface {
+	Mac
+	// Exited Returns a channel closed when the worker started last exits
+	Exited() <-chan struct{}
+	// Stopped Returns a channel closed when the MAC is stopped
+	Stopped() <-chan struct{}
+	// Kill Kills the worker, which is then restarted
+	Kill()
+	// Restart Starts the worker again, unless the MAC was stopped
+	Restart() error
+}
+
+// SupervisorConfig Supervisor settings
+type SupervisorConfig struct {
+	HeartbeatInterval time.Duration //  Time between heartbeats
+	HeartbeatTimeout  time.Duration //  Time a heartbeat waits for its reply
+	HeartbeatLiveness int           //  Heartbeats missed in a row before a restart
+	MinBackoff        time.Duration //  Delay before the first restart
+	MaxBackoff        time.Duration //  Longest delay between restarts
+}
+
+// DefaultSupervisorConfig Supervisor settings of StartLoRaMac
+var DefaultSupervisorConfig = SupervisorConfig{
+	HeartbeatInterval: time.Second,
+	HeartbeatTimeout:  time.Second,
+	HeartbeatLiveness: 3,
+	MinBackoff:        100 * time.Millisecond,
+	MaxBackoff:        30 * time.Second,
+}
+
+// Supervisor Restarts the workers that exit or stop answering heartbeats
+//
+// A worker is restarted after a back-off delay, which doubles on each
+// restart up to MaxBackoff, so a worker crashing on start does not spin.
+// The delay goes back to MinBackoff once the worker stays up for
+// MaxBackoff. Workers restore their device from its NVM context file on
+// start, a restarted device carries on with its session instead of
+// joining again.
+type Supervisor struct {
+	config   SupervisorConfig
+	restarts uint64
+	stop     chan struct{}
+	wg       sync.WaitGroup
+}
+
+// NewSupervisor Creates a supervisor
+func NewSupervisor(config SupervisorConfig) *Supervisor {
+	return &Supervisor{config: config, stop: make(chan struct{})}
+}
+
+// Supervise Watches a started MAC until it or the supervisor stops
+func (s *Supervisor) Supervise(mac Supervised) {
+	s.wg.Add(1)
+	go func() {
+		defer s.wg.Done()
+		s.supervise(mac)
+	}()
+}
+
+// Restarts Returns the number of workers restarted so far
+func (s *Supervisor) Restarts() uint64 {
+	return atomic.LoadUint64(&s.restarts)
+}
+
+// Stop Stops supervising, the workers keep running
+func (s *Supervisor) Stop() {
+	close(s.stop)
+	s.wg.Wait()
+}
+
+// supervise Restarts a MAC each time its worker fails
+func (s *Supervisor) supervise(mac Supervised) {
+	backoff := s.config.MinBackoff
+	stopped := mac.Stopped()
+
+	for {
+		started := time.Now()
+		exited := mac.Exited()
+
+		reason := s.watch(mac, exited, stopped)
+		if reason == "" {
+			return
+		}
+
+		//  Fail requests right away until the worker is READY again
+		mac.SetConnectedState(false)
+		mac.Kill()
+
+		select {
+		case <-s.stop:
+			return
+		case <-stopped:
+			return
+		case <-exited:
+		}
+
+		if time.Since(started) >= s.config.MaxBackoff {
+			backoff = s.config.MinBackoff
+		}
+		fmt.Printf("[SUPERVISOR] %s %s, restarting in %v\n", mac.DevEui(), reason, backoff)
+
+		select {
+		case <-s.stop:
+			return
+		case <-stopped:
+			return
+		case <-time.After(backoff):
+		}
+
+		err := mac.Restart()
+		if err == ErrMacStopped {
+			return
+		}
+		atomic.AddUint64(&s.restarts, 1)
+		if err != nil {
+			fmt.Printf("[SUPERVISOR] %s restart error %v\n", mac.DevEui(), err)
+		}
+
+		backoff *= 2
+		if backoff > s.config.MaxBackoff {
+			backoff = s.config.MaxBackoff
+		}
+	}
+}
+
+// watch Waits for the worker to fail
+//
+// Returns why it failed, or "" when the MAC or the supervisor stops.
+func (s *Supervisor) watch(mac Supervised, exited <-chan struct{}, stopped <-chan struct{}) string {
+	ticker := time.NewTicker(s.config.HeartbeatInterval)
+	defer ticker.Stop()
+	missed := 0
+
+	for {
+		select {
+		case <-s.stop:
+			return ""
+
+		case <-stopped:
+			return ""
+
+		case <-exited:
+			//  Stop closes stopped before the worker exits
+			select {
+			case <-stopped:
+				return ""
+			default:
+				return "exited"
+			}
+
+		case <-ticker.C:
+			ctx, cancel := context.WithTimeout(context.Background(), s.config.HeartbeatTimeout)
+			_, err := mac.RequestContext(ctx, BackendHeartbeat)
+			cancel()
+
+			if err == nil {
+				missed = 0
+			} else if missed++; missed >= s.config.HeartbeatLiveness {
+				return fmt.Sprintf("missed %d heartbeats", missed)
+			}
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <benchmark/benchmark.h>
+
+#include "main/binlog.h"
+
+namespace {
+
+using binlog::Severity;
+
+// Events logged between two drains, well below the ring size so none is dropped
+constexpr size_t kBatch = binlog::kRingSize / 2;
+
+// Enabled events per run, each batch waits for a drain
+constexpr size_t kIterations = kBatch * 256;
+
+void start_logger()
+{
+    binlog::Config config;
+
+    // No file and no console, the formatting is off the measured thread
+    config.min_severity = Severity::info;
+    config.flush_interval = std::chrono::milliseconds(1);
+    binlog::start(config);
+}
+
+/*!
+ * \brief Lets the logger thread drain the ring of the calling thread
+ */
+void drain(benchmark::State& state, size_t& logged)
+{
+    if (++logged % kBatch == 0) {
+        state.PauseTiming();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        state.ResumeTiming();
+    }
+}
+
+void report_dropped(benchmark::State& state, uint64_t before)
+{
+    binlog::stop();
+    state.counters["dropped"] = static_cast<double>(binlog::dropped() - before);
+}
+
+// Enabled event with integer arguments
+void BM_BinlogIntegers(benchmark::State& state)
+{
+    uint64_t dropped = binlog::dropped();
+    size_t logged = 0;
+    uint32_t devAddr = 0x26011234;
+
+    start_logger();
+    for (auto _ : state) {
+        BINLOG(Severity::info, "device {} uplink {} on {} Hz", devAddr, logged, 868100000);
+        drain(state, logged);
+    }
+    report_dropped(state, dropped);
+}
+BENCHMARK(BM_BinlogIntegers)->Iterations(kIterations);
+
+// Enabled event with a string argument, copied into the record
+void BM_BinlogString(benchmark::State& state)
+{
+    uint64_t dropped = binlog::dropped();
+    size_t logged = 0;
+    std::string path(state.range(0), 'n');
+
+    start_logger();
+    for (auto _ : state) {
+        BINLOG(Severity::info, "Can not store the NVM contexts to {}", path);
+        drain(state, logged);
+    }
+    report_dropped(state, dropped);
+}
+BENCHMARK(BM_BinlogString)->Arg(8)->Arg(48)->Iterations(kIterations);
+
+// Event below the minimum severity
+void BM_BinlogFiltered(benchmark::State& state)
+{
+    uint64_t dropped = binlog::dropped();
+    uint32_t devAddr = 0x26011234;
+
+    start_logger();
+    for (auto _ : state) {
+        BINLOG(Severity::debug, "device {} rx window opened", devAddr);
+        benchmark::ClobberMemory();
+    }
+    report_dropped(state, dropped);
+}
+BENCHMARK(BM_BinlogFiltered);
+
+} // namespace
@@ -0,0 +1,108 @@
+#include <cstring>
+#include <benchmark/benchmark.h>
+
+#include "LoRaMacCommands.h"
+#include "LoRaMacParser.h"
+#include "LoRaMacSerializer.h"
+
+namespace {
+
+uint8_t Payload[242];
+uint8_t Buffer[256];
+
+/*!
+ * \brief Sets up a data uplink with two MAC command answers in FOpts
+ */
+void data_message(LoRaMacMessageData_t* msg, uint8_t payloadSize)
+{
+    *msg = {};
+    msg->Buffer = Buffer;
+    msg->BufSize = UINT8_MAX;
+    msg->MHDR.Bits.MType = FRAME_TYPE_DATA_CONFIRMED_UP;
+    msg->FHDR.DevAddr = 0x26011234;
+    msg->FHDR.FCtrl.Bits.Adr = 1;
+    msg->FHDR.FCtrl.Bits.FOptsLen = 3;
+    msg->FHDR.FCnt = 42;
+    msg->FHDR.FOpts[0] = MOTE_MAC_LINK_ADR_ANS;
+    msg->FHDR.FOpts[1] = 0x07;
+    msg->FHDR.FOpts[2] = MOTE_MAC_DUTY_CYCLE_ANS;
+    msg->FPort = 2;
+    msg->FRMPayload = Payload;
+    msg->FRMPayloadSize = payloadSize;
+    msg->MIC = 0x01020304;
+}
+
+// Up to the largest frame with the FOpts above, 255 bytes
+void payload_sizes(benchmark::internal::Benchmark* b)
+{
+    b->Arg(0)->Arg(51)->Arg(239);
+}
+
+void BM_SerializerData(benchmark::State& state)
+{
+    LoRaMacMessageData_t msg;
+
+    for (auto _ : state) {
+        data_message(&msg, static_cast<uint8_t>(state.range(0)));
+        if (LoRaMacSerializerData(&msg) != LORAMAC_SERIALIZER_SUCCESS) {
+            state.SkipWithError("LoRaMacSerializerData failed");
+            break;
+        }
+        benchmark::DoNotOptimize(Buffer);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SerializerData)->Apply(payload_sizes);
+
+void BM_ParserData(benchmark::State& state)
+{
+    LoRaMacMessageData_t msg;
+    uint8_t size;
+
+    data_message(&msg, static_cast<uint8_t>(state.range(0)));
+    LoRaMacSerializerData(&msg);
+    size = msg.BufSize;
+
+    for (auto _ : state) {
+        msg = {};
+        msg.Buffer = Buffer;
+        msg.BufSize = size;
+        if (LoRaMacParserData(&msg) != LORAMAC_PARSER_SUCCESS) {
+            state.SkipWithError("LoRaMacParserData failed");
+            break;
+        }
+        benchmark::DoNotOptimize(msg);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParserData)->Apply(payload_sizes);
+
+// Answers of a LinkAdrReq block, a RxParamSetupReq (sticky) and a DevStatusReq
+void BM_CommandsSerializeCmds(benchmark::State& state)
+{
+    uint8_t linkAdrAns = 0x07;
+    uint8_t rxParamSetupAns = 0x07;
+    uint8_t devStatusAns[2] = { 254, 10 };
+    uint8_t buffer[LORAMAC_FHDR_F_OPTS_MAX_FIELD_SIZE];
+    size_t size = 0;
+
+    LoRaMacCommandsInit(NULL);
+    for (int i = 0; i < 4; i++) {
+        LoRaMacCommandsAddCmd(MOTE_MAC_LINK_ADR_ANS, &linkAdrAns, 1);
+    }
+    LoRaMacCommandsAddCmd(MOTE_MAC_RX_PARAM_SETUP_ANS, &rxParamSetupAns, 1);
+    LoRaMacCommandsAddCmd(MOTE_MAC_DEV_STATUS_ANS, devStatusAns, sizeof(devStatusAns));
+
+    for (auto _ : state) {
+        if (LoRaMacCommandsSerializeCmds(sizeof(buffer), &size, buffer) != LORAMAC_COMMANDS_SUCCESS) {
+            state.SkipWithError("LoRaMacCommandsSerializeCmds failed");
+            break;
+        }
+        benchmark::DoNotOptimize(buffer);
+    }
+    LoRaMacCommandsRemoveNoneStickyCmds();
+    LoRaMacCommandsRemoveStickyAnsCmds();
+}
+BENCHMARK(BM_CommandsSerializeCmds);
+
+} // namespace
@@ -0,0 +1,178 @@
+#include <cstring>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "aes.h"
+#include "cmac.h"
+#include "LoRaMacCrypto.h"
+#include "LoRaMacParser.h"
+#include "LoRaMacSerializer.h"
+#include "secure-element.h"
+#include "sim/lorawan.h"
+
+namespace {
+
+const uint8_t kKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                           0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+constexpr uint32_t kDevAddr = 0x26011234;
+
+// Downlinks verified between two resets of the frame counters
+constexpr uint32_t kFrameBatch = 256;
+
+void fill(uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+}
+
+/*!
+ * \brief Sets up the crypto module of an ABP device with LoRaWAN 1.0.4 keys,
+ *        the downlink counters start over
+ */
+void crypto_init()
+{
+    Version_t version;
+
+    version.Value = 0;
+    version.Fields.Major = 1;
+    version.Fields.Minor = 0;
+    version.Fields.Patch = 4;
+
+    SecureElementInit(NULL);
+    LoRaMacCryptoInit(NULL);
+    LoRaMacCryptoSetLrWanVersion(version);
+    LoRaMacCryptoSetKey(APP_S_KEY, const_cast<uint8_t*>(kKey));
+    LoRaMacCryptoSetKey(NWK_S_ENC_KEY, const_cast<uint8_t*>(kKey));
+    LoRaMacCryptoSetKey(S_NWK_S_INT_KEY, const_cast<uint8_t*>(kKey));
+    LoRaMacCryptoSetKey(F_NWK_S_INT_KEY, const_cast<uint8_t*>(kKey));
+}
+
+void BM_AesEncrypt(benchmark::State& state)
+{
+    aes_context ctx;
+    uint8_t block[16];
+
+    aes_set_key(kKey, sizeof(kKey), &ctx);
+    fill(block, sizeof(block));
+    for (auto _ : state) {
+        aes_encrypt(block, block, &ctx);
+        benchmark::DoNotOptimize(block);
+    }
+    state.SetBytesProcessed(state.iterations() * sizeof(block));
+}
+BENCHMARK(BM_AesEncrypt);
+
+void BM_AesCmac(benchmark::State& state)
+{
+    std::vector<uint8_t> data(state.range(0));
+    uint8_t digest[AES_CMAC_DIGEST_LENGTH];
+    AES_CMAC_CTX ctx;
+
+    fill(data.data(), data.size());
+    for (auto _ : state) {
+        AES_CMAC_Init(&ctx);
+        AES_CMAC_SetKey(&ctx, kKey);
+        AES_CMAC_Update(&ctx, data.data(), data.size());
+        AES_CMAC_Final(digest, &ctx);
+        benchmark::DoNotOptimize(digest);
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_AesCmac)->Arg(16)->Arg(64)->Arg(256);
+
+// FRMPayload sizes from the smallest frame to the largest US915 DR4 frame
+void payload_sizes(benchmark::internal::Benchmark* b)
+{
+    b->Arg(1)->Arg(11)->Arg(51)->Arg(115)->Arg(242);
+}
+
+void BM_SecureMessage(benchmark::State& state)
+{
+    uint8_t payload[242];
+    uint8_t buffer[256];
+    LoRaMacMessageData_t msg = {};
+    uint32_t fCntUp = 0;
+
+    crypto_init();
+    fill(payload, sizeof(payload));
+
+    msg.Buffer = buffer;
+    msg.BufSize = UINT8_MAX;
+    msg.MHDR.Bits.MType = FRAME_TYPE_DATA_UNCONFIRMED_UP;
+    msg.FHDR.DevAddr = kDevAddr;
+    msg.FPort = 2;
+    msg.FRMPayload = payload;
+    msg.FRMPayloadSize = static_cast<uint8_t>(state.range(0));
+
+    for (auto _ : state) {
+        // Encrypts the application payload in place, as the MAC does
+        msg.FHDR.FCnt = static_cast<uint16_t>(fCntUp);
+        if (LoRaMacCryptoSecureMessage(fCntUp, 0, 0, &msg) != LORAMAC_CRYPTO_SUCCESS) {
+            state.SkipWithError("LoRaMacCryptoSecureMessage failed");
+            break;
+        }
+        fCntUp++;
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SecureMessage)->Apply(payload_sizes);
+
+void BM_UnsecureMessage(benchmark::State& state)
+{
+    uint8_t payload[242];
+    LoRaMacMessageData_t msg = {};
+    std::vector<uint8_t> frames(kFrameBatch * 256);
+    std::vector<uint8_t> pristine;
+    uint8_t size = 0;
+
+    crypto_init();
+    fill(payload, sizeof(payload));
+
+    // Downlinks with consecutive counters and a valid MIC, built like the
+    // network server does
+    for (uint32_t fCnt = 0; fCnt < kFrameBatch; fCnt++) {
+        msg.Buffer = &frames[fCnt * 256];
+        msg.BufSize = UINT8_MAX;
+        msg.MHDR.Bits.MType = FRAME_TYPE_DATA_UNCONFIRMED_DOWN;
+        msg.FHDR.DevAddr = kDevAddr;
+        msg.FHDR.FCnt = static_cast<uint16_t>(fCnt);
+        msg.FPort = 2;
+        msg.FRMPayload = payload;
+        msg.FRMPayloadSize = static_cast<uint8_t>(state.range(0));
+        msg.MIC = 0;
+        LoRaMacSerializerData(&msg);
+
+        size = msg.BufSize;
+        uint32_t mic = sim::lorawan::data_mic(kKey, true, kDevAddr, fCnt, msg.Buffer, size - 4);
+        sim::lorawan::put_le(msg.Buffer + size - 4, mic, 4);
+    }
+    pristine = frames;
+
+    uint32_t fCnt = 0;
+    for (auto _ : state) {
+        if (fCnt == kFrameBatch) {
+            // The payloads were decrypted in place
+            state.PauseTiming();
+            frames = pristine;
+            crypto_init();
+            fCnt = 0;
+            state.ResumeTiming();
+        }
+
+        msg = {};
+        msg.Buffer = &frames[fCnt * 256];
+        msg.BufSize = size;
+        LoRaMacParserData(&msg);
+        if (LoRaMacCryptoUnsecureMessage(UNICAST_DEV_ADDR, kDevAddr, FCNT_DOWN, fCnt, &msg) !=
+            LORAMAC_CRYPTO_SUCCESS) {
+            state.SkipWithError("LoRaMacCryptoUnsecureMessage failed");
+            break;
+        }
+        fCnt++;
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UnsecureMessage)->Apply(payload_sizes);
+
+} // namespace
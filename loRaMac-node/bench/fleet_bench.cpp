@@ -0,0 +1,536 @@
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/program_options.hpp>
+
+#include "radio.h"
+#include "rtc.h"
+#include "timer.h"
+#include "LmHandler.h"
+#include "LoRaMacSnapshot.h"
+#include "sim/fleet_image.h"
+#include "sim/histogram.h"
+#include "sim/medium.h"
+#include "sim/network_server.h"
+#include "sim/replay.h"
+
+namespace po = boost::program_options;
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+// Request latencies are counted in ns up to a minute, to 3 digits
+constexpr uint64_t kHighestLatency = 60ull * 1000 * 1000 * 1000;
+constexpr int kLatencyDigits = 3;
+
+// Root key of the pre-provisioned secure element identity
+const uint8_t kAppKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                              0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+
+struct Uplink {
+    uint8_t port;
+    uint8_t size;
+    bool confirmed;
+};
+
+/*!
+ * Uplink mix every device sends in turn: mostly small unconfirmed
+ * readings, some larger reports and a confirmed uplink in five.
+ */
+const Uplink kUplinkMix[] = {
+    { 2, 11, false },
+    { 2, 11, false },
+    { 2, 51, false },
+    { 2, 11, false },
+    { 3, 11, true },
+    { 2, 11, false },
+    { 2, 11, false },
+    { 2, 51, false },
+    { 2, 11, false },
+    { 3, 11, true },
+};
+
+struct BenchConfig {
+    uint32_t devices = 100;
+    unsigned workers = 1;
+    uint32_t uplinks = 100;
+    sim::Time interval = 60000;
+    uint64_t seed = 1;
+    /*!
+     * Directory of the input logs of the devices, none if empty
+     */
+    string record;
+    /*!
+     * Fleet image the devices write their snapshot to, none if empty
+     */
+    string image;
+    sim::Time snapshot_at = 3600000;
+};
+
+/*!
+ * Results of the devices a worker ran, in memory shared with the parent,
+ * followed by the counts of the latency histogram
+ */
+struct WorkerResult {
+    uint64_t devices;
+    uint64_t joined;
+    uint64_t uplinks;
+    uint64_t send_errors;
+    uint64_t snapshots;
+    uint64_t wall_ns;
+    uint64_t virtual_ms;
+    uint64_t rss_kb;
+    uint64_t rss_kb_max;
+};
+
+/*
+ * State of the device run by this process, the stack hosts one device
+ */
+
+uint8_t AppDataBuffer[242];
+bool Joined = false;
+bool Pending = false;
+Clock::time_point SentAt;
+uint64_t Uplinks = 0;
+sim::Histogram* Latency = nullptr;
+
+uint8_t GetBatteryLevel(void) { return 254; }
+float GetTemperature(void) { return 25.0f; }
+uint32_t GetRandomSeed(void) { return 0; }
+void OnMacProcess(void) { }
+void OnNvmContextChange(LmHandlerNvmContextStates_t state) { }
+void OnNetworkParametersChange(CommissioningParams_t* params) { }
+void OnMacMcpsRequest(LoRaMacStatus_t status, McpsReq_t* mcpsReq, TimerTime_t nextTxDelay) { }
+void OnMacMlmeRequest(LoRaMacStatus_t status, MlmeReq_t* mlmeReq, TimerTime_t nextTxDelay) { }
+void OnRxData(LmHandlerAppData_t* appData, LmHandlerRxParams_t* params) { }
+void OnClassChange(DeviceClass_t deviceClass) { }
+void OnBeaconStatusChange(LoRaMacHandlerBeaconParams_t* params) { }
+void OnSysTimeUpdate(bool isSynchronized, int32_t timeCorrection) { }
+
+void OnJoinRequest(LmHandlerJoinParams_t* params)
+{
+    Joined = params->Status == LORAMAC_HANDLER_SUCCESS;
+}
+
+void OnTxData(LmHandlerTxParams_t* params)
+{
+    // Uplinks the stack sends on its own are not requests of the mix
+    if (!params->IsMcpsConfirm || !Pending) {
+        return;
+    }
+    Latency->record(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - SentAt).count());
+    Uplinks++;
+    Pending = false;
+}
+
+LmHandlerCallbacks_t callbacks = {
+    GetBatteryLevel,
+    GetTemperature,
+    GetRandomSeed,
+    OnMacProcess,
+    OnNvmContextChange,
+    OnNetworkParametersChange,
+    OnMacMcpsRequest,
+    OnMacMlmeRequest,
+    OnJoinRequest,
+    OnTxData,
+    OnRxData,
+    OnClassChange,
+    OnBeaconStatusChange,
+    OnSysTimeUpdate,
+};
+
+uint64_t rss_kb()
+{
+    char line[128];
+    uint64_t rss = 0;
+    FILE* file = fopen("/proc/self/status", "r");
+
+    if (file == nullptr) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (sscanf(line, "VmRSS: %lu kB", &rss) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+    return rss;
+}
+
+/*!
+ * \brief Stack setup of every device
+ */
+void init_params(LmHandlerParams_t* params)
+{
+    params->Region = LORAMAC_REGION_US915;
+    params->AdrEnable = true;
+    params->IsTxConfirmed = LORAMAC_HANDLER_UNCONFIRMED_MSG;
+    params->TxDatarate = DR_3;
+    params->PublicNetworkEnable = true;
+    params->DutyCycleEnabled = false;
+    params->DataBufferMaxSize = sizeof(AppDataBuffer);
+    params->DataBuffer = AppDataBuffer;
+}
+
+/*!
+ * \brief Gets the snapshot image size of a device. The stack only knows the
+ *        size of its contexts once initialized, which is done in a throwaway
+ *        process to leave this one untouched for the devices.
+ *
+ * \retval Image size, 0 on failure
+ */
+uint32_t snapshot_size()
+{
+    uint32_t size = 0;
+    int fds[2];
+
+    if (pipe(fds) != 0) {
+        return 0;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        LmHandlerParams_t params = {};
+
+        close(fds[0]);
+        init_params(&params);
+        if (LmHandlerInit(&callbacks, &params) == LORAMAC_HANDLER_SUCCESS) {
+            size = static_cast<uint32_t>(LoRaMacSnapshotGetSize());
+        }
+        _exit(write(fds[1], &size, sizeof(size)) == sizeof(size) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    if (pid > 0) {
+        if (read(fds[0], &size, sizeof(size)) != sizeof(size)) {
+            size = 0;
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    close(fds[0]);
+    return size;
+}
+
+/*!
+ * \brief Writes the snapshot of the device to its slot of the fleet image.
+ *        Only an idle MAC can be captured, its timers and radio operation
+ *        are not part of the snapshot.
+ *
+ * \retval true on success
+ */
+bool snapshot_device(const BenchConfig& config, uint32_t device)
+{
+    if (LoRaMacIsBusy()) {
+        return false;
+    }
+
+    vector<uint8_t> image(LoRaMacSnapshotGetSize());
+    return (LoRaMacSnapshotSave(image.data(), image.size()) == LORAMAC_SNAPSHOT_SUCCESS) &&
+           sim::FleetImage::write_slot(config.image, device, device, image.data(),
+                                       static_cast<uint32_t>(image.size()));
+}
+
+/*!
+ * \brief Joins a device and sends config.uplinks uplinks of the mix, one
+ *        per interval, against a network server stand-in. Virtual time
+ *        jumps to the next timer, downlink or uplink. With a fleet image,
+ *        the device writes its snapshot at config.snapshot_at, before
+ *        anything else happens at that time.
+ *
+ * \param [IN]    config  Benchmark setup
+ * \param [IN]    device  Device index, seeds its random generator
+ * \param [INOUT] result  Results of the worker, the device adds its own
+ * \param [INOUT] latency Request latencies of the worker
+ */
+void run_device(const BenchConfig& config, uint32_t device, WorkerResult* result, sim::Histogram& latency)
+{
+    sim::Medium medium;
+    sim::NetworkServerConfig nsConfig;
+    sim::NetworkServer ns(medium, nsConfig);
+    sim::ReplayRecorder recorder;
+    LmHandlerParams_t params = {};
+    uint64_t sendErrors = 0;
+    uint32_t sent = 0;
+
+    ns.add_device(0, 0, kAppKey);
+    RadioAttachMedium(&medium);
+    RadioSetRandomSeed(config.seed, device);
+    RtcSetVirtualTime(0, 0);
+    Latency = &latency;
+
+    init_params(&params);
+
+    if (!config.record.empty()) {
+        sim::ReplaySetup setup = {};
+        string path = config.record + "/" + to_string(device) + ".replay";
+
+        setup.dev_eui = device;
+        setup.seed = config.seed;
+        setup.start = 0;
+        setup.region = params.Region;
+        setup.adr = params.AdrEnable;
+        setup.datarate = params.TxDatarate;
+        setup.duty_cycle = params.DutyCycleEnabled;
+        setup.public_network = params.PublicNetworkEnable;
+        if (!recorder.open(path, setup)) {
+            cerr << "Can not create " << path << "\n";
+            return;
+        }
+        RadioAttachRecorder(&recorder);
+    }
+
+    if (LmHandlerInit(&callbacks, &params) != LORAMAC_HANDLER_SUCCESS) {
+        return;
+    }
+
+    // A device that stops making progress gives up after this
+    sim::Time limit = (static_cast<sim::Time>(config.uplinks) + 10) * config.interval * 4;
+    sim::Time next = 0;
+    sim::Time snapshotAt = config.image.empty() ? UINT64_MAX : config.snapshot_at;
+    uint64_t snapshots = 0;
+    Clock::time_point start = Clock::now();
+
+    while (Uplinks < config.uplinks || LoRaMacIsBusy()) {
+        sim::Time now = min<sim::Time>({ TimerGetNextDeadline(), ns.next_downlink_time(), next, snapshotAt });
+
+        if (now > limit) {
+            break;
+        }
+        if (now > TimerGetCurrentTime()) {
+            RtcSetVirtualTime(static_cast<uint32_t>(now), RtcGetTimerContext());
+        }
+        if (snapshotAt <= now) {
+            snapshotAt = UINT64_MAX;
+            if (snapshot_device(config, device)) {
+                snapshots++;
+            }
+            else {
+                cerr << "Can not snapshot device " << device << " at " << now << "\n";
+            }
+        }
+        if (TimerGetNextDeadline() <= now) {
+            TimerIrqHandler();
+        }
+        ns.process(now);
+
+        if (next <= now) {
+            next += config.interval;
+            if (!LoRaMacIsBusy() && !Pending) {
+                if (!Joined) {
+                    recorder.record(TimerGetCurrentTime(), sim::ReplayEventType::join);
+                    LmHandlerJoin();
+                }
+                else if (sent < config.uplinks) {
+                    const Uplink& uplink = kUplinkMix[sent % (sizeof(kUplinkMix) / sizeof(kUplinkMix[0]))];
+                    LmHandlerAppData_t appData = { uplink.port, uplink.size, AppDataBuffer };
+
+                    memset(AppDataBuffer, static_cast<int>(sent), uplink.size);
+                    Pending = true;
+                    SentAt = Clock::now();
+                    recorder.record(TimerGetCurrentTime(), sim::ReplayEventType::send, AppDataBuffer, uplink.size,
+                                    uplink.port, uplink.confirmed);
+                    if (LmHandlerSend(&appData, uplink.confirmed ? LORAMAC_HANDLER_CONFIRMED_MSG :
+                                                                   LORAMAC_HANDLER_UNCONFIRMED_MSG) ==
+                        LORAMAC_HANDLER_SUCCESS) {
+                        sent++;
+                    }
+                    else {
+                        Pending = false;
+                        sendErrors++;
+                    }
+                }
+            }
+        }
+        LmHandlerProcess();
+        ns.process(now);
+    }
+
+    RadioAttachRecorder(NULL);
+    recorder.close();
+
+    result->devices++;
+    result->joined += Joined ? 1 : 0;
+    result->uplinks += Uplinks;
+    result->send_errors += sendErrors;
+    result->snapshots += snapshots;
+    result->wall_ns += chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+    result->virtual_ms += TimerGetCurrentTime();
+
+    uint64_t rss = rss_kb();
+    result->rss_kb += rss;
+    result->rss_kb_max = max(result->rss_kb_max, rss);
+}
+
+} // namespace
+
+int main(int ac, char* av[])
+{
+    BenchConfig config;
+    po::variables_map vm;
+
+    config.workers = max(1u, thread::hardware_concurrency());
+
+    try {
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h", "Help screen")
+            ("devices", po::value<uint32_t>(&config.devices)->default_value(config.devices), "Number of devices")
+            ("workers", po::value<unsigned>(&config.workers)->default_value(config.workers), "Device processes running at the same time")
+            ("uplinks", po::value<uint32_t>(&config.uplinks)->default_value(config.uplinks), "Uplinks sent by each device after joining")
+            ("interval", po::value<sim::Time>(&config.interval)->default_value(config.interval), "Time between two uplinks of a device [ms]")
+            ("seed", po::value<uint64_t>(&config.seed)->default_value(config.seed), "Simulation master seed")
+            ("record", po::value<string>(&config.record), "Log the inputs of each device to <dir>/<device>.replay, see //main:replay")
+            ("image", po::value<string>(&config.image), "Write the snapshot of every device to this fleet image")
+            ("snapshot-at", po::value<sim::Time>(&config.snapshot_at)->default_value(config.snapshot_at), "Virtual time of the fleet image [ms]")
+            ("hgrm", po::value<string>(), "Write the request latency distribution [us] to this .hgrm file");
+
+        po::store(po::parse_command_line(ac, av, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("help") || config.devices == 0 || config.workers == 0 || config.interval == 0) {
+            cout << desc << "\n";
+            return 1;
+        }
+    }
+    catch(exception& e) {
+        cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (!config.image.empty()) {
+        uint32_t slotSize = snapshot_size();
+
+        if (slotSize == 0 || !sim::FleetImage::create(config.image, config.devices, slotSize, config.snapshot_at)) {
+            cerr << "Can not create the fleet image " << config.image << "\n";
+            return 1;
+        }
+    }
+
+    sim::Histogram latency(kHighestLatency, kLatencyDigits);
+    size_t slotSize = sizeof(WorkerResult) + latency.counts_size() * sizeof(uint64_t);
+    size_t sharedSize = slotSize * config.workers;
+
+    // Each worker slot is written by one device process at a time
+    void* shared = mmap(nullptr, sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        cerr << "Can not map the results of " << config.workers << " workers\n";
+        return 1;
+    }
+    auto slot = [&](unsigned worker) {
+        return reinterpret_cast<WorkerResult*>(static_cast<uint8_t*>(shared) + slotSize * worker);
+    };
+
+    // The stack keeps one device per process, every device runs in a fresh
+    // fork
+    vector<pid_t> pids(config.workers, 0);
+    uint32_t next = 0;
+    unsigned running = 0;
+    uint32_t crashed = 0;
+    Clock::time_point start = Clock::now();
+
+    fflush(stdout);
+    while (next < config.devices || running > 0) {
+        if (next < config.devices && running < config.workers) {
+            unsigned worker = static_cast<unsigned>(find(pids.begin(), pids.end(), 0) - pids.begin());
+            pid_t pid = fork();
+
+            if (pid == 0) {
+                WorkerResult* result = slot(worker);
+                sim::Histogram deviceLatency(kHighestLatency, kLatencyDigits);
+                uint64_t* counts = reinterpret_cast<uint64_t*>(result + 1);
+
+                run_device(config, next, result, deviceLatency);
+                for (size_t i = 0; i < deviceLatency.counts_size(); i++) {
+                    counts[i] += deviceLatency.counts()[i];
+                }
+                _exit(0);
+            }
+            if (pid < 0) {
+                cerr << "Can not fork a device process\n";
+                break;
+            }
+            pids[worker] = pid;
+            next++;
+            running++;
+            continue;
+        }
+
+        int status = 0;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            break;
+        }
+        auto it = find(pids.begin(), pids.end(), pid);
+        if (it != pids.end()) {
+            *it = 0;
+            running--;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            crashed++;
+        }
+    }
+    double wall = chrono::duration<double>(Clock::now() - start).count();
+
+    WorkerResult total = {};
+    for (unsigned worker = 0; worker < config.workers; worker++) {
+        const WorkerResult* result = slot(worker);
+
+        total.devices += result->devices;
+        total.joined += result->joined;
+        total.uplinks += result->uplinks;
+        total.send_errors += result->send_errors;
+        total.snapshots += result->snapshots;
+        total.wall_ns += result->wall_ns;
+        total.virtual_ms += result->virtual_ms;
+        total.rss_kb += result->rss_kb;
+        total.rss_kb_max = max(total.rss_kb_max, result->rss_kb_max);
+        latency.add_counts(reinterpret_cast<const uint64_t*>(result + 1));
+    }
+    munmap(shared, sharedSize);
+
+    // Wall time a device spends per virtual ms, across the devices
+    double ratio = total.virtual_ms > 0 ? (total.wall_ns / 1e6) / total.virtual_ms : 0;
+
+    cout << "devices:          " << total.devices << " (" << config.workers << " workers, "
+                                 << crashed << " crashed)\n"
+         << "joined:           " << total.joined << "\n"
+         << "uplinks:          " << total.uplinks << " (" << total.send_errors << " send errors)\n"
+         << "snapshots:        " << total.snapshots << "\n"
+         << "wall time:        " << wall << " s\n"
+         << "uplinks/s:        " << (wall > 0 ? total.uplinks / wall : 0) << "\n"
+         << "wall/virtual:     " << ratio << "\n"
+         << "RSS per device:   " << (total.devices > 0 ? total.rss_kb / total.devices : 0) << " kB (max "
+                                 << total.rss_kb_max << " kB)\n"
+         << "latency p50:      " << latency.percentile(50) / 1e3 << " us\n"
+         << "latency p99:      " << latency.percentile(99) / 1e3 << " us\n"
+         << "latency p999:     " << latency.percentile(99.9) / 1e3 << " us\n"
+         << "latency max:      " << latency.max() / 1e3 << " us\n";
+
+    if (vm.count("hgrm")) {
+        FILE* file = fopen(vm["hgrm"].as<string>().c_str(), "w");
+
+        if (file == nullptr) {
+            cerr << "Can not create " << vm["hgrm"].as<string>() << "\n";
+            return 1;
+        }
+        latency.print(file, 1e3);
+        fclose(file);
+    }
+
+    bool imaged = config.image.empty() || total.snapshots == config.devices;
+    return (crashed == 0 && total.joined == config.devices && imaged) ? 0 : 2;
+}
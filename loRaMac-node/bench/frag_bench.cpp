@@ -0,0 +1,67 @@
+#include <cstring>
+#include <benchmark/benchmark.h>
+
+extern "C" {
+#include "FragDecoder.h"
+}
+
+namespace {
+
+uint8_t File[FRAG_MAX_NB * FRAG_MAX_SIZE];
+
+int8_t FragDecoderWrite(uint32_t addr, uint8_t* data, uint32_t size)
+{
+    if (addr + size > sizeof(File)) {
+        return -1;
+    }
+    std::memcpy(File + addr, data, size);
+    return 0;
+}
+
+int8_t FragDecoderRead(uint32_t addr, uint8_t* data, uint32_t size)
+{
+    if (addr + size > sizeof(File)) {
+        return -1;
+    }
+    std::memcpy(data, File + addr, size);
+    return 0;
+}
+
+FragDecoderCallbacks_t callbacks = { FragDecoderWrite, FragDecoderRead };
+
+/*!
+ * \brief Receives a whole fragmentation session, the given number of
+ *        fragments are lost and recovered from the redundancy fragments
+ */
+void BM_FragDecoderProcess(benchmark::State& state)
+{
+    uint16_t fragNb = FRAG_MAX_NB;
+    uint16_t lost = static_cast<uint16_t>(state.range(0));
+    uint8_t fragment[FRAG_MAX_SIZE];
+    int64_t fragments = 0;
+
+    for (size_t i = 0; i < sizeof(fragment); i++) {
+        fragment[i] = static_cast<uint8_t>(i * 13 + 5);
+    }
+
+    for (auto _ : state) {
+        int32_t status = FRAG_SESSION_ONGOING;
+
+        FragDecoderInit(fragNb, FRAG_MAX_SIZE, &callbacks);
+        // The first fragments are lost, all of them are needed to decode
+        for (uint16_t counter = lost + 1; counter <= fragNb; counter++) {
+            status = FragDecoderProcess(counter, fragment);
+            fragments++;
+        }
+        for (uint16_t counter = fragNb + 1;
+             counter <= fragNb + FRAG_MAX_REDUNDANCY && status == FRAG_SESSION_ONGOING; counter++) {
+            status = FragDecoderProcess(counter, fragment);
+            fragments++;
+        }
+        benchmark::DoNotOptimize(status);
+    }
+    state.SetItemsProcessed(fragments);
+}
+BENCHMARK(BM_FragDecoderProcess)->Arg(0)->Arg(1)->Arg(FRAG_MAX_REDUNDANCY);
+
+} // namespace
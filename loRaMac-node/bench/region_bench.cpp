@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+
+#include "radio.h"
+#include "Region.h"
+
+namespace {
+
+void BM_RegionNextChannel(benchmark::State& state, LoRaMacRegion_t region, int8_t datarate, bool dutyCycle)
+{
+    InitDefaultsParams_t params = {};
+    NextChanParams_t next = {};
+    uint8_t channel = 0;
+    TimerTime_t time = 0;
+    TimerTime_t aggrTimeOff = 0;
+
+    params.Type = INIT_TYPE_DEFAULTS;
+    RegionInitDefaults(region, &params);
+
+    next.Datarate = datarate;
+    next.Joined = true;
+    next.DutyCycleEnabled = dutyCycle;
+    next.PktLen = 24;
+
+    for (auto _ : state) {
+        // Each call consumes a channel of the remaining mask, like an uplink
+        if (RegionNextChannel(region, &next, &channel, &time, &aggrTimeOff) != LORAMAC_STATUS_OK) {
+            state.SkipWithError("RegionNextChannel found no channel");
+            break;
+        }
+        benchmark::DoNotOptimize(channel);
+    }
+}
+BENCHMARK_CAPTURE(BM_RegionNextChannel, US915, LORAMAC_REGION_US915, DR_0, false);
+BENCHMARK_CAPTURE(BM_RegionNextChannel, EU868, LORAMAC_REGION_EU868, DR_5, true);
+BENCHMARK_CAPTURE(BM_RegionNextChannel, CN470, LORAMAC_REGION_CN470, DR_5, false);
+
+// LoRa 125 kHz, CR 4/5, 8 symbols preamble, explicit header and CRC
+void BM_RadioTimeOnAir(benchmark::State& state)
+{
+    uint32_t datarate = static_cast<uint32_t>(state.range(0));
+    uint8_t payloadLen = static_cast<uint8_t>(state.range(1));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Radio.TimeOnAir(MODEM_LORA, 0, datarate, 1, 8, false, payloadLen, true));
+    }
+}
+BENCHMARK(BM_RadioTimeOnAir)->ArgsProduct({ { 7, 10, 12 }, { 13, 64, 242 } });
+
+} // namespace
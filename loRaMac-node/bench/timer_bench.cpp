@@ -0,0 +1,94 @@
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "rtc.h"
+#include "timer.h"
+
+namespace {
+
+// Timers of the MAC layer and of the application packages
+constexpr uint32_t kPeriod = 1000;
+constexpr TimerTime_t kClockLimit = 1u << 31;
+
+void set_clock(TimerTime_t time)
+{
+    RtcSetVirtualTime(time, RtcGetTimerContext());
+}
+
+void OnTimerEvent(void* context)
+{
+    // A periodic timer, the list keeps its length
+    TimerEvent_t* timer = static_cast<TimerEvent_t*>(context);
+
+    TimerStart(timer);
+}
+
+void OnProbeEvent(void* context)
+{
+}
+
+/*!
+ * \brief Starts periodic timers, their deadlines spread over a period
+ */
+void start_timers(std::vector<TimerEvent_t>& timers)
+{
+    set_clock(0);
+    for (size_t i = 0; i < timers.size(); i++) {
+        TimerInit(&timers[i], OnTimerEvent);
+        TimerSetContext(&timers[i], &timers[i]);
+        TimerSetValue(&timers[i], kPeriod);
+        set_clock(i * kPeriod / timers.size());
+        TimerStart(&timers[i]);
+    }
+}
+
+void stop_timers(std::vector<TimerEvent_t>& timers)
+{
+    for (TimerEvent_t& timer : timers) {
+        TimerStop(&timer);
+    }
+}
+
+// Inserts a timer in the middle of a list of running timers and removes it
+void BM_TimerInsert(benchmark::State& state)
+{
+    std::vector<TimerEvent_t> timers(state.range(0));
+    TimerEvent_t probe;
+
+    start_timers(timers);
+    TimerInit(&probe, OnProbeEvent);
+    TimerSetValue(&probe, kPeriod / 2);
+
+    for (auto _ : state) {
+        TimerStart(&probe);
+        TimerStop(&probe);
+    }
+    stop_timers(timers);
+}
+BENCHMARK(BM_TimerInsert)->Arg(1)->Arg(8)->Arg(64);
+
+// Expires the head of the list, the callback starts it again
+void BM_TimerExpire(benchmark::State& state)
+{
+    std::vector<TimerEvent_t> timers(state.range(0));
+
+    start_timers(timers);
+    for (auto _ : state) {
+        TimerTime_t deadline = TimerGetNextDeadline();
+
+        if (deadline > kClockLimit) {
+            // Start over well before the 32 bit clock wraps
+            state.PauseTiming();
+            stop_timers(timers);
+            start_timers(timers);
+            deadline = TimerGetNextDeadline();
+            state.ResumeTiming();
+        }
+        set_clock(deadline);
+        TimerIrqHandler();
+    }
+    stop_timers(timers);
+}
+BENCHMARK(BM_TimerExpire)->Arg(1)->Arg(8)->Arg(64);
+
+} // namespace
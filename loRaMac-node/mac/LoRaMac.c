@@ -44,6 +44,7 @@
 #include "LoRaMacCommands.h"
 #include "LoRaMacAdr.h"
 #include "LoRaMacSerializer.h"
+#include "LoRaMacTrace.h"
 
 #include "LoRaMac.h"
 
@@ -339,6 +340,15 @@ typedef struct sLoRaMacCtx
     * Duty cycle wait time
     */
     TimerTime_t DutyCycleWaitTime;
+    /*
+    * Device pseudo random generator. Used for channel selection, back-off
+    * and retransmission timeouts.
+    */
+    RandCtx_t Rand;
+    /*
+    * Cache of the PHY parameters used on every uplink and downlink
+    */
+    RegionPhyCache_t PhyCache;
 }LoRaMacCtx_t;
 
 /*
@@ -583,6 +593,19 @@ LoRaMacStatus_t SendFrameOnChannel( uint8_t channel );
  */
 LoRaMacStatus_t SetTxContinuousWave( uint16_t timeout, uint32_t frequency, uint8_t power );
 
+/*!
+ * \brief Updates the radio address filter with the device address and the
+ *        enabled multicast groups
+ */
+static void UpdateRadioAddressFilter( void );
+
+/*!
+ * \brief Returns the PHY parameter cache, rebuilds it if it is not valid
+ *
+ * \retval Pointer to the valid PHY parameter cache
+ */
+static RegionPhyCache_t* GetPhyCache( void );
+
 /*!
  * \brief Resets MAC specific parameters to default
  */
@@ -918,10 +941,10 @@ static void PrepareRxDoneAbort( void )
 
 static void ProcessRadioRxDone( void )
 {
+    LORAMAC_TRACE_SPAN( "ProcessRadioRxDone" );
+
     LoRaMacHeader_t macHdr;
     ApplyCFListParams_t applyCFList;
-    GetPhyParams_t getPhy;
-    PhyParam_t phyParam;
     LoRaMacCryptoStatus_t macCryptoStatus = LORAMAC_CRYPTO_ERROR;
 
     LoRaMacMessageData_t macMsgData;
@@ -932,6 +955,7 @@ static void ProcessRadioRxDone( void )
     int8_t snr = RxDoneParams.Snr;
 
     uint8_t pktHeaderLen = 0;
+    uint8_t maxPayload = 0;
 
     uint32_t downLinkCounter = 0;
     uint32_t address = MacCtx.NvmCtx->DevAddr;
@@ -1026,6 +1050,7 @@ static void ProcessRadioRxDone( void )
                 RegionApplyCFList( MacCtx.NvmCtx->Region, &applyCFList );
 
                 MacCtx.NvmCtx->NetworkActivation = ACTIVATION_TYPE_OTAA;
+                UpdateRadioAddressFilter( );
 
                 // MLME handling
                 if( LoRaMacConfirmQueueIsCmdActive( MLME_JOIN ) == true )
@@ -1047,21 +1072,18 @@ static void ProcessRadioRxDone( void )
             // Intentional fall through
         case FRAME_TYPE_DATA_UNCONFIRMED_DOWN:
             // Check if the received payload size is valid
-            getPhy.UplinkDwellTime = MacCtx.NvmCtx->MacParams.DownlinkDwellTime;
-            getPhy.Datarate = MacCtx.McpsIndication.RxDatarate;
-            getPhy.Attribute = PHY_MAX_PAYLOAD;
-            phyParam = RegionGetPhyParam( MacCtx.NvmCtx->Region, &getPhy );
-            if( ( MAX( 0, ( int16_t )( ( int16_t ) size - ( int16_t ) LORAMAC_FRAME_PAYLOAD_OVERHEAD_SIZE ) ) > ( int16_t )phyParam.Value ) ||
+            maxPayload = RegionPhyCacheGetMaxPayload( GetPhyCache( ), MacCtx.McpsIndication.RxDatarate, true );
+            if( ( MAX( 0, ( int16_t )( ( int16_t ) size - ( int16_t ) LORAMAC_FRAME_PAYLOAD_OVERHEAD_SIZE ) ) > ( int16_t )maxPayload ) ||
                 ( size < LORAMAC_FRAME_PAYLOAD_MIN_SIZE ) )
             {
                 MacCtx.McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
                 PrepareRxDoneAbort( );
                 return;
             }
+            // Parse the frame once, the following steps operate on the
+            // parsed message. The payload is decrypted in place.
             macMsgData.Buffer = payload;
             macMsgData.BufSize = size;
-            macMsgData.FRMPayload = MacCtx.RxPayload;
-            macMsgData.FRMPayloadSize = LORAMAC_PHY_MAXPAYLOAD;
 
             if( LORAMAC_PARSER_SUCCESS != LoRaMacParserData( &macMsgData ) )
             {
@@ -1237,8 +1259,12 @@ static void ProcessRadioRxDone( void )
                     * +----------+------+-------+--------------+
                     */
 
-                    // Decode MAC commands in FOpts field
-                    ProcessMacCommands( macMsgData.FHDR.FOpts, 0, macMsgData.FHDR.FCtrl.Bits.FOptsLen, snr, MacCtx.McpsIndication.RxSlot );
+                    // Decode MAC commands in FOpts field, if any. An empty
+                    // frame only carries the ACK.
+                    if( macMsgData.FHDR.FCtrl.Bits.FOptsLen > 0 )
+                    {
+                        ProcessMacCommands( macMsgData.FHDR.FOpts, 0, macMsgData.FHDR.FCtrl.Bits.FOptsLen, snr, MacCtx.McpsIndication.RxSlot );
+                    }
                     MacCtx.McpsIndication.Port = macMsgData.FPort;
                     break;
                 }
@@ -1625,6 +1651,8 @@ void LoRaMacProcess( void )
 {
     uint8_t noTx = false;
 
+    LORAMAC_TRACE_SPAN( "LoRaMacProcess" );
+
     LoRaMacHandleIrqEvents( );
     LoRaMacClassBProcess( );
 
@@ -1860,16 +1888,7 @@ static LoRaMacStatus_t SwitchClass( DeviceClass_t deviceClass )
 
 static uint8_t GetMaxAppPayloadWithoutFOptsLength( int8_t datarate )
 {
-    GetPhyParams_t getPhy;
-    PhyParam_t phyParam;
-
-    // Setup PHY request
-    getPhy.UplinkDwellTime = MacCtx.NvmCtx->MacParams.UplinkDwellTime;
-    getPhy.Datarate = datarate;
-    getPhy.Attribute = PHY_MAX_PAYLOAD;
-    phyParam = RegionGetPhyParam( MacCtx.NvmCtx->Region, &getPhy );
-
-    return phyParam.Value;
+    return RegionPhyCacheGetMaxPayload( GetPhyCache( ), datarate, false );
 }
 
 static bool ValidatePayloadLength( uint8_t lenN, int8_t datarate, uint8_t fOptsLen )
@@ -1897,6 +1916,8 @@ static void SetMlmeScheduleUplinkIndication( void )
 
 static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, int8_t snr, LoRaMacRxSlot_t rxSlot )
 {
+    LORAMAC_TRACE_SPAN( "ProcessMacCommands" );
+
     uint8_t status = 0;
     bool adrBlockFound = false;
     uint8_t macCmdPayload[2] = { 0x00, 0x00 };
@@ -2082,6 +2103,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                 LoRaMacCommandsAddCmd( MOTE_MAC_NEW_CHANNEL_ANS, macCmdPayload, 1 );
                 if( status == 0x03 )
                 {
+                    RegionPhyCacheInvalidate( &MacCtx.PhyCache );
                     EventRegionNvmCtxChanged( );
                 }
                 break;
@@ -2105,8 +2127,6 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
             case SRV_MAC_TX_PARAM_SETUP_REQ:
             {
                 TxParamSetupReqParams_t txParamSetupReq;
-                GetPhyParams_t getPhy;
-                PhyParam_t phyParam;
                 uint8_t eirpDwellTime = payload[macIndex++];
 
                 txParamSetupReq.UplinkDwellTime = 0;
@@ -2129,11 +2149,10 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     MacCtx.NvmCtx->MacParams.UplinkDwellTime = txParamSetupReq.UplinkDwellTime;
                     MacCtx.NvmCtx->MacParams.DownlinkDwellTime = txParamSetupReq.DownlinkDwellTime;
                     MacCtx.NvmCtx->MacParams.MaxEirp = LoRaMacMaxEirpTable[txParamSetupReq.MaxEirp];
+                    // The dwell time settings changed
+                    RegionPhyCacheInvalidate( &MacCtx.PhyCache );
                     // Update the datarate in case of the new configuration limits it
-                    getPhy.Attribute = PHY_MIN_TX_DR;
-                    getPhy.UplinkDwellTime = MacCtx.NvmCtx->MacParams.UplinkDwellTime;
-                    phyParam = RegionGetPhyParam( MacCtx.NvmCtx->Region, &getPhy );
-                    MacCtx.NvmCtx->MacParams.ChannelsDatarate = MAX( MacCtx.NvmCtx->MacParams.ChannelsDatarate, ( int8_t )phyParam.Value );
+                    MacCtx.NvmCtx->MacParams.ChannelsDatarate = MAX( MacCtx.NvmCtx->MacParams.ChannelsDatarate, GetPhyCache( )->MinTxDr );
 
                     // Add command response
                     LoRaMacCommandsAddCmd( MOTE_MAC_TX_PARAM_SETUP_ANS, macCmdPayload, 0 );
@@ -2331,6 +2350,7 @@ LoRaMacStatus_t Send( LoRaMacHeader_t* macHdr, uint8_t fPort, void* fBuffer, uin
     adrNext.NbTrans = MacCtx.NvmCtx->MacParams.ChannelsNbTrans;
     adrNext.UplinkDwellTime = MacCtx.NvmCtx->MacParams.UplinkDwellTime;
     adrNext.Region = MacCtx.NvmCtx->Region;
+    adrNext.PhyCache = GetPhyCache( );
 
     fCtrl.Bits.AdrAckReq = LoRaMacAdrCalcNext( &adrNext, &MacCtx.NvmCtx->MacParams.ChannelsDatarate,
                                                &MacCtx.NvmCtx->MacParams.ChannelsTxPower,
@@ -2507,6 +2527,8 @@ static LoRaMacStatus_t SerializeTxFrame( void )
 
 static LoRaMacStatus_t ScheduleTx( bool allowDelayedTx )
 {
+    LORAMAC_TRACE_SPAN( "ScheduleTx" );
+
     LoRaMacStatus_t status = LORAMAC_STATUS_PARAMETER_INVALID;
     NextChanParams_t nextChan;
 
@@ -2544,7 +2566,9 @@ static LoRaMacStatus_t ScheduleTx( bool allowDelayedTx )
     }
 
     // Select channel
+    LORAMAC_TRACE_BEGIN( nextChannelSpan, "RegionNextChannel" );
     status = RegionNextChannel( MacCtx.NvmCtx->Region, &nextChan, &MacCtx.Channel, &MacCtx.DutyCycleWaitTime, &MacCtx.NvmCtx->AggregatedTimeOff );
+    LORAMAC_TRACE_END( nextChannelSpan );
 
     if( status != LORAMAC_STATUS_OK )
     {
@@ -2583,6 +2607,8 @@ static LoRaMacStatus_t ScheduleTx( bool allowDelayedTx )
 
 static LoRaMacStatus_t SecureFrame( uint8_t txDr, uint8_t txCh )
 {
+    LORAMAC_TRACE_SPAN( "SecureFrame" );
+
     LoRaMacCryptoStatus_t macCryptoStatus = LORAMAC_CRYPTO_ERROR;
     uint32_t fCntUp = 0;
 
@@ -2656,6 +2682,37 @@ static void RemoveMacCommands( LoRaMacRxSlot_t rxSlot, LoRaMacFrameCtrl_t fCtrl,
 }
 
 
+static void UpdateRadioAddressFilter( void )
+{
+    if( ( Radio.SetAddressFilter == NULL ) || ( Radio.SetJoinFilter == NULL ) )
+    {
+        return;
+    }
+
+    // Slot 0 holds the device address, it is unset until the device is joined
+    Radio.SetAddressFilter( 0, MacCtx.NvmCtx->DevAddr, MacCtx.NvmCtx->DevAddr != 0 );
+    // A join-accept is only taken while no session is active, a device
+    // joining again still has the DevAddr of its previous session
+    Radio.SetJoinFilter( MacCtx.NvmCtx->NetworkActivation == ACTIVATION_TYPE_NONE );
+    for( uint8_t i = 0; i < LORAMAC_MAX_MC_CTX; i++ )
+    {
+        Radio.SetAddressFilter( i + 1, MacCtx.NvmCtx->MulticastChannelList[i].ChannelParams.Address,
+                                MacCtx.NvmCtx->MulticastChannelList[i].ChannelParams.IsEnabled );
+    }
+}
+
+static RegionPhyCache_t* GetPhyCache( void )
+{
+    if( ( MacCtx.PhyCache.Valid == false ) ||
+        ( MacCtx.PhyCache.Region != MacCtx.NvmCtx->Region ) )
+    {
+        RegionPhyCacheInit( &MacCtx.PhyCache, MacCtx.NvmCtx->Region,
+                            MacCtx.NvmCtx->MacParams.UplinkDwellTime,
+                            MacCtx.NvmCtx->MacParams.DownlinkDwellTime );
+    }
+    return &MacCtx.PhyCache;
+}
+
 static void ResetMacParameters( void )
 {
     LoRaMacClassBCallback_t classBCallbacks;
@@ -2681,6 +2738,7 @@ static void ResetMacParameters( void )
     MacCtx.NvmCtx->MacParams.DownlinkDwellTime = MacCtx.NvmCtx->MacParamsDefaults.DownlinkDwellTime;
     MacCtx.NvmCtx->MacParams.MaxEirp = MacCtx.NvmCtx->MacParamsDefaults.MaxEirp;
     MacCtx.NvmCtx->MacParams.AntennaGain = MacCtx.NvmCtx->MacParamsDefaults.AntennaGain;
+    RegionPhyCacheInvalidate( &MacCtx.PhyCache );
 
     MacCtx.NodeAckRequested = false;
     MacCtx.NvmCtx->SrvAckRequested = false;
@@ -2729,6 +2787,8 @@ static void ResetMacParameters( void )
     classBParams.MulticastChannels = &MacCtx.NvmCtx->MulticastChannelList[0];
 
     LoRaMacClassBInit( &classBParams, &classBCallbacks, &EventClassBNvmCtxChanged );
+
+    UpdateRadioAddressFilter( );
 }
 
 /*!
@@ -2881,6 +2941,8 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t* macHdr, LoRaMacFrameCtrl_t* fCtrl
 
 LoRaMacStatus_t SendFrameOnChannel( uint8_t channel )
 {
+    LORAMAC_TRACE_SPAN( "SendFrameOnChannel" );
+
     LoRaMacStatus_t status = LORAMAC_STATUS_PARAMETER_INVALID;
     TxConfigParams_t txConfig;
     int8_t txPower = 0;
@@ -2986,6 +3048,10 @@ LoRaMacStatus_t RestoreCtxs( LoRaMacCtxs_t* contexts )
     params.NvmCtx = contexts->RegionNvmCtx;
     RegionInitDefaults( MacCtx.NvmCtx->Region, &params );
 
+    // The restored context may use other dwell time settings
+    RegionPhyCacheInvalidate( &MacCtx.PhyCache );
+    UpdateRadioAddressFilter( );
+
     // Initialize RxC config parameters.
     MacCtx.RxWindowCConfig.Channel = MacCtx.Channel;
     MacCtx.RxWindowCConfig.Frequency = MacCtx.NvmCtx->MacParams.RxCChannel.Frequency;
@@ -3390,8 +3456,12 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t* primitives, LoRaMacC
         return LORAMAC_STATUS_CRYPTO_ERROR;
     }
 
-    // Random seed initialization
-    srand1( Radio.Random( ) );
+    // Random seed initialization. The device owns its generator, the seed is
+    // drawn from the radio which is seeded per device by the simulation.
+    uint64_t seed = Radio.Random( );
+    seed = ( seed << 32 ) | Radio.Random( );
+    RandCtxSeed( &MacCtx.Rand, seed );
+    RandSetCtx( &MacCtx.Rand );
 
     Radio.SetPublicNetwork( MacCtx.NvmCtx->PublicNetwork );
     Radio.Sleep( );
@@ -3446,6 +3516,7 @@ LoRaMacStatus_t LoRaMacQueryTxPossible( uint8_t size, LoRaMacTxInfo_t* txInfo )
     adrNext.NbTrans = MacCtx.ChannelsNbTransCounter;
     adrNext.UplinkDwellTime = MacCtx.NvmCtx->MacParams.UplinkDwellTime;
     adrNext.Region = MacCtx.NvmCtx->Region;
+    adrNext.PhyCache = GetPhyCache( );
 
     // We call the function for information purposes only. We don't want to
     // apply the datarate, the tx power and the ADR ack counter.
@@ -3699,6 +3770,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t* mibSet )
             if( mibSet->Param.NetworkActivation != ACTIVATION_TYPE_OTAA  )
             {
                 MacCtx.NvmCtx->NetworkActivation = mibSet->Param.NetworkActivation;
+                UpdateRadioAddressFilter( );
             }
             else
             {   // Do not allow to set ACTIVATION_TYPE_OTAA since the MAC will set it automatically after a successful join process.
@@ -3743,6 +3815,7 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t* mibSet )
         case MIB_DEV_ADDR:
         {
             MacCtx.NvmCtx->DevAddr = mibSet->Param.DevAddr;
+            UpdateRadioAddressFilter( );
             break;
         }
         case MIB_APP_KEY:
@@ -4330,6 +4403,7 @@ LoRaMacStatus_t LoRaMacChannelAdd( uint8_t id, ChannelParams_t params )
     channelAdd.NewChannel = &params;
     channelAdd.ChannelId = id;
 
+    RegionPhyCacheInvalidate( &MacCtx.PhyCache );
     EventRegionNvmCtxChanged( );
     return RegionChannelAdd( MacCtx.NvmCtx->Region, &channelAdd );
 }
@@ -4353,6 +4427,7 @@ LoRaMacStatus_t LoRaMacChannelRemove( uint8_t id )
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
 
+    RegionPhyCacheInvalidate( &MacCtx.PhyCache );
     EventRegionNvmCtxChanged( );
     return LORAMAC_STATUS_OK;
 }
@@ -4407,6 +4482,7 @@ LoRaMacStatus_t LoRaMacMcChannelSetup( McChannelParams_t *channel )
     // Reset multicast channel downlink counter to initial value.
     *MacCtx.NvmCtx->MulticastChannelList[channel->GroupID].DownLinkCounter = FCNT_DOWN_INITAL_VALUE;
 
+    UpdateRadioAddressFilter( );
     EventMacNvmCtxChanged( );
     EventRegionNvmCtxChanged( );
     return LORAMAC_STATUS_OK;
@@ -4432,6 +4508,7 @@ LoRaMacStatus_t LoRaMacMcChannelDelete( AddressIdentifier_t groupID )
 
     MacCtx.NvmCtx->MulticastChannelList[groupID].ChannelParams = channel;
 
+    UpdateRadioAddressFilter( );
     EventMacNvmCtxChanged( );
     EventRegionNvmCtxChanged( );
     return LORAMAC_STATUS_OK;
@@ -4663,8 +4740,6 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t* mlmeRequest )
 
 LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t* mcpsRequest )
 {
-    GetPhyParams_t getPhy;
-    PhyParam_t phyParam;
     LoRaMacStatus_t status = LORAMAC_STATUS_SERVICE_UNKNOWN;
     LoRaMacHeader_t macHdr;
     VerifyParams_t verify;
@@ -4725,13 +4800,9 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t* mcpsRequest )
             break;
     }
 
-    // Get the minimum possible datarate
-    getPhy.Attribute = PHY_MIN_TX_DR;
-    getPhy.UplinkDwellTime = MacCtx.NvmCtx->MacParams.UplinkDwellTime;
-    phyParam = RegionGetPhyParam( MacCtx.NvmCtx->Region, &getPhy );
     // Apply the minimum possible datarate.
     // Some regions have limitations for the minimum datarate.
-    datarate = MAX( datarate, ( int8_t )phyParam.Value );
+    datarate = MAX( datarate, GetPhyCache( )->MinTxDr );
 
     if( readyToSend == true )
     {
@@ -51,10 +51,17 @@ bool LoRaMacAdrCalcNext( CalcNextAdrParams_t* adrNext, int8_t* drOut, int8_t* tx
     if( adrNext->AdrEnabled == true )
     {
         // Query minimum TX Datarate
-        getPhy.Attribute = PHY_MIN_TX_DR;
-        getPhy.UplinkDwellTime = adrNext->UplinkDwellTime;
-        phyParam = RegionGetPhyParam( adrNext->Region, &getPhy );
-        minTxDatarate = phyParam.Value;
+        if( adrNext->PhyCache != NULL )
+        {
+            minTxDatarate = adrNext->PhyCache->MinTxDr;
+        }
+        else
+        {
+            getPhy.Attribute = PHY_MIN_TX_DR;
+            getPhy.UplinkDwellTime = adrNext->UplinkDwellTime;
+            phyParam = RegionGetPhyParam( adrNext->Region, &getPhy );
+            minTxDatarate = phyParam.Value;
+        }
         datarate = MAX( datarate, minTxDatarate );
 
         // Verify if ADR ack req bit needs to be set.
@@ -67,9 +74,16 @@ bool LoRaMacAdrCalcNext( CalcNextAdrParams_t* adrNext, int8_t* drOut, int8_t* tx
         if( adrNext->AdrAckCounter >= ( adrNext->AdrAckLimit + adrNext->AdrAckDelay ) )
         {
             // Set TX Power to default
-            getPhy.Attribute = PHY_DEF_TX_POWER;
-            phyParam = RegionGetPhyParam( adrNext->Region, &getPhy );
-            txPower = phyParam.Value;
+            if( adrNext->PhyCache != NULL )
+            {
+                txPower = adrNext->PhyCache->DefTxPower;
+            }
+            else
+            {
+                getPhy.Attribute = PHY_DEF_TX_POWER;
+                phyParam = RegionGetPhyParam( adrNext->Region, &getPhy );
+                txPower = phyParam.Value;
+            }
         }
 
         // Verify, if we need to decrease the data rate
@@ -93,11 +107,18 @@ bool LoRaMacAdrCalcNext( CalcNextAdrParams_t* adrNext, int8_t* drOut, int8_t* tx
                 }
 
                 // Decrease the datarate
-                getPhy.Attribute = PHY_NEXT_LOWER_TX_DR;
-                getPhy.Datarate = datarate;
-                getPhy.UplinkDwellTime = adrNext->UplinkDwellTime;
-                phyParam = RegionGetPhyParam( adrNext->Region, &getPhy );
-                datarate = phyParam.Value;
+                if( adrNext->PhyCache != NULL )
+                {
+                    datarate = RegionPhyCacheGetNextLowerTxDr( adrNext->PhyCache, datarate );
+                }
+                else
+                {
+                    getPhy.Attribute = PHY_NEXT_LOWER_TX_DR;
+                    getPhy.Datarate = datarate;
+                    getPhy.UplinkDwellTime = adrNext->UplinkDwellTime;
+                    phyParam = RegionGetPhyParam( adrNext->Region, &getPhy );
+                    datarate = phyParam.Value;
+                }
             }
         }
     }
@@ -89,6 +89,11 @@ typedef struct sCalcNextAdrParams
      * Region
      */
     LoRaMacRegion_t Region;
+    /*!
+     * PHY parameter cache of the device. The PHY parameters are queried
+     * from the region, if set to NULL.
+     */
+    RegionPhyCache_t* PhyCache;
 }CalcNextAdrParams_t;
 
 /*!
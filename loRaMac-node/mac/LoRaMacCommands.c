@@ -30,24 +30,49 @@ Maintainer: Miguel Luis ( Semtech ), Daniel Jaeckle ( STACKFORCE ), Johannes Bru
 #define NUM_OF_MAC_COMMANDS 32
 #endif
 
+#if ( NUM_OF_MAC_COMMANDS > 32 )
+#error "NUM_OF_MAC_COMMANDS exceeds the size of the free slots bitmap"
+#endif
+
 /*!
  * Size of the CID field of MAC commands
  */
 #define CID_FIELD_SIZE 1
 
+/*!
+ * Slot index marking the end of the MAC command list
+ */
+#define MAC_COMMAND_SLOT_NONE 0xFF
+
+/*!
+ * Bitmap with a bit set for each MAC command slot
+ */
+#define MAC_COMMAND_SLOTS_ALL ( ( NUM_OF_MAC_COMMANDS == 32 ) ? 0xFFFFFFFFUL : ( ( 1UL << NUM_OF_MAC_COMMANDS ) - 1 ) )
+
+/*!
+ * Layout version of the non-volatile module context. Shall be incremented
+ * on each change of LoRaMacCommandsCtx_t or MacCommand_t.
+ */
+#define LORAMAC_COMMANDS_NVM_CTX_VERSION 2
+
+/*!
+ * Size of the serialized MAC commands buffer
+ */
+#define SERIALIZED_CMDS_BUFFER_SIZE ( NUM_OF_MAC_COMMANDS * ( CID_FIELD_SIZE + LORAMAC_COMMADS_MAX_NUM_OF_PARAMS ) )
+
 /*!
  *  Mac Commands list structure
  */
 typedef struct sMacCommandsList
 {
     /*
-     * First element of MAC command list.
+     * Slot index of the first element of MAC command list.
      */
-    MacCommand_t* First;
+    uint8_t First;
     /*
-     * Last element of MAC command list.
+     * Slot index of the last element of MAC command list.
      */
-    MacCommand_t* Last;
+    uint8_t Last;
 } MacCommandsList_t;
 
 /*!
@@ -55,10 +80,18 @@ typedef struct sMacCommandsList
  */
 typedef struct sLoRaMacCommandsCtx
 {
+    /*
+     * Layout version of the context
+     */
+    uint8_t Version;
     /*
      * List of MAC command elements
      */
     MacCommandsList_t MacCommandList;
+    /*
+     * Bitmap of free slots. Bit n is set, if MacCommandSlots[n] is free.
+     */
+    uint32_t FreeSlots;
     /*
      * Buffer to store MAC command elements
      */
@@ -66,9 +99,30 @@ typedef struct sLoRaMacCommandsCtx
     /*
      * Size of all MAC commands serialized as buffer
      */
-    size_t SerializedCmdsSize;
+    uint16_t SerializedCmdsSize;
+    /*
+     * Number of sticky MAC commands in the list
+     */
+    uint8_t NbStickyCmds;
 } LoRaMacCommandsCtx_t;
 
+/*!
+ * Serialized MAC commands cache. Not part of the non-volatile context, it
+ * is rebuilt from the MAC command list when needed.
+ */
+typedef struct sLoRaMacCommandsCache
+{
+    /*
+     * Set while SerializedCmds holds the MAC command list. Appending keeps
+     * it valid, removing a single command invalidates it.
+     */
+    bool IsValid;
+    /*
+     * All MAC commands of the list serialized in list order
+     */
+    uint8_t SerializedCmds[SERIALIZED_CMDS_BUFFER_SIZE];
+} LoRaMacCommandsCache_t;
+
 /*!
  * Callback function to notify the upper layer about context change
  */
@@ -79,26 +133,42 @@ static LoRaMacCommandsNvmEvent CommandsNvmCtxChanged;
  */
 static LoRaMacCommandsCtx_t NvmCtx;
 
+/*!
+ * Volatile module context.
+ */
+static LoRaMacCommandsCache_t Cache;
+
 /* Memory management functions */
 
 /*!
- * \brief Determines if a MAC command slot is free
+ * \brief Returns the MAC command stored at a slot index
  *
- * \param[IN]     slot           - Slot to check
- * \retval                       - Status of the operation
+ * \param[IN]     index          - Slot index
+ * \retval                       - Pointer to slot, NULL for MAC_COMMAND_SLOT_NONE
  */
-static bool IsSlotFree( const MacCommand_t* slot )
+static inline MacCommand_t* GetSlot( uint8_t index )
 {
-    uint8_t* mem = ( uint8_t* )slot;
+    if( index == MAC_COMMAND_SLOT_NONE )
+    {
+        return NULL;
+    }
+    return &NvmCtx.MacCommandSlots[index];
+}
 
-    for( uint16_t size = 0; size < sizeof( MacCommand_t ); size++ )
+/*!
+ * \brief Returns the slot index of a MAC command
+ *
+ * \param[IN]     slot           - Slot
+ * \retval                       - Slot index, MAC_COMMAND_SLOT_NONE if the slot
+ *                                 is not part of the slots buffer
+ */
+static uint8_t GetSlotIndex( const MacCommand_t* slot )
+{
+    if( ( slot < NvmCtx.MacCommandSlots ) || ( slot >= &NvmCtx.MacCommandSlots[NUM_OF_MAC_COMMANDS] ) )
     {
-        if( mem[size] != 0x00 )
-        {
-            return false;
-        }
+        return MAC_COMMAND_SLOT_NONE;
     }
-    return true;
+    return ( uint8_t )( slot - NvmCtx.MacCommandSlots );
 }
 
 /*!
@@ -108,18 +178,18 @@ static bool IsSlotFree( const MacCommand_t* slot )
  */
 static MacCommand_t* MallocNewMacCommandSlot( void )
 {
-    uint8_t itr = 0;
+    uint8_t index;
 
-    while( IsSlotFree( ( const MacCommand_t* )&NvmCtx.MacCommandSlots[itr] ) == false )
+    if( NvmCtx.FreeSlots == 0 )
     {
-        itr++;
-        if( itr == NUM_OF_MAC_COMMANDS )
-        {
-            return NULL;
-        }
+        return NULL;
     }
 
-    return &NvmCtx.MacCommandSlots[itr];
+    // Take the lowest free slot
+    index = __builtin_ctz( NvmCtx.FreeSlots );
+    NvmCtx.FreeSlots &= ~( 1UL << index );
+
+    return &NvmCtx.MacCommandSlots[index];
 }
 
 /*!
@@ -131,12 +201,15 @@ static MacCommand_t* MallocNewMacCommandSlot( void )
  */
 static bool FreeMacCommandSlot( MacCommand_t* slot )
 {
-    if( slot == NULL )
+    uint8_t index = GetSlotIndex( slot );
+
+    if( index == MAC_COMMAND_SLOT_NONE )
     {
         return false;
     }
 
     memset1( ( uint8_t* )slot, 0x00, sizeof( MacCommand_t ) );
+    NvmCtx.FreeSlots |= ( 1UL << index );
 
     return true;
 }
@@ -156,8 +229,8 @@ static bool LinkedListInit( MacCommandsList_t* list )
         return false;
     }
 
-    list->First = NULL;
-    list->Last = NULL;
+    list->First = MAC_COMMAND_SLOT_NONE;
+    list->Last = MAC_COMMAND_SLOT_NONE;
 
     return true;
 }
@@ -171,102 +244,155 @@ static bool LinkedListInit( MacCommandsList_t* list )
  */
 static bool LinkedListAdd( MacCommandsList_t* list, MacCommand_t* element )
 {
-    if( ( list == NULL ) || ( element == NULL ) )
+    uint8_t index = GetSlotIndex( element );
+
+    if( ( list == NULL ) || ( index == MAC_COMMAND_SLOT_NONE ) )
     {
         return false;
     }
 
-    // Check if this is the first entry to enter the list.
-    if( list->First == NULL )
-    {
-        list->First = element;
-    }
+    element->Prev = list->Last;
+    element->Next = MAC_COMMAND_SLOT_NONE;
 
     // Check if the last entry exists and update its next point.
-    if( list->Last )
+    if( list->Last != MAC_COMMAND_SLOT_NONE )
     {
-        list->Last->Next = element;
+        NvmCtx.MacCommandSlots[list->Last].Next = index;
+    }
+    else
+    {
+        // This is the first entry to enter the list.
+        list->First = index;
     }
-
-    // Update the next point of this entry.
-    element->Next = NULL;
 
     // Update the last entry of the list.
-    list->Last = element;
+    list->Last = index;
 
     return true;
 }
 
 /*!
- * \brief Return the previous element in the list.
+ * \brief Remove an element from the list
  *
- * \param[IN]     list           - List
- * \param[IN]     element        - Element where the previous element shall be searched
+ * \param[IN]     list           - List where the element shall be removed from.
+ * \param[IN]     element        - Element to remove
  * \retval                       - Status of the operation
  */
-static MacCommand_t* LinkedListGetPrevious( MacCommandsList_t* list, MacCommand_t* element )
+static bool LinkedListRemove( MacCommandsList_t* list, MacCommand_t* element )
 {
-    if( ( list == NULL ) || ( element == NULL ) )
+    uint8_t index = GetSlotIndex( element );
+
+    if( ( list == NULL ) || ( index == MAC_COMMAND_SLOT_NONE ) ||
+        ( ( NvmCtx.FreeSlots & ( 1UL << index ) ) != 0 ) )
     {
-        return NULL;
+        return false;
     }
 
-    MacCommand_t* curElement;
-
-    // Start at the head of the list
-    curElement = list->First;
+    if( element->Prev != MAC_COMMAND_SLOT_NONE )
+    {
+        NvmCtx.MacCommandSlots[element->Prev].Next = element->Next;
+    }
+    else
+    {
+        list->First = element->Next;
+    }
 
-    // When current element is the first of the list, there's no previous element so we can return NULL immediately.
-    if( element != curElement )
+    if( element->Next != MAC_COMMAND_SLOT_NONE )
     {
-        // Loop through all elements until the end is reached or the next of current is the current element.
-        while( ( curElement != NULL ) && ( curElement->Next != element ) )
-        {
-            curElement = curElement->Next;
-        }
+        NvmCtx.MacCommandSlots[element->Next].Prev = element->Prev;
     }
     else
     {
-        curElement = NULL;
+        list->Last = element->Prev;
     }
 
-    return curElement;
+    element->Next = MAC_COMMAND_SLOT_NONE;
+    element->Prev = MAC_COMMAND_SLOT_NONE;
+
+    return true;
 }
 
 /*!
- * \brief Remove an element from the list
+ * \brief Unlinks a MAC command from the list and frees its slot. The
+ *        serialized commands cache is not updated.
  *
- * \param[IN]     list           - List where the element shall be removed from.
- * \param[IN]     element        - Element to remove
+ * \param[IN]     macCmd         - MAC command to release
  * \retval                       - Status of the operation
  */
-static bool LinkedListRemove( MacCommandsList_t* list, MacCommand_t* element )
+static bool ReleaseCmd( MacCommand_t* macCmd )
 {
-    if( ( list == NULL ) || ( element == NULL ) )
+    if( LinkedListRemove( &NvmCtx.MacCommandList, macCmd ) == false )
     {
         return false;
     }
-
-    MacCommand_t* PrevElement = LinkedListGetPrevious( list, element );
-
-    if( list->First == element )
+    if( macCmd->IsSticky == true )
     {
-        list->First = element->Next;
+        NvmCtx.NbStickyCmds--;
     }
+    return FreeMacCommandSlot( macCmd );
+}
 
-    if( list->Last == element )
+/*!
+ * \brief Serializes a MAC command into the cache
+ *
+ * \param[IN]     macCmd         - MAC command to serialize
+ * \param[IN]     offset         - Position of the command in the cache
+ * \retval                       - Size of the serialized command
+ */
+static uint8_t CacheCmd( const MacCommand_t* macCmd, uint16_t offset )
+{
+    Cache.SerializedCmds[offset] = macCmd->CID;
+    memcpy1( &Cache.SerializedCmds[offset + CID_FIELD_SIZE], macCmd->Payload, macCmd->PayloadSize );
+    return CID_FIELD_SIZE + macCmd->PayloadSize;
+}
+
+/*!
+ * \brief Serializes the MAC command list into the cache, if not up to date
+ */
+static void ValidateCache( void )
+{
+    MacCommand_t* curElement = GetSlot( NvmCtx.MacCommandList.First );
+    uint16_t offset = 0;
+
+    if( Cache.IsValid == true )
     {
-        list->Last = PrevElement;
+        return;
     }
-
-    if( PrevElement != NULL )
+    while( curElement != NULL )
     {
-        PrevElement->Next = element->Next;
+        offset += CacheCmd( curElement, offset );
+        curElement = GetSlot( curElement->Next );
     }
+    Cache.IsValid = true;
+}
 
-    element->Next = NULL;
+/*!
+ * \brief Removes all MAC commands with the given sticky property in a single
+ *        pass, which also serializes the remaining commands into the cache.
+ *
+ * \param[IN]     sticky         - Sticky property of the commands to remove
+ */
+static void RemoveCmdsBySticky( bool sticky )
+{
+    MacCommand_t* curElement = GetSlot( NvmCtx.MacCommandList.First );
+    MacCommand_t* nextElement;
+    uint16_t offset = 0;
 
-    return true;
+    while( curElement != NULL )
+    {
+        nextElement = GetSlot( curElement->Next );
+        if( curElement->IsSticky == sticky )
+        {
+            ReleaseCmd( curElement );
+        }
+        else
+        {
+            offset += CacheCmd( curElement, offset );
+        }
+        curElement = nextElement;
+    }
+    NvmCtx.SerializedCmdsSize = offset;
+    Cache.IsValid = true;
 }
 
 /*
@@ -306,7 +432,10 @@ LoRaMacCommandStatus_t LoRaMacCommandsInit( LoRaMacCommandsNvmEvent commandsNvmC
     // Initialize with default
     memset1( ( uint8_t* )&NvmCtx, 0, sizeof( NvmCtx ) );
 
+    NvmCtx.Version = LORAMAC_COMMANDS_NVM_CTX_VERSION;
+    NvmCtx.FreeSlots = MAC_COMMAND_SLOTS_ALL;
     LinkedListInit( &NvmCtx.MacCommandList );
+    Cache.IsValid = true;
 
     // Assign callback
     CommandsNvmCtxChanged = commandsNvmCtxChanged;
@@ -319,7 +448,14 @@ LoRaMacCommandStatus_t LoRaMacCommandsRestoreNvmCtx( void* commandsNvmCtx )
     // Restore module context
     if( commandsNvmCtx != NULL )
     {
+        // Contexts of another layout version cannot be restored
+        if( ( ( LoRaMacCommandsCtx_t* )commandsNvmCtx )->Version != LORAMAC_COMMANDS_NVM_CTX_VERSION )
+        {
+            return LORAMAC_COMMANDS_ERROR;
+        }
         memcpy1( ( uint8_t* )&NvmCtx, ( uint8_t* )commandsNvmCtx, sizeof( NvmCtx ) );
+        // Rebuilt from the restored list when next serialized
+        Cache.IsValid = false;
         return LORAMAC_COMMANDS_SUCCESS;
     }
     else
@@ -340,6 +476,10 @@ LoRaMacCommandStatus_t LoRaMacCommandsAddCmd( uint8_t cid, uint8_t* payload, siz
     {
         return LORAMAC_COMMANDS_ERROR_NPE;
     }
+    if( payloadSize > LORAMAC_COMMADS_MAX_NUM_OF_PARAMS )
+    {
+        return LORAMAC_COMMANDS_ERROR;
+    }
     MacCommand_t* newCmd;
 
     // Allocate a memory slot
@@ -362,8 +502,18 @@ LoRaMacCommandStatus_t LoRaMacCommandsAddCmd( uint8_t cid, uint8_t* payload, siz
     memcpy1( ( uint8_t* )newCmd->Payload, payload, payloadSize );
     newCmd->IsSticky = IsSticky( cid );
 
+    // Append to the serialized commands, unless they are rebuilt anyway
+    if( Cache.IsValid == true )
+    {
+        CacheCmd( newCmd, NvmCtx.SerializedCmdsSize );
+    }
     NvmCtx.SerializedCmdsSize += ( CID_FIELD_SIZE + payloadSize );
 
+    if( newCmd->IsSticky == true )
+    {
+        NvmCtx.NbStickyCmds++;
+    }
+
     NvmCtxCallback( );
 
     return LORAMAC_COMMANDS_SUCCESS;
@@ -371,24 +521,23 @@ LoRaMacCommandStatus_t LoRaMacCommandsAddCmd( uint8_t cid, uint8_t* payload, siz
 
 LoRaMacCommandStatus_t LoRaMacCommandsRemoveCmd( MacCommand_t* macCmd )
 {
+    uint8_t size;
+
     if( macCmd == NULL )
     {
         return LORAMAC_COMMANDS_ERROR_NPE;
     }
+    size = CID_FIELD_SIZE + macCmd->PayloadSize;
 
-    // Remove the Mac command element from MacCommandList
-    if( LinkedListRemove( &NvmCtx.MacCommandList, macCmd ) == false )
+    // Remove the Mac command element from MacCommandList and free its slot
+    if( ReleaseCmd( macCmd ) == false )
     {
         return LORAMAC_COMMANDS_ERROR_CMD_NOT_FOUND;
     }
+    NvmCtx.SerializedCmdsSize -= size;
 
-    NvmCtx.SerializedCmdsSize -= ( CID_FIELD_SIZE + macCmd->PayloadSize );
-
-    // Free the MacCommand Slot
-    if( FreeMacCommandSlot( macCmd ) == false )
-    {
-        return LORAMAC_COMMANDS_ERROR;
-    }
+    // The serialized commands are rebuilt when next needed
+    Cache.IsValid = ( NvmCtx.SerializedCmdsSize == 0 );
 
     NvmCtxCallback( );
 
@@ -400,12 +549,12 @@ LoRaMacCommandStatus_t LoRaMacCommandsGetCmd( uint8_t cid, MacCommand_t** macCmd
     MacCommand_t* curElement;
 
     // Start at the head of the list
-    curElement = NvmCtx.MacCommandList.First;
+    curElement = GetSlot( NvmCtx.MacCommandList.First );
 
     // Loop through all elements until we find the element with the given CID
     while( ( curElement != NULL ) && ( curElement->CID != cid ) )
     {
-        curElement = curElement->Next;
+        curElement = GetSlot( curElement->Next );
     }
 
     // Update the pointer anyway
@@ -421,26 +570,7 @@ LoRaMacCommandStatus_t LoRaMacCommandsGetCmd( uint8_t cid, MacCommand_t** macCmd
 
 LoRaMacCommandStatus_t LoRaMacCommandsRemoveNoneStickyCmds( void )
 {
-    MacCommand_t* curElement;
-    MacCommand_t* nexElement;
-
-    // Start at the head of the list
-    curElement = NvmCtx.MacCommandList.First;
-
-    // Loop through all elements
-    while( curElement != NULL )
-    {
-        if( curElement->IsSticky == false )
-        {
-            nexElement = curElement->Next;
-            LoRaMacCommandsRemoveCmd( curElement );
-            curElement = nexElement;
-        }
-        else
-        {
-            curElement = curElement->Next;
-        }
-    }
+    RemoveCmdsBySticky( false );
 
     NvmCtxCallback( );
 
@@ -449,22 +579,7 @@ LoRaMacCommandStatus_t LoRaMacCommandsRemoveNoneStickyCmds( void )
 
 LoRaMacCommandStatus_t LoRaMacCommandsRemoveStickyAnsCmds( void )
 {
-    MacCommand_t* curElement;
-    MacCommand_t* nexElement;
-
-    // Start at the head of the list
-    curElement = NvmCtx.MacCommandList.First;
-
-    // Loop through all elements
-    while( curElement != NULL )
-    {
-        nexElement = curElement->Next;
-        if( IsSticky( curElement->CID ) == true )
-        {
-            LoRaMacCommandsRemoveCmd( curElement );
-        }
-        curElement = nexElement;
-    }
+    RemoveCmdsBySticky( true );
 
     NvmCtxCallback( );
 
@@ -483,41 +598,42 @@ LoRaMacCommandStatus_t LoRaMacCommandsGetSizeSerializedCmds( size_t* size )
 
 LoRaMacCommandStatus_t LoRaMacCommandsSerializeCmds( size_t availableSize, size_t* effectiveSize, uint8_t* buffer )
 {
-    MacCommand_t* curElement = NvmCtx.MacCommandList.First;
+    MacCommand_t* curElement = GetSlot( NvmCtx.MacCommandList.First );
     MacCommand_t* nextElement;
-    uint8_t itr = 0;
+    uint16_t itr = 0;
 
     if( ( buffer == NULL ) || ( effectiveSize == NULL ) )
     {
         return LORAMAC_COMMANDS_ERROR_NPE;
     }
 
-    // Loop through all elements which fits into the buffer
-    while( curElement != NULL )
+    if( NvmCtx.SerializedCmdsSize > availableSize )
     {
-        // If the next MAC command still fits into the buffer, add it.
-        if( ( availableSize - itr ) >= ( CID_FIELD_SIZE + curElement->PayloadSize ) )
+        // Find the commands which fit into the buffer
+        while( ( curElement != NULL ) &&
+               ( ( availableSize - itr ) >= ( size_t )( CID_FIELD_SIZE + curElement->PayloadSize ) ) )
         {
-            buffer[itr++] = curElement->CID;
-            memcpy1( &buffer[itr], curElement->Payload, curElement->PayloadSize );
-            itr += curElement->PayloadSize;
+            itr += CID_FIELD_SIZE + curElement->PayloadSize;
+            curElement = GetSlot( curElement->Next );
         }
-        else
+
+        // Remove all commands which do not fit into the buffer
+        while( curElement != NULL )
         {
-            break;
+            // Store the next element before removing the current one
+            nextElement = GetSlot( curElement->Next );
+            ReleaseCmd( curElement );
+            curElement = nextElement;
         }
-        curElement = curElement->Next;
-    }
+        // The cache keeps the commands which fit, if it was valid
+        NvmCtx.SerializedCmdsSize = itr;
 
-    // Remove all commands which do not fit into the buffer
-    while( curElement != NULL )
-    {
-        // Store the next element before removing the current one
-        nextElement = curElement->Next;
-        LoRaMacCommandsRemoveCmd( curElement );
-        curElement = nextElement;
+        NvmCtxCallback( );
     }
 
+    ValidateCache( );
+    memcpy1( buffer, Cache.SerializedCmds, NvmCtx.SerializedCmdsSize );
+
     // Fetch the effective size of the mac commands
     LoRaMacCommandsGetSizeSerializedCmds( effectiveSize );
 
@@ -530,22 +646,8 @@ LoRaMacCommandStatus_t LoRaMacCommandsStickyCmdsPending( bool* cmdsPending )
     {
         return LORAMAC_COMMANDS_ERROR_NPE;
     }
-    MacCommand_t* curElement;
-    curElement = NvmCtx.MacCommandList.First;
-
-    *cmdsPending = false;
 
-    // Loop through all elements
-    while( curElement != NULL )
-    {
-        if( curElement->IsSticky == true )
-        {
-            // Found one sticky MAC command
-            *cmdsPending = true;
-            return LORAMAC_COMMANDS_SUCCESS;
-        }
-        curElement = curElement->Next;
-    }
+    *cmdsPending = ( NvmCtx.NbStickyCmds > 0 );
 
     return LORAMAC_COMMANDS_SUCCESS;
 }
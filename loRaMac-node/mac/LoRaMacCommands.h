@@ -58,9 +58,13 @@ typedef struct sMacCommand MacCommand_t;
 struct sMacCommand
 {
     /*!
-     *  The pointer to the next MAC Command element in the list
+     * Slot index of the next MAC Command element in the list
      */
-    MacCommand_t* Next;
+    uint8_t Next;
+    /*!
+     * Slot index of the previous MAC Command element in the list
+     */
+    uint8_t Prev;
     /*!
      * MAC command identifier
      */
@@ -72,7 +76,7 @@ struct sMacCommand
     /*!
      * Size of MAC command payload
      */
-    size_t PayloadSize;
+    uint8_t PayloadSize;
     /*!
      * Indicates if it's a sticky MAC command
      */
@@ -40,6 +40,7 @@
 #include "LoRaMacParser.h"
 #include "LoRaMacSerializer.h"
 #include "LoRaMacCrypto.h"
+#include "LoRaMacTrace.h"
 
 /*
  * Frame direction definition for uplink communications
@@ -1094,6 +1095,8 @@ LoRaMacCryptoStatus_t LoRaMacCryptoSetKey( KeyIdentifier_t keyID, uint8_t* key )
 
 LoRaMacCryptoStatus_t LoRaMacCryptoPrepareJoinRequest( LoRaMacMessageJoinRequest_t* macMsg )
 {
+    LORAMAC_TRACE_SPAN( "LoRaMacCryptoPrepareJoinRequest" );
+
     if( macMsg == 0 )
     {
         return LORAMAC_CRYPTO_ERROR_NPE;
@@ -1225,6 +1228,8 @@ LoRaMacCryptoStatus_t LoRaMacCryptoPrepareReJoinType0or2( LoRaMacMessageReJoinTy
 
 LoRaMacCryptoStatus_t LoRaMacCryptoHandleJoinAccept( JoinReqIdentifier_t joinReqType, uint8_t* joinEUI, LoRaMacMessageJoinAccept_t* macMsg )
 {
+    LORAMAC_TRACE_SPAN( "LoRaMacCryptoHandleJoinAccept" );
+
     if( ( macMsg == 0 ) || ( joinEUI == 0 ) )
     {
         return LORAMAC_CRYPTO_ERROR_NPE;
@@ -1394,6 +1399,8 @@ LoRaMacCryptoStatus_t LoRaMacCryptoHandleJoinAccept( JoinReqIdentifier_t joinReq
 
 LoRaMacCryptoStatus_t LoRaMacCryptoSecureMessage( uint32_t fCntUp, uint8_t txDr, uint8_t txCh, LoRaMacMessageData_t* macMsg )
 {
+    LORAMAC_TRACE_SPAN( "LoRaMacCryptoSecureMessage" );
+
     LoRaMacCryptoStatus_t retval = LORAMAC_CRYPTO_ERROR;
     KeyIdentifier_t payloadDecryptionKeyID = APP_S_KEY;
 
@@ -1489,6 +1496,8 @@ LoRaMacCryptoStatus_t LoRaMacCryptoSecureMessage( uint32_t fCntUp, uint8_t txDr,
 
 LoRaMacCryptoStatus_t LoRaMacCryptoUnsecureMessage( AddressIdentifier_t addrID, uint32_t address, FCntIdentifier_t fCntID, uint32_t fCntDown, LoRaMacMessageData_t* macMsg )
 {
+    LORAMAC_TRACE_SPAN( "LoRaMacCryptoUnsecureMessage" );
+
     if( macMsg == 0 )
     {
         return LORAMAC_CRYPTO_ERROR_NPE;
@@ -1504,12 +1513,6 @@ LoRaMacCryptoStatus_t LoRaMacCryptoUnsecureMessage( AddressIdentifier_t addrID,
     KeyIdentifier_t micComputationKeyID = S_NWK_S_INT_KEY;
     KeyAddr_t* curItem;
 
-    // Parse the message
-    if( LoRaMacParserData( macMsg ) != LORAMAC_PARSER_SUCCESS )
-    {
-        return LORAMAC_CRYPTO_ERROR_PARSER;
-    }
-
     // Determine current security context
     retval = GetKeyAddrItem( addrID, &curItem );
     if( retval != LORAMAC_CRYPTO_SUCCESS )
@@ -284,6 +284,8 @@ LoRaMacCryptoStatus_t LoRaMacCryptoSecureMessage( uint32_t fCntUp, uint8_t txDr,
 
 /*!
  * Unsecures a message (decryption + integrity verification).
+ * The message must be parsed with LoRaMacParserData. The payload is
+ * decrypted in place.
  *
  * \param[IN]     addrID          - Address identifier
  * \param[IN]     address         - Address
@@ -234,6 +234,7 @@ typedef struct sLoRaMacMessageData
     uint8_t FPort;
     /*!
      * Frame payload may contain MAC commands or data (opt.)
+     * Points into Buffer for parsed messages.
      */
     uint8_t* FRMPayload;
     /*!
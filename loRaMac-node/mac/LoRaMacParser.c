@@ -96,16 +96,19 @@ LoRaMacParserStatus_t LoRaMacParserData( LoRaMacMessageData_t* macMsg )
         return LORAMAC_PARSER_FAIL;
     }
 
-    // Initialize anyway with zero.
+    // Initialize anyway with zero. The empty payload still references the
+    // buffer, the payload decryption rejects null pointers.
     macMsg->FPort = 0;
+    macMsg->FRMPayload = &macMsg->Buffer[bufItr];
     macMsg->FRMPayloadSize = 0;
 
     if( ( macMsg->BufSize - bufItr - LORAMAC_MIC_FIELD_SIZE ) > 0 )
     {
         macMsg->FPort = macMsg->Buffer[bufItr++];
 
+        // The frame payload is not copied, it is referenced in the buffer
         macMsg->FRMPayloadSize = ( macMsg->BufSize - bufItr - LORAMAC_MIC_FIELD_SIZE );
-        memcpy1( macMsg->FRMPayload, &macMsg->Buffer[bufItr], macMsg->FRMPayloadSize );
+        macMsg->FRMPayload = &macMsg->Buffer[bufItr];
         bufItr = bufItr + macMsg->FRMPayloadSize;
     }
 
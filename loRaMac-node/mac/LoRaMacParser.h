@@ -79,6 +79,8 @@ LoRaMacParserStatus_t LoRaMacParserJoinAccept( LoRaMacMessageJoinAccept_t *macMs
 
 /*!
  * Parse a serialized data message and fills the structured object.
+ * The message is parsed in a single pass. The FRMPayload is not copied,
+ * it points into the serialized message buffer.
  *
  * \param[IN/OUT] macMsg       - Data message object
  * \retval                     - Status of the operation
@@ -0,0 +1,211 @@
+/*!
+ * \file      LoRaMacSnapshot.c
+ *
+ * \brief     LoRa MAC device snapshot
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "utilities.h"
+#include "rtc.h"
+#include "radio.h"
+#include "LoRaMac.h"
+#include "LoRaMacSnapshot.h"
+
+/*!
+ * Sections start on 8 bytes boundaries
+ */
+#define SNAPSHOT_ALIGN( size )                      ( ( ( size ) + 7 ) & ~( ( size_t )7 ) )
+
+/*!
+ * Virtual RTC state
+ */
+typedef struct sSnapshotClock
+{
+    uint32_t TimerValue;
+    uint32_t TimerContext;
+}SnapshotClock_t;
+
+/*!
+ * \brief Collects the location and size of every section of the device state
+ *
+ * \param [OUT] data  Section data
+ * \param [OUT] sizes Section sizes
+ */
+static void GetSections( void* data[LORAMAC_SNAPSHOT_NB_SECTIONS], size_t sizes[LORAMAC_SNAPSHOT_NB_SECTIONS] )
+{
+    MibRequestConfirm_t mibReq;
+
+    mibReq.Type = MIB_NVM_CTXS;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+
+    data[LORAMAC_SNAPSHOT_SECTION_MAC] = mibReq.Param.Contexts->MacNvmCtx;
+    sizes[LORAMAC_SNAPSHOT_SECTION_MAC] = mibReq.Param.Contexts->MacNvmCtxSize;
+    data[LORAMAC_SNAPSHOT_SECTION_REGION] = mibReq.Param.Contexts->RegionNvmCtx;
+    sizes[LORAMAC_SNAPSHOT_SECTION_REGION] = mibReq.Param.Contexts->RegionNvmCtxSize;
+    data[LORAMAC_SNAPSHOT_SECTION_CRYPTO] = mibReq.Param.Contexts->CryptoNvmCtx;
+    sizes[LORAMAC_SNAPSHOT_SECTION_CRYPTO] = mibReq.Param.Contexts->CryptoNvmCtxSize;
+    data[LORAMAC_SNAPSHOT_SECTION_SECURE_ELEMENT] = mibReq.Param.Contexts->SecureElementNvmCtx;
+    sizes[LORAMAC_SNAPSHOT_SECTION_SECURE_ELEMENT] = mibReq.Param.Contexts->SecureElementNvmCtxSize;
+    data[LORAMAC_SNAPSHOT_SECTION_COMMANDS] = mibReq.Param.Contexts->CommandsNvmCtx;
+    sizes[LORAMAC_SNAPSHOT_SECTION_COMMANDS] = mibReq.Param.Contexts->CommandsNvmCtxSize;
+    data[LORAMAC_SNAPSHOT_SECTION_CLASS_B] = mibReq.Param.Contexts->ClassBNvmCtx;
+    sizes[LORAMAC_SNAPSHOT_SECTION_CLASS_B] = mibReq.Param.Contexts->ClassBNvmCtxSize;
+    data[LORAMAC_SNAPSHOT_SECTION_CONFIRM_QUEUE] = mibReq.Param.Contexts->ConfirmQueueNvmCtx;
+    sizes[LORAMAC_SNAPSHOT_SECTION_CONFIRM_QUEUE] = mibReq.Param.Contexts->ConfirmQueueNvmCtxSize;
+
+    // Filled by the caller
+    data[LORAMAC_SNAPSHOT_SECTION_CLOCK] = NULL;
+    sizes[LORAMAC_SNAPSHOT_SECTION_CLOCK] = sizeof( SnapshotClock_t );
+    data[LORAMAC_SNAPSHOT_SECTION_RADIO] = NULL;
+    sizes[LORAMAC_SNAPSHOT_SECTION_RADIO] = sizeof( RadioSnapshot_t );
+}
+
+size_t LoRaMacSnapshotGetSize( void )
+{
+    void* data[LORAMAC_SNAPSHOT_NB_SECTIONS];
+    size_t sizes[LORAMAC_SNAPSHOT_NB_SECTIONS];
+    size_t size = SNAPSHOT_ALIGN( sizeof( LoRaMacSnapshotHeader_t ) );
+
+    GetSections( data, sizes );
+    for( uint8_t i = 0; i < LORAMAC_SNAPSHOT_NB_SECTIONS; i++ )
+    {
+        size += SNAPSHOT_ALIGN( sizes[i] );
+    }
+    return size;
+}
+
+LoRaMacSnapshotStatus_t LoRaMacSnapshotSave( uint8_t* image, size_t size )
+{
+    void* data[LORAMAC_SNAPSHOT_NB_SECTIONS];
+    size_t sizes[LORAMAC_SNAPSHOT_NB_SECTIONS];
+    LoRaMacSnapshotHeader_t header;
+    SnapshotClock_t clock;
+    RadioSnapshot_t radio;
+    size_t offset = SNAPSHOT_ALIGN( sizeof( LoRaMacSnapshotHeader_t ) );
+
+    if( image == NULL )
+    {
+        return LORAMAC_SNAPSHOT_ERROR_NPE;
+    }
+    if( size < LoRaMacSnapshotGetSize( ) )
+    {
+        return LORAMAC_SNAPSHOT_ERROR_BUF_SIZE;
+    }
+
+    GetSections( data, sizes );
+    clock.TimerValue = RtcGetTimerValue( );
+    clock.TimerContext = RtcGetTimerContext( );
+    data[LORAMAC_SNAPSHOT_SECTION_CLOCK] = &clock;
+    RadioGetSnapshot( &radio );
+    data[LORAMAC_SNAPSHOT_SECTION_RADIO] = &radio;
+
+    memset1( ( uint8_t* )&header, 0, sizeof( header ) );
+    header.Magic = LORAMAC_SNAPSHOT_MAGIC;
+    header.Version = LORAMAC_SNAPSHOT_VERSION;
+    header.NbSections = LORAMAC_SNAPSHOT_NB_SECTIONS;
+
+    for( uint8_t i = 0; i < LORAMAC_SNAPSHOT_NB_SECTIONS; i++ )
+    {
+        header.Sections[i].Offset = offset;
+        header.Sections[i].Size = sizes[i];
+        // Padding is zeroed so that images of identical states are identical
+        memset1( image + offset, 0, SNAPSHOT_ALIGN( sizes[i] ) );
+        memcpy1( image + offset, ( uint8_t* )data[i], sizes[i] );
+        offset += SNAPSHOT_ALIGN( sizes[i] );
+    }
+    header.Size = offset;
+    memcpy1( image, ( uint8_t* )&header, sizeof( header ) );
+
+    return LORAMAC_SNAPSHOT_SUCCESS;
+}
+
+LoRaMacSnapshotStatus_t LoRaMacSnapshotRestore( const uint8_t* image, size_t size )
+{
+    void* data[LORAMAC_SNAPSHOT_NB_SECTIONS];
+    size_t sizes[LORAMAC_SNAPSHOT_NB_SECTIONS];
+    LoRaMacSnapshotHeader_t header;
+    LoRaMacCtxs_t contexts;
+    MibRequestConfirm_t mibReq;
+    SnapshotClock_t clock;
+    RadioSnapshot_t radio;
+
+    if( image == NULL )
+    {
+        return LORAMAC_SNAPSHOT_ERROR_NPE;
+    }
+    if( size < sizeof( header ) )
+    {
+        return LORAMAC_SNAPSHOT_ERROR_BUF_SIZE;
+    }
+
+    memcpy1( ( uint8_t* )&header, image, sizeof( header ) );
+    if( ( header.Magic != LORAMAC_SNAPSHOT_MAGIC ) ||
+        ( header.Version != LORAMAC_SNAPSHOT_VERSION ) ||
+        ( header.NbSections != LORAMAC_SNAPSHOT_NB_SECTIONS ) )
+    {
+        return LORAMAC_SNAPSHOT_ERROR_FORMAT;
+    }
+    if( header.Size > size )
+    {
+        return LORAMAC_SNAPSHOT_ERROR_BUF_SIZE;
+    }
+
+    GetSections( data, sizes );
+    for( uint8_t i = 0; i < LORAMAC_SNAPSHOT_NB_SECTIONS; i++ )
+    {
+        if( header.Sections[i].Size != sizes[i] )
+        {
+            return LORAMAC_SNAPSHOT_ERROR_LAYOUT;
+        }
+        if( ( header.Sections[i].Offset + header.Sections[i].Size ) > header.Size )
+        {
+            return LORAMAC_SNAPSHOT_ERROR_FORMAT;
+        }
+        // The modules copy their context out of the image, it is never written
+        data[i] = ( void* )( image + header.Sections[i].Offset );
+    }
+
+    contexts.MacNvmCtx = data[LORAMAC_SNAPSHOT_SECTION_MAC];
+    contexts.MacNvmCtxSize = sizes[LORAMAC_SNAPSHOT_SECTION_MAC];
+    contexts.RegionNvmCtx = data[LORAMAC_SNAPSHOT_SECTION_REGION];
+    contexts.RegionNvmCtxSize = sizes[LORAMAC_SNAPSHOT_SECTION_REGION];
+    contexts.CryptoNvmCtx = data[LORAMAC_SNAPSHOT_SECTION_CRYPTO];
+    contexts.CryptoNvmCtxSize = sizes[LORAMAC_SNAPSHOT_SECTION_CRYPTO];
+    contexts.SecureElementNvmCtx = data[LORAMAC_SNAPSHOT_SECTION_SECURE_ELEMENT];
+    contexts.SecureElementNvmCtxSize = sizes[LORAMAC_SNAPSHOT_SECTION_SECURE_ELEMENT];
+    contexts.CommandsNvmCtx = data[LORAMAC_SNAPSHOT_SECTION_COMMANDS];
+    contexts.CommandsNvmCtxSize = sizes[LORAMAC_SNAPSHOT_SECTION_COMMANDS];
+    contexts.ClassBNvmCtx = data[LORAMAC_SNAPSHOT_SECTION_CLASS_B];
+    contexts.ClassBNvmCtxSize = sizes[LORAMAC_SNAPSHOT_SECTION_CLASS_B];
+    contexts.ConfirmQueueNvmCtx = data[LORAMAC_SNAPSHOT_SECTION_CONFIRM_QUEUE];
+    contexts.ConfirmQueueNvmCtxSize = sizes[LORAMAC_SNAPSHOT_SECTION_CONFIRM_QUEUE];
+
+    mibReq.Type = MIB_NVM_CTXS;
+    mibReq.Param.Contexts = &contexts;
+    switch( LoRaMacMibSetRequestConfirm( &mibReq ) )
+    {
+        case LORAMAC_STATUS_OK:
+        {
+            break;
+        }
+        case LORAMAC_STATUS_BUSY:
+        {
+            return LORAMAC_SNAPSHOT_ERROR_BUSY;
+        }
+        default:
+        {
+            return LORAMAC_SNAPSHOT_ERROR_RESTORE;
+        }
+    }
+
+    memcpy1( ( uint8_t* )&clock, ( uint8_t* )data[LORAMAC_SNAPSHOT_SECTION_CLOCK], sizeof( clock ) );
+    RtcSetVirtualTime( clock.TimerValue, clock.TimerContext );
+    memcpy1( ( uint8_t* )&radio, ( uint8_t* )data[LORAMAC_SNAPSHOT_SECTION_RADIO], sizeof( radio ) );
+    RadioRestoreSnapshot( &radio );
+
+    return LORAMAC_SNAPSHOT_SUCCESS;
+}
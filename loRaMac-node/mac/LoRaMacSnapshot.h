@@ -0,0 +1,156 @@
+/*!
+ * \file      LoRaMacSnapshot.h
+ *
+ * \brief     LoRa MAC device snapshot
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \defgroup  LORAMACSNAPSHOT LoRa MAC device snapshot
+ *            Captures the whole state of a hosted device in one contiguous
+ *            image: the non-volatile contexts of all the MAC modules (see
+ *            \ref MIB_NVM_CTXS), the virtual RTC and the simulated radio.
+ *
+ *            Restoring only copies out of the image, so an image mapped copy
+ *            on write can back any number of forked scenarios without being
+ *            duplicated.
+ *
+ *            An image is bound to the build that wrote it. Each section
+ *            records its size, restoring fails when a context layout
+ *            changed.
+ * \{
+ */
+#ifndef __LORAMAC_SNAPSHOT_H__
+#define __LORAMAC_SNAPSHOT_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*!
+ * Snapshot image identifier, "LMSS"
+ */
+#define LORAMAC_SNAPSHOT_MAGIC                      0x53534D4C
+
+/*!
+ * Snapshot image format version
+ */
+#define LORAMAC_SNAPSHOT_VERSION                    1
+
+/*!
+ * Snapshot image sections
+ */
+typedef enum eLoRaMacSnapshotSection
+{
+    LORAMAC_SNAPSHOT_SECTION_MAC,
+    LORAMAC_SNAPSHOT_SECTION_REGION,
+    LORAMAC_SNAPSHOT_SECTION_CRYPTO,
+    LORAMAC_SNAPSHOT_SECTION_SECURE_ELEMENT,
+    LORAMAC_SNAPSHOT_SECTION_COMMANDS,
+    LORAMAC_SNAPSHOT_SECTION_CLASS_B,
+    LORAMAC_SNAPSHOT_SECTION_CONFIRM_QUEUE,
+    /*!
+     * Virtual RTC counter and timer reference
+     */
+    LORAMAC_SNAPSHOT_SECTION_CLOCK,
+    /*!
+     * Simulated radio, see RadioSnapshot_t
+     */
+    LORAMAC_SNAPSHOT_SECTION_RADIO,
+    LORAMAC_SNAPSHOT_NB_SECTIONS,
+}LoRaMacSnapshotSection_t;
+
+/*!
+ * Snapshot image header
+ */
+typedef struct sLoRaMacSnapshotHeader
+{
+    uint32_t Magic;
+    uint16_t Version;
+    uint16_t NbSections;
+    /*!
+     * Size of the whole image, header included
+     */
+    uint32_t Size;
+    /*!
+     * Offset and size of each section in the image
+     */
+    struct
+    {
+        uint32_t Offset;
+        uint32_t Size;
+    }Sections[LORAMAC_SNAPSHOT_NB_SECTIONS];
+}LoRaMacSnapshotHeader_t;
+
+/*!
+ * LoRaMac snapshot status
+ */
+typedef enum eLoRaMacSnapshotStatus
+{
+    /*!
+     * No error occurred
+     */
+    LORAMAC_SNAPSHOT_SUCCESS = 0,
+    /*!
+     * Null pointer exception
+     */
+    LORAMAC_SNAPSHOT_ERROR_NPE,
+    /*!
+     * The image buffer is too small
+     */
+    LORAMAC_SNAPSHOT_ERROR_BUF_SIZE,
+    /*!
+     * The image is not a snapshot of this format version
+     */
+    LORAMAC_SNAPSHOT_ERROR_FORMAT,
+    /*!
+     * A context of the image does not have the size of this build
+     */
+    LORAMAC_SNAPSHOT_ERROR_LAYOUT,
+    /*!
+     * The MAC is running, see LoRaMacStop
+     */
+    LORAMAC_SNAPSHOT_ERROR_BUSY,
+    /*!
+     * A module rejected its context
+     */
+    LORAMAC_SNAPSHOT_ERROR_RESTORE,
+}LoRaMacSnapshotStatus_t;
+
+/*!
+ * \brief   Computes the size of a snapshot image of the device
+ *
+ * \retval  Image size in bytes
+ */
+size_t LoRaMacSnapshotGetSize( void );
+
+/*!
+ * \brief   Captures the device state
+ *
+ * \param   [OUT] image Image buffer, at least LoRaMacSnapshotGetSize( ) bytes
+ * \param   [IN]  size  Image buffer size
+ *
+ * \retval  Status of the operation
+ */
+LoRaMacSnapshotStatus_t LoRaMacSnapshotSave( uint8_t* image, size_t size );
+
+/*!
+ * \brief   Restores the device state from an image. The MAC has to be stopped.
+ *
+ * \param   [IN] image Snapshot image, only read
+ * \param   [IN] size  Image size
+ *
+ * \retval  Status of the operation
+ */
+LoRaMacSnapshotStatus_t LoRaMacSnapshotRestore( const uint8_t* image, size_t size );
+
+/*! \} defgroup LORAMACSNAPSHOT */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LORAMAC_SNAPSHOT_H__
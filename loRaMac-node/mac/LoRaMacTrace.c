@@ -0,0 +1,207 @@
+/*!
+ * \file      LoRaMacTrace.c
+ *
+ * \brief     LoRa MAC hot path tracing
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "LoRaMacTrace.h"
+
+#if defined( LORAMAC_TRACE )
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "timer.h"
+
+/*!
+ * Spans buffered per thread before being written out
+ */
+#define LORAMAC_TRACE_BUFFER_SIZE                   4096
+
+/*!
+ * Recorded span
+ */
+typedef struct sLoRaMacTraceEvent
+{
+    const char* Name;
+    uint64_t Start;
+    uint64_t Duration;
+    TimerTime_t VirtualTime;
+}LoRaMacTraceEvent_t;
+
+/*!
+ * Span buffer of a thread. Kept in a list until the trace stops, as the
+ * thread may end first.
+ */
+typedef struct sLoRaMacTraceBuffer
+{
+    struct sLoRaMacTraceBuffer* Next;
+    uint32_t ThreadId;
+    uint32_t Count;
+    LoRaMacTraceEvent_t Events[LORAMAC_TRACE_BUFFER_SIZE];
+}LoRaMacTraceBuffer_t;
+
+/*!
+ * Trace file, NULL while not tracing
+ */
+static FILE* volatile TraceFile = NULL;
+
+/*!
+ * Guards the file, the buffer list and the thread ids
+ */
+static pthread_mutex_t TraceMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static LoRaMacTraceBuffer_t* TraceBuffers = NULL;
+static uint32_t TraceThreads = 0;
+static bool TraceFirstEvent = true;
+static int TracePid = 0;
+
+static __thread LoRaMacTraceBuffer_t* ThreadBuffer = NULL;
+
+/*!
+ * \brief   Writes the events of a buffer and empties it. TraceMutex is held.
+ */
+static void WriteBuffer( LoRaMacTraceBuffer_t* buffer )
+{
+    for( uint32_t i = 0; ( i < buffer->Count ) && ( TraceFile != NULL ); i++ )
+    {
+        const LoRaMacTraceEvent_t* event = &buffer->Events[i];
+
+        fprintf( TraceFile, "%s\n{\"name\":\"%s\",\"cat\":\"mac\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,"
+                 "\"pid\":%d,\"tid\":%u,\"args\":{\"time\":%u}}",
+                 TraceFirstEvent ? "" : ",", event->Name,
+                 ( unsigned long long )( event->Start / 1000 ), ( unsigned )( event->Start % 1000 ),
+                 ( unsigned long long )( event->Duration / 1000 ), ( unsigned )( event->Duration % 1000 ),
+                 TracePid, buffer->ThreadId, event->VirtualTime );
+        TraceFirstEvent = false;
+    }
+    buffer->Count = 0;
+}
+
+uint64_t LoRaMacTraceNow( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( uint64_t )now.tv_sec * 1000000000ull + ( uint64_t )now.tv_nsec;
+}
+
+uint32_t LoRaMacTraceVirtualNow( void )
+{
+    return TimerGetCurrentTime( );
+}
+
+void LoRaMacTraceEnd( LoRaMacTraceSpan_t* span )
+{
+    LoRaMacTraceBuffer_t* buffer = ThreadBuffer;
+    uint64_t end = LoRaMacTraceNow( );
+
+    if( TraceFile == NULL )
+    {
+        return;
+    }
+
+    if( buffer == NULL )
+    {
+        buffer = calloc( 1, sizeof( LoRaMacTraceBuffer_t ) );
+        if( buffer == NULL )
+        {
+            return;
+        }
+        pthread_mutex_lock( &TraceMutex );
+        buffer->ThreadId = ++TraceThreads;
+        buffer->Next = TraceBuffers;
+        TraceBuffers = buffer;
+        pthread_mutex_unlock( &TraceMutex );
+        ThreadBuffer = buffer;
+    }
+
+    if( buffer->Count == LORAMAC_TRACE_BUFFER_SIZE )
+    {
+        pthread_mutex_lock( &TraceMutex );
+        WriteBuffer( buffer );
+        pthread_mutex_unlock( &TraceMutex );
+    }
+
+    LoRaMacTraceEvent_t* event = &buffer->Events[buffer->Count++];
+    event->Name = span->Name;
+    event->Start = span->Start;
+    event->Duration = end - span->Start;
+    event->VirtualTime = span->VirtualStart;
+}
+
+bool LoRaMacTraceStart( const char* path )
+{
+    LoRaMacTraceStop( );
+
+    FILE* file = fopen( path, "w" );
+    if( file == NULL )
+    {
+        return false;
+    }
+
+    pthread_mutex_lock( &TraceMutex );
+    TracePid = getpid( );
+    TraceFirstEvent = true;
+    fputs( "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file );
+    TraceFile = file;
+    pthread_mutex_unlock( &TraceMutex );
+    return true;
+}
+
+void LoRaMacTraceFlush( void )
+{
+    // Another thread may be recording into its buffer, only ours is safe
+    pthread_mutex_lock( &TraceMutex );
+    if( ThreadBuffer != NULL )
+    {
+        WriteBuffer( ThreadBuffer );
+    }
+    if( TraceFile != NULL )
+    {
+        fflush( TraceFile );
+    }
+    pthread_mutex_unlock( &TraceMutex );
+}
+
+void LoRaMacTraceStop( void )
+{
+    pthread_mutex_lock( &TraceMutex );
+    // The recording threads are done, their buffers can be written out
+    for( LoRaMacTraceBuffer_t* buffer = TraceBuffers; buffer != NULL; buffer = buffer->Next )
+    {
+        WriteBuffer( buffer );
+    }
+    if( TraceFile != NULL )
+    {
+        fputs( "\n]}\n", TraceFile );
+        fclose( TraceFile );
+        TraceFile = NULL;
+    }
+    pthread_mutex_unlock( &TraceMutex );
+}
+
+#else
+
+bool LoRaMacTraceStart( const char* path )
+{
+    return false;
+}
+
+void LoRaMacTraceFlush( void )
+{
+}
+
+void LoRaMacTraceStop( void )
+{
+}
+
+#endif // LORAMAC_TRACE
@@ -0,0 +1,131 @@
+/*!
+ * \file      LoRaMacTrace.h
+ *
+ * \brief     LoRa MAC hot path tracing
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \defgroup  LORAMACTRACE LoRa MAC hot path tracing
+ *            Timed spans around the steps of the MAC state machine: the
+ *            scheduling, securing and sending of uplinks, the handling of
+ *            received frames and MAC commands, the channel selection and the
+ *            crypto calls.
+ *
+ *            Tracing is compiled in with -DLORAMAC_TRACE only, e.g.
+ *                bazel build --copt=-DLORAMAC_TRACE //main:replay
+ *            Otherwise the span macros expand to nothing.
+ *
+ *            Each thread records its spans in its own buffer, without
+ *            locking. Full buffers are written out as Chrome trace events,
+ *            which chrome://tracing and ui.perfetto.dev open. Each span also
+ *            carries the virtual time it started at.
+ * \{
+ */
+#ifndef __LORAMAC_TRACE_H__
+#define __LORAMAC_TRACE_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined( LORAMAC_TRACE )
+
+/*!
+ * Span being timed
+ */
+typedef struct sLoRaMacTraceSpan
+{
+    /*!
+     * Span name, a string literal
+     */
+    const char* Name;
+    /*!
+     * Start time [ns]
+     */
+    uint64_t Start;
+    /*!
+     * Virtual time at the start [ms]
+     */
+    uint32_t VirtualStart;
+}LoRaMacTraceSpan_t;
+
+/*!
+ * \brief   Gets the monotonic time spans are timed with
+ *
+ * \retval  Time [ns]
+ */
+uint64_t LoRaMacTraceNow( void );
+
+/*!
+ * \brief   Gets the virtual time of the simulated device
+ *
+ * \retval  Time [ms]
+ */
+uint32_t LoRaMacTraceVirtualNow( void );
+
+/*!
+ * \brief   Ends a span and records it in the buffer of the calling thread
+ *
+ * \param   [IN] span Span started with LORAMAC_TRACE_BEGIN or
+ *                    LORAMAC_TRACE_SPAN
+ */
+void LoRaMacTraceEnd( LoRaMacTraceSpan_t* span );
+
+#define LORAMAC_TRACE_CONCAT( a, b )                a##b
+#define LORAMAC_TRACE_NAME( line )                  LORAMAC_TRACE_CONCAT( LoRaMacTraceSpan, line )
+
+/*!
+ * Times the rest of the enclosing block, every return included
+ */
+#define LORAMAC_TRACE_SPAN( name )                  \
+    LoRaMacTraceSpan_t LORAMAC_TRACE_NAME( __LINE__ ) __attribute__( ( cleanup( LoRaMacTraceEnd ) ) ) = \
+        { ( name ), LoRaMacTraceNow( ), LoRaMacTraceVirtualNow( ) }
+
+/*!
+ * Times the statements between LORAMAC_TRACE_BEGIN and LORAMAC_TRACE_END
+ */
+#define LORAMAC_TRACE_BEGIN( span, name )           LoRaMacTraceSpan_t span = { ( name ), LoRaMacTraceNow( ), LoRaMacTraceVirtualNow( ) }
+#define LORAMAC_TRACE_END( span )                   LoRaMacTraceEnd( &( span ) )
+
+#else
+
+#define LORAMAC_TRACE_SPAN( name )
+#define LORAMAC_TRACE_BEGIN( span, name )
+#define LORAMAC_TRACE_END( span )
+
+#endif // LORAMAC_TRACE
+
+/*!
+ * \brief   Starts writing the spans recorded from now on to a Chrome trace
+ *          event file
+ *
+ * \param   [IN] path Trace file
+ *
+ * \retval  false when the file can not be created, or when tracing is
+ *          compiled out
+ */
+bool LoRaMacTraceStart( const char* path );
+
+/*!
+ * \brief   Writes out the spans buffered by the calling thread. The buffers
+ *          of the other threads are theirs until LoRaMacTraceStop.
+ */
+void LoRaMacTraceFlush( void );
+
+/*!
+ * \brief   Writes out the buffered spans and closes the trace file. The
+ *          threads recording spans must be done.
+ */
+void LoRaMacTraceStop( void );
+
+/*! \} defgroup LORAMACTRACE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LORAMAC_TRACE_H__
@@ -46,6 +46,8 @@
  *              - #define REGION_IN865
  *              - #define REGION_US915
  *              - #define REGION_RU864
+ *            - Every region defined is dispatched through its function table. The
+ *              region of a device is selected at run time by LoRaMacInitialization.
  *
  * \{
  */
@@ -1362,8 +1364,72 @@ typedef struct sRxBeaconSetupParams
     uint32_t Frequency;
 }RxBeaconSetup_t;
 
+/*!
+ * Number of datarates covered by the PHY parameter cache
+ */
+#define REGION_PHY_CACHE_NB_DATARATES               16
+
+/*!
+ * Per device cache of the PHY parameters queried by the MAC layer on every
+ * uplink and downlink. The values only depend on the region, the dwell time
+ * settings and the datarate. The per datarate entries are filled on first use.
+ */
+typedef struct sRegionPhyCache
+{
+    /*!
+     * Set to true when the cache matches the current MAC parameters.
+     */
+    bool Valid;
+    /*!
+     * Region the cache was built for.
+     */
+    LoRaMacRegion_t Region;
+    /*!
+     * Uplink dwell time the cache was built for.
+     */
+    uint8_t UplinkDwellTime;
+    /*!
+     * Downlink dwell time the cache was built for.
+     */
+    uint8_t DownlinkDwellTime;
+    /*!
+     * PHY_MIN_TX_DR
+     */
+    int8_t MinTxDr;
+    /*!
+     * PHY_DEF_TX_POWER
+     */
+    int8_t DefTxPower;
+    /*!
+     * Bit mask of the valid UplinkMaxPayload entries.
+     */
+    uint16_t UplinkMaxPayloadMask;
+    /*!
+     * Bit mask of the valid DownlinkMaxPayload entries.
+     */
+    uint16_t DownlinkMaxPayloadMask;
+    /*!
+     * Bit mask of the valid NextLowerTxDr entries.
+     */
+    uint16_t NextLowerTxDrMask;
+    /*!
+     * PHY_MAX_PAYLOAD per datarate with the uplink dwell time.
+     */
+    uint8_t UplinkMaxPayload[REGION_PHY_CACHE_NB_DATARATES];
+    /*!
+     * PHY_MAX_PAYLOAD per datarate with the downlink dwell time.
+     */
+    uint8_t DownlinkMaxPayload[REGION_PHY_CACHE_NB_DATARATES];
+    /*!
+     * PHY_NEXT_LOWER_TX_DR per datarate.
+     */
+    int8_t NextLowerTxDr[REGION_PHY_CACHE_NB_DATARATES];
+}RegionPhyCache_t;
+
 
 
+#ifndef REGION_SPECIALIZED
+
 /*!
  * \brief The function verifies if a region is active or not. If a region
  *        is not active, it cannot be used.
@@ -1669,6 +1735,58 @@ uint8_t RegionApplyDrOffset( LoRaMacRegion_t region, uint8_t downlinkDwellTime,
  */
 void RegionRxBeaconSetup( LoRaMacRegion_t region, RxBeaconSetup_t* rxBeaconSetup, uint8_t* outDr );
 
+#else
+
+#include "RegionSpecialized.h"
+
+#endif // REGION_SPECIALIZED
+
+/*!
+ * \brief Initializes the PHY parameter cache for the given region and dwell
+ *        time settings.
+ *
+ * \param [OUT] cache Pointer to the cache.
+ *
+ * \param [IN] region LoRaWAN region.
+ *
+ * \param [IN] uplinkDwellTime Uplink dwell time.
+ *
+ * \param [IN] downlinkDwellTime Downlink dwell time.
+ */
+void RegionPhyCacheInit( RegionPhyCache_t* cache, LoRaMacRegion_t region, uint8_t uplinkDwellTime, uint8_t downlinkDwellTime );
+
+/*!
+ * \brief Invalidates the PHY parameter cache. Must be called when the region
+ *        or the dwell time settings change.
+ *
+ * \param [IN] cache Pointer to the cache.
+ */
+void RegionPhyCacheInvalidate( RegionPhyCache_t* cache );
+
+/*!
+ * \brief Gets the PHY_MAX_PAYLOAD value through the cache.
+ *
+ * \param [IN] cache Pointer to a valid cache.
+ *
+ * \param [IN] datarate Datarate.
+ *
+ * \param [IN] downlink Set to true to use the downlink dwell time.
+ *
+ * \retval Maximum payload size.
+ */
+uint8_t RegionPhyCacheGetMaxPayload( RegionPhyCache_t* cache, int8_t datarate, bool downlink );
+
+/*!
+ * \brief Gets the PHY_NEXT_LOWER_TX_DR value through the cache.
+ *
+ * \param [IN] cache Pointer to a valid cache.
+ *
+ * \param [IN] datarate Current datarate.
+ *
+ * \retval Next lower datarate.
+ */
+int8_t RegionPhyCacheGetNextLowerTxDr( RegionPhyCache_t* cache, int8_t datarate );
+
 /*!
  * \brief Gets the version of the regional parameters implementation.
  *
@@ -125,6 +125,11 @@ typedef struct sRegionAS923NvmCtx
  */
 static RegionAS923NvmCtx_t NvmCtx;
 
+/*
+ * Per-datarate and per-band bitmasks of the channels.
+ */
+static RegionCommonChannelsIndex_t ChannelsIndex;
+
 // Static functions
 static bool VerifyRfFreq( uint32_t freq )
 {
@@ -386,6 +391,9 @@ void RegionAS923InitDefaults( InitDefaultsParams_t* params )
         AS923_BAND0
     };
 
+    // Channel definitions may change
+    RegionCommonChannelsIndexInvalidate( &ChannelsIndex );
+
     switch( params->Type )
     {
         case INIT_TYPE_DEFAULTS:
@@ -916,6 +924,7 @@ LoRaMacStatus_t RegionAS923NextChannel( NextChanParams_t* nextChanParams, uint8_
     countChannelsParams.Bands = NvmCtx.Bands;
     countChannelsParams.MaxNbChannels = AS923_MAX_NB_CHANNELS;
     countChannelsParams.JoinChannels = &joinChannels;
+    countChannelsParams.ChannelsIndex = &ChannelsIndex;
 
     identifyChannelsParam.AggrTimeOff = nextChanParams->AggrTimeOff;
     identifyChannelsParam.LastAggrTx = nextChanParams->LastAggrTx;
@@ -1020,6 +1029,7 @@ LoRaMacStatus_t RegionAS923ChannelAdd( ChannelAddParams_t* channelAdd )
         return LORAMAC_STATUS_FREQUENCY_INVALID;
     }
 
+    RegionCommonChannelsIndexInvalidate( &ChannelsIndex );
     memcpy1( ( uint8_t* ) &(NvmCtx.Channels[id]), ( uint8_t* ) channelAdd->NewChannel, sizeof( NvmCtx.Channels[id] ) );
     NvmCtx.Channels[id].Band = 0;
     NvmCtx.ChannelsMask[0] |= ( 1 << id );
@@ -1037,6 +1047,7 @@ bool RegionAS923ChannelsRemove( ChannelRemoveParams_t* channelRemove  )
 
     // Remove the channel from the list of channels
     NvmCtx.Channels[id] = ( ChannelParams_t ){ 0, 0, { 0 }, 0 };
+    RegionCommonChannelsIndexInvalidate( &ChannelsIndex );
 
     return RegionCommonChanDisable( NvmCtx.ChannelsMask, id, AS923_MAX_NB_CHANNELS );
 }
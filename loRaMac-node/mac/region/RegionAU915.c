@@ -80,6 +80,11 @@ typedef struct sRegionAU915NvmCtx
  */
 static RegionAU915NvmCtx_t NvmCtx;
 
+/*
+ * Per-datarate and per-band bitmasks of the channels.
+ */
+static RegionCommonChannelsIndex_t ChannelsIndex;
+
 // Static functions
 static int8_t GetNextLowerTxDr( int8_t dr, int8_t minDr )
 {
@@ -368,6 +373,9 @@ void RegionAU915InitDefaults( InitDefaultsParams_t* params )
         AU915_BAND0
     };
 
+    // Channel definitions may change
+    RegionCommonChannelsIndexInvalidate( &ChannelsIndex );
+
     switch( params->Type )
     {
         case INIT_TYPE_DEFAULTS:
@@ -884,6 +892,7 @@ LoRaMacStatus_t RegionAU915NextChannel( NextChanParams_t* nextChanParams, uint8_
     countChannelsParams.Bands = NvmCtx.Bands;
     countChannelsParams.MaxNbChannels = AU915_MAX_NB_CHANNELS;
     countChannelsParams.JoinChannels = NULL;
+    countChannelsParams.ChannelsIndex = &ChannelsIndex;
 
     identifyChannelsParam.AggrTimeOff = nextChanParams->AggrTimeOff;
     identifyChannelsParam.LastAggrTx = nextChanParams->LastAggrTx;
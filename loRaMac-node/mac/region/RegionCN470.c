@@ -204,6 +204,16 @@ typedef struct sRegionCN470NvmCtx
  */
 static RegionCN470NvmCtx_t NvmCtx;
 
+/*
+ * Per-datarate and per-band bitmasks of the channels.
+ */
+static RegionCommonChannelsIndex_t ChannelsIndex;
+
+/*
+ * Per-datarate and per-band bitmasks of the common join channels.
+ */
+static RegionCommonChannelsIndex_t JoinChannelsIndex;
+
 /*
  * Context for the current channel plan.
  */
@@ -588,6 +598,9 @@ void RegionCN470InitDefaults( InitDefaultsParams_t* params )
         CN470_BAND0
     };
 
+    // Channel definitions may change
+    RegionCommonChannelsIndexInvalidate( &ChannelsIndex );
+
     switch( params->Type )
     {
         case INIT_TYPE_DEFAULTS:
@@ -1000,6 +1013,7 @@ LoRaMacStatus_t RegionCN470NextChannel( NextChanParams_t* nextChanParams, uint8_
     countChannelsParams.Bands = NvmCtx.Bands;
     countChannelsParams.MaxNbChannels = CN470_MAX_NB_CHANNELS;
     countChannelsParams.JoinChannels = NULL;
+    countChannelsParams.ChannelsIndex = &ChannelsIndex;
 
     // Apply a different channel selection if the device is not joined yet
     // In this case the device shall not follow the individual channel plans for the
@@ -1010,6 +1024,7 @@ LoRaMacStatus_t RegionCN470NextChannel( NextChanParams_t* nextChanParams, uint8_
         countChannelsParams.Channels = CommonJoinChannels;
         countChannelsParams.MaxNbChannels = CN470_COMMON_JOIN_CHANNELS_SIZE;
         countChannelsParams.JoinChannels = joinChannelsMask;
+        countChannelsParams.ChannelsIndex = &JoinChannelsIndex;
     }
 
     identifyChannelsParam.AggrTimeOff = nextChanParams->AggrTimeOff;
@@ -106,7 +106,6 @@ static uint16_t SetMaxTimeCredits( Band_t* band, bool joined, SysTime_t elapsedT
 {
     uint16_t dutyCycle = band->DCycle;
     TimerTime_t maxCredits = DUTY_CYCLE_TIME_PERIOD;
-    TimerTime_t elapsedTime = SysTimeToMs( elapsedTimeSinceStartup );
     SysTime_t timeDiff = { 0 };
 
     // Get the band duty cycle. If not joined, the function either returns the join duty cycle
@@ -115,6 +114,8 @@ static uint16_t SetMaxTimeCredits( Band_t* band, bool joined, SysTime_t elapsedT
 
     if( joined == false )
     {
+        TimerTime_t elapsedTime = SysTimeToMs( elapsedTimeSinceStartup );
+
         if( dutyCycle == BACKOFF_DC_1_HOUR )
         {
             maxCredits = DUTY_CYCLE_TIME_PERIOD;
@@ -198,18 +199,128 @@ static uint16_t UpdateTimeCredits( Band_t* band, bool joined, bool dutyCycleEnab
     return dutyCycle;
 }
 
-static uint8_t CountChannels( uint16_t mask, uint8_t nbBits )
+/*!
+ * \brief Updates the bands of a joined device. Joined devices are not subject
+ *        to the join backoff, hence the time credits only depend on the band
+ *        duty cycle and on the time elapsed since the last band update.
+ *        The system time based backoff computations are skipped and all bands
+ *        share a single time reference.
+ *
+ * \param [IN] bands A pointer to the bands.
+ *
+ * \param [IN] nbBands The number of bands available.
+ *
+ * \param [IN] dutyCycleEnabled Set to true, if the duty cycle is enabled.
+ *
+ * \param [IN] currentTime Current time.
+ *
+ * \param [IN] expectedTimeOnAir The expected time on air for the next transmission.
+ *
+ * \retval Returns the time which must be waited to perform the next uplink.
+ */
+static TimerTime_t UpdateJoinedBandsTimeOff( Band_t* bands, uint8_t nbBands, bool dutyCycleEnabled,
+                                             TimerTime_t currentTime, TimerTime_t expectedTimeOnAir )
 {
-    uint8_t nbActiveBits = 0;
+    TimerTime_t minTimeToWait = TIMERTIME_T_MAX;
+    uint8_t validBands = 0;
+
+    if( dutyCycleEnabled == false )
+    {
+        // Every band holds the maximum credits and is ready for transmission
+        for( uint8_t i = 0; i < nbBands; i++ )
+        {
+            bands[i].TimeCredits = DUTY_CYCLE_TIME_PERIOD;
+            bands[i].MaxTimeCredits = DUTY_CYCLE_TIME_PERIOD;
+            bands[i].LastBandUpdateTime = currentTime;
+            bands[i].ReadyForTransmission = true;
+        }
+        return TIMERTIME_T_MAX;
+    }
 
-    for( uint8_t j = 0; j < nbBits; j++ )
+    for( uint8_t i = 0; i < nbBands; i++ )
     {
-        if( ( mask & ( 1 << j ) ) == ( 1 << j ) )
+        Band_t* band = &bands[i];
+        TimerTime_t creditCosts = expectedTimeOnAir * ( ( band->DCycle == 0 ) ? 1 : band->DCycle );
+
+        if( band->LastBandUpdateTime == 0 )
+        {
+            // Assign the max credits if its the first time
+            band->TimeCredits = DUTY_CYCLE_TIME_PERIOD;
+        }
+        else
         {
-            nbActiveBits++;
+            // Apply a sliding window for the duty cycle with collection and spending
+            // credits.
+            band->TimeCredits += currentTime - band->LastBandUpdateTime;
         }
+        band->MaxTimeCredits = DUTY_CYCLE_TIME_PERIOD;
+        if( band->TimeCredits > band->MaxTimeCredits )
+        {
+            band->TimeCredits = band->MaxTimeCredits;
+        }
+        band->LastBandUpdateTime = currentTime;
+
+        if( band->TimeCredits > creditCosts )
+        {
+            band->ReadyForTransmission = true;
+            validBands++;
+        }
+        else
+        {
+            band->ReadyForTransmission = false;
+            if( band->MaxTimeCredits > creditCosts )
+            {
+                // The band becomes ready once enough credits have been collected
+                minTimeToWait = MIN( minTimeToWait, ( creditCosts - band->TimeCredits ) );
+                validBands++;
+            }
+        }
+    }
+
+    if( validBands == 0 )
+    {
+        // There is no valid band available to handle a transmission
+        // in the given DUTY_CYCLE_TIME_PERIOD.
+        return TIMERTIME_T_MAX;
+    }
+    return minTimeToWait;
+}
+
+static uint8_t CountChannels( uint16_t mask, uint8_t nbBits )
+{
+    if( nbBits < 16 )
+    {
+        mask &= ( 1 << nbBits ) - 1;
+    }
+    return __builtin_popcount( mask );
+}
+
+/*!
+ * \brief Gathers 64 channels of a 16 bit channels mask array into a word.
+ *        Bits beyond nbChannels are cleared.
+ *
+ * \param [IN] mask A pointer to the 16 bit channels mask array.
+ *
+ * \param [IN] word Index of the 64 bit word to gather.
+ *
+ * \param [IN] nbChannels Number of channels covered by the mask.
+ *
+ * \retval The 64 bit channels mask.
+ */
+static uint64_t GetChannelsMaskWord( const uint16_t* mask, uint8_t word, uint16_t nbChannels )
+{
+    uint64_t value = 0;
+    uint16_t first = word * 64;
+
+    for( uint8_t k = 0; ( k < 4 ) && ( ( first + ( k * 16 ) ) < nbChannels ); k++ )
+    {
+        value |= ( uint64_t )mask[( first / 16 ) + k] << ( k * 16 );
+    }
+    if( ( nbChannels - first ) < 64 )
+    {
+        value &= ( ( uint64_t )1 << ( nbChannels - first ) ) - 1;
     }
-    return nbActiveBits;
+    return value;
 }
 
 bool RegionCommonChanVerifyDr( uint8_t nbChannels, uint16_t* channelsMask, int8_t dr, int8_t minDr, int8_t maxDr, ChannelParams_t* channels )
@@ -318,6 +429,11 @@ TimerTime_t RegionCommonUpdateBandTimeOff( bool joined, Band_t* bands,
     uint16_t dutyCycle = 1;
     uint8_t validBands = 0;
 
+    if( joined == true )
+    {
+        return UpdateJoinedBandsTimeOff( bands, nbBands, dutyCycleEnabled, currentTime, expectedTimeOnAir );
+    }
+
     for( uint8_t i = 0; i < nbBands; i++ )
     {
         // Synchronization of bands and credits
@@ -346,51 +462,32 @@ TimerTime_t RegionCommonUpdateBandTimeOff( bool joined, Band_t* bands,
             // for the next transmission.
             bands[i].ReadyForTransmission = false;
 
-            // Differentiate the calculation if the device is joined or not.
-            if( joined == true )
+            // The device is not joined, the join backoff applies.
+            SysTime_t backoffTimeRange = {
+                .Seconds    = 0,
+                .SubSeconds = 0,
+            };
+            // Get the backoff time range based on the duty cycle definition
+            if( dutyCycle == BACKOFF_DC_1_HOUR )
             {
-                if( bands[i].MaxTimeCredits > creditCosts )
-                {
-                    // The band can only be taken into account, if the maximum credits
-                    // of the band are higher than the credit costs.
-                    // We calculate the minTimeToWait among the bands which are not
-                    // ready for transmission and which are potentially available
-                    // for a transmission in the future.
-                    minTimeToWait = MIN( minTimeToWait, ( creditCosts - bands[i].TimeCredits ) );
-                    // This band is a potential candidate for an
-                    // upcoming transmission (even if its time credits are not enough
-                    // at the moment), so increase the counter.
-                    validBands++;
-                }
+                backoffTimeRange.Seconds = BACKOFF_DUTY_CYCLE_1_HOUR_IN_S;
+            }
+            else if( dutyCycle == BACKOFF_DC_10_HOURS )
+            {
+                backoffTimeRange.Seconds = BACKOFF_DUTY_CYCLE_10_HOURS_IN_S;
             }
             else
             {
-                SysTime_t backoffTimeRange = {
-                    .Seconds    = 0,
-                    .SubSeconds = 0,
-                };
-                // Get the backoff time range based on the duty cycle definition
-                if( dutyCycle == BACKOFF_DC_1_HOUR )
-                {
-                    backoffTimeRange.Seconds = BACKOFF_DUTY_CYCLE_1_HOUR_IN_S;
-                }
-                else if( dutyCycle == BACKOFF_DC_10_HOURS )
-                {
-                    backoffTimeRange.Seconds = BACKOFF_DUTY_CYCLE_10_HOURS_IN_S;
-                }
-                else
-                {
-                    backoffTimeRange.Seconds = BACKOFF_DUTY_CYCLE_24_HOURS_IN_S;
-                }
-                // Calculate the time to wait.
-                if( elapsedTimeSinceStartup.Seconds > BACKOFF_DUTY_CYCLE_24_HOURS_IN_S )
-                {
-                    backoffTimeRange.Seconds += BACKOFF_24_HOURS_IN_S * ( ( ( elapsedTimeSinceStartup.Seconds - BACKOFF_DUTY_CYCLE_24_HOURS_IN_S ) / BACKOFF_24_HOURS_IN_S ) + 1 );
-                }
-                // Calculate the time difference between now and the next range
-                backoffTimeRange  = SysTimeSub( backoffTimeRange, elapsedTimeSinceStartup );
-                minTimeToWait = SysTimeToMs( backoffTimeRange );
+                backoffTimeRange.Seconds = BACKOFF_DUTY_CYCLE_24_HOURS_IN_S;
             }
+            // Calculate the time to wait.
+            if( elapsedTimeSinceStartup.Seconds > BACKOFF_DUTY_CYCLE_24_HOURS_IN_S )
+            {
+                backoffTimeRange.Seconds += BACKOFF_24_HOURS_IN_S * ( ( ( elapsedTimeSinceStartup.Seconds - BACKOFF_DUTY_CYCLE_24_HOURS_IN_S ) / BACKOFF_24_HOURS_IN_S ) + 1 );
+            }
+            // Calculate the time difference between now and the next range
+            backoffTimeRange  = SysTimeSub( backoffTimeRange, elapsedTimeSinceStartup );
+            minTimeToWait = SysTimeToMs( backoffTimeRange );
         }
     }
 
@@ -548,44 +645,108 @@ void RegionCommonRxBeaconSetup( RegionCommonRxBeaconSetupParams_t* rxBeaconSetup
     Radio.Rx( rxBeaconSetupParams->RxTime );
 }
 
+void RegionCommonChannelsIndexInvalidate( RegionCommonChannelsIndex_t* channelsIndex )
+{
+    channelsIndex->Valid = false;
+}
+
+void RegionCommonChannelsIndexUpdate( RegionCommonChannelsIndex_t* channelsIndex, const ChannelParams_t* channels, uint16_t nbChannels )
+{
+    memset1( ( uint8_t* )channelsIndex, 0, sizeof( RegionCommonChannelsIndex_t ) );
+
+    if( nbChannels > REGION_COMMON_CHANNELS_INDEX_MAX_NB_CHANNELS )
+    {
+        nbChannels = REGION_COMMON_CHANNELS_INDEX_MAX_NB_CHANNELS;
+    }
+
+    for( uint16_t i = 0; i < nbChannels; i++ )
+    {
+        uint64_t bit = ( uint64_t )1 << ( i % 64 );
+        uint8_t word = i / 64;
+
+        if( channels[i].Frequency == 0 )
+        { // Undefined channel
+            continue;
+        }
+        for( uint8_t dr = channels[i].DrRange.Fields.Min; dr <= channels[i].DrRange.Fields.Max; dr++ )
+        {
+            channelsIndex->DrChannels[dr][word] |= bit;
+        }
+        if( channels[i].Band < REGION_COMMON_CHANNELS_INDEX_MAX_NB_BANDS )
+        {
+            channelsIndex->BandChannels[channels[i].Band][word] |= bit;
+            if( channels[i].Band >= channelsIndex->NbBands )
+            {
+                channelsIndex->NbBands = channels[i].Band + 1;
+            }
+        }
+    }
+    channelsIndex->Channels = channels;
+    channelsIndex->Valid = true;
+}
+
 void RegionCommonCountNbOfEnabledChannels( RegionCommonCountNbOfEnabledChannelsParams_t* countNbOfEnabledChannelsParams,
                                            uint8_t* enabledChannels, uint8_t* nbEnabledChannels, uint8_t* nbRestrictedChannels )
 {
+    RegionCommonChannelsIndex_t localIndex;
+    RegionCommonChannelsIndex_t* channelsIndex = countNbOfEnabledChannelsParams->ChannelsIndex;
+    uint16_t nbChannels = countNbOfEnabledChannelsParams->MaxNbChannels;
+    uint8_t datarate = countNbOfEnabledChannelsParams->Datarate;
     uint8_t nbChannelCount = 0;
     uint8_t nbRestrictedChannelsCount = 0;
 
-    for( uint8_t i = 0, k = 0; i < countNbOfEnabledChannelsParams->MaxNbChannels; i += 16, k++ )
+    if( nbChannels > REGION_COMMON_CHANNELS_INDEX_MAX_NB_CHANNELS )
     {
-        for( uint8_t j = 0; j < 16; j++ )
+        nbChannels = REGION_COMMON_CHANNELS_INDEX_MAX_NB_CHANNELS;
+    }
+
+    if( channelsIndex == NULL )
+    {
+        channelsIndex = &localIndex;
+        channelsIndex->Valid = false;
+    }
+    if( ( channelsIndex->Valid == false ) || ( channelsIndex->Channels != countNbOfEnabledChannelsParams->Channels ) )
+    {
+        RegionCommonChannelsIndexUpdate( channelsIndex, countNbOfEnabledChannelsParams->Channels, nbChannels );
+    }
+
+    if( datarate >= REGION_COMMON_CHANNELS_INDEX_NB_DATARATES )
+    {
+        *nbEnabledChannels = 0;
+        *nbRestrictedChannels = 0;
+        return;
+    }
+
+    for( uint8_t w = 0; ( w * 64 ) < nbChannels; w++ )
+    {
+        uint64_t enabled = GetChannelsMaskWord( countNbOfEnabledChannelsParams->ChannelsMask, w, nbChannels );
+        uint64_t ready = 0;
+
+        if( ( countNbOfEnabledChannelsParams->Joined == false ) &&
+            ( countNbOfEnabledChannelsParams->JoinChannels != NULL ) )
+        {
+            enabled &= GetChannelsMaskWord( countNbOfEnabledChannelsParams->JoinChannels, w, nbChannels );
+        }
+        // Only defined channels supporting the given datarate
+        enabled &= channelsIndex->DrChannels[datarate][w];
+
+        for( uint8_t b = 0; b < channelsIndex->NbBands; b++ )
         {
-            if( ( countNbOfEnabledChannelsParams->ChannelsMask[k] & ( 1 << j ) ) != 0 )
+            if( countNbOfEnabledChannelsParams->Bands[b].ReadyForTransmission == true )
             {
-                if( countNbOfEnabledChannelsParams->Channels[i + j].Frequency == 0 )
-                { // Check if the channel is enabled
-                    continue;
-                }
-                if( ( countNbOfEnabledChannelsParams->Joined == false ) &&
-                    ( countNbOfEnabledChannelsParams->JoinChannels != NULL ) )
-                {
-                    if( ( countNbOfEnabledChannelsParams->JoinChannels[k] & ( 1 << j ) ) == 0 )
-                    {
-                        continue;
-                    }
-                }
-                if( RegionCommonValueInRange( countNbOfEnabledChannelsParams->Datarate,
-                                              countNbOfEnabledChannelsParams->Channels[i + j].DrRange.Fields.Min,
-                                              countNbOfEnabledChannelsParams->Channels[i + j].DrRange.Fields.Max ) == false )
-                { // Check if the current channel selection supports the given datarate
-                    continue;
-                }
-                if( countNbOfEnabledChannelsParams->Bands[countNbOfEnabledChannelsParams->Channels[i + j].Band].ReadyForTransmission == false )
-                { // Check if the band is available for transmission
-                    nbRestrictedChannelsCount++;
-                    continue;
-                }
-                enabledChannels[nbChannelCount++] = i + j;
+                ready |= channelsIndex->BandChannels[b][w];
             }
         }
+
+        // Channels whose band is not available for transmission
+        nbRestrictedChannelsCount += __builtin_popcountll( enabled & ~ready );
+
+        enabled &= ready;
+        while( enabled != 0 )
+        {
+            enabledChannels[nbChannelCount++] = ( w * 64 ) + __builtin_ctzll( enabled );
+            enabled &= enabled - 1;
+        }
     }
     *nbEnabledChannels = nbChannelCount;
     *nbRestrictedChannels = nbRestrictedChannelsCount;
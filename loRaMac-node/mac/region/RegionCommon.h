@@ -232,6 +232,58 @@ typedef struct sRegionCommonRxBeaconSetupParams
     uint16_t SymbolTimeout;
 }RegionCommonRxBeaconSetupParams_t;
 
+/*!
+ * Maximum number of channels supported by the channels index.
+ * Covers the largest channel plan (CN470, 96 channels).
+ */
+#define REGION_COMMON_CHANNELS_INDEX_MAX_NB_CHANNELS    96
+
+/*!
+ * Number of 64 bit words required to store a channels index bitmask.
+ */
+#define REGION_COMMON_CHANNELS_INDEX_NB_WORDS           ( ( REGION_COMMON_CHANNELS_INDEX_MAX_NB_CHANNELS + 63 ) / 64 )
+
+/*!
+ * Number of datarates tracked by the channels index.
+ */
+#define REGION_COMMON_CHANNELS_INDEX_NB_DATARATES       16
+
+/*!
+ * Maximum number of bands tracked by the channels index.
+ */
+#define REGION_COMMON_CHANNELS_INDEX_MAX_NB_BANDS       6
+
+/*!
+ * Precomputed per-datarate and per-band channel bitmasks.
+ *
+ * The index is derived from the channels array and only has to be rebuilt
+ * when a channel definition changes. It turns the per-uplink channel
+ * enumeration into a handful of word wide AND/popcount operations.
+ */
+typedef struct sRegionCommonChannelsIndex
+{
+    /*!
+     * Set to true, if the bitmasks match the channels array.
+     */
+    bool Valid;
+    /*!
+     * The channels array the index has been built from.
+     */
+    const ChannelParams_t* Channels;
+    /*!
+     * Number of bands referenced by the defined channels.
+     */
+    uint8_t NbBands;
+    /*!
+     * Defined channels ( Frequency != 0 ) supporting a given datarate.
+     */
+    uint64_t DrChannels[REGION_COMMON_CHANNELS_INDEX_NB_DATARATES][REGION_COMMON_CHANNELS_INDEX_NB_WORDS];
+    /*!
+     * Defined channels belonging to a given band.
+     */
+    uint64_t BandChannels[REGION_COMMON_CHANNELS_INDEX_MAX_NB_BANDS][REGION_COMMON_CHANNELS_INDEX_NB_WORDS];
+}RegionCommonChannelsIndex_t;
+
 typedef struct sRegionCommonCountNbOfEnabledChannelsParams
 {
     /*!
@@ -264,6 +316,12 @@ typedef struct sRegionCommonCountNbOfEnabledChannelsParams
      * ChannelsMask with a number of MaxNbChannels channels.
      */
     uint16_t* JoinChannels;
+    /*!
+     * A pointer to the channels index built from Channels. The index
+     * is rebuilt on demand, if it is invalid or refers to another
+     * channels array. May be NULL, in which case a temporary index is used.
+     */
+    RegionCommonChannelsIndex_t* ChannelsIndex;
 }RegionCommonCountNbOfEnabledChannelsParams_t;
 
 typedef struct sRegionCommonIdentifyChannelsParam
@@ -524,6 +582,25 @@ int8_t RegionCommonComputeTxPower( int8_t txPowerIndex, float maxEirp, float ant
  */
 void RegionCommonRxBeaconSetup( RegionCommonRxBeaconSetupParams_t* rxBeaconSetupParams );
 
+/*!
+ * \brief Marks a channels index as outdated. Shall be called each time
+ *        a channel definition changes.
+ *
+ * \param [IN] channelsIndex A pointer to the channels index.
+ */
+void RegionCommonChannelsIndexInvalidate( RegionCommonChannelsIndex_t* channelsIndex );
+
+/*!
+ * \brief Rebuilds the per-datarate and per-band bitmasks of a channels index.
+ *
+ * \param [OUT] channelsIndex A pointer to the channels index to build.
+ *
+ * \param [IN] channels A pointer to the channels.
+ *
+ * \param [IN] nbChannels The number of channels.
+ */
+void RegionCommonChannelsIndexUpdate( RegionCommonChannelsIndex_t* channelsIndex, const ChannelParams_t* channels, uint16_t nbChannels );
+
 /*!
  * \brief Counts the number of enabled channels.
  *
@@ -64,6 +64,11 @@ typedef struct sRegionEU433NvmCtx
  */
 static RegionEU433NvmCtx_t NvmCtx;
 
+/*
+ * Per-datarate and per-band bitmasks of the channels.
+ */
+static RegionCommonChannelsIndex_t ChannelsIndex;
+
 // Static functions
 static bool VerifyRfFreq( uint32_t freq )
 {
@@ -297,6 +302,9 @@ void RegionEU433InitDefaults( InitDefaultsParams_t* params )
         EU433_BAND0
     };
 
+    // Channel definitions may change
+    RegionCommonChannelsIndexInvalidate( &ChannelsIndex );
+
     switch( params->Type )
     {
         case INIT_TYPE_DEFAULTS:
@@ -809,6 +817,7 @@ LoRaMacStatus_t RegionEU433NextChannel( NextChanParams_t* nextChanParams, uint8_
     countChannelsParams.Bands = NvmCtx.Bands;
     countChannelsParams.MaxNbChannels = EU433_MAX_NB_CHANNELS;
     countChannelsParams.JoinChannels = &joinChannels;
+    countChannelsParams.ChannelsIndex = &ChannelsIndex;
 
     identifyChannelsParam.AggrTimeOff = nextChanParams->AggrTimeOff;
     identifyChannelsParam.LastAggrTx = nextChanParams->LastAggrTx;
@@ -890,6 +899,7 @@ LoRaMacStatus_t RegionEU433ChannelAdd( ChannelAddParams_t* channelAdd )
         return LORAMAC_STATUS_FREQUENCY_INVALID;
     }
 
+    RegionCommonChannelsIndexInvalidate( &ChannelsIndex );
     memcpy1( ( uint8_t* ) &(NvmCtx.Channels[id]), ( uint8_t* ) channelAdd->NewChannel, sizeof( NvmCtx.Channels[id] ) );
     NvmCtx.Channels[id].Band = 0;
     NvmCtx.ChannelsMask[0] |= ( 1 << id );
@@ -907,6 +917,7 @@ bool RegionEU433ChannelsRemove( ChannelRemoveParams_t* channelRemove  )
 
     // Remove the channel from the list of channels
     NvmCtx.Channels[id] = ( ChannelParams_t ){ 0, 0, { 0 }, 0 };
+    RegionCommonChannelsIndexInvalidate( &ChannelsIndex );
 
     return RegionCommonChanDisable( NvmCtx.ChannelsMask, id, EU433_MAX_NB_CHANNELS );
 }
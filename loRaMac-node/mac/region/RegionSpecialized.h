@@ -0,0 +1,187 @@
+/*!
+ * \file      RegionSpecialized.h
+ *
+ * \brief     Compile-time single region specialization of the region API.
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *                ______                              _
+ *               / _____)             _              | |
+ *              ( (____  _____ ____ _| |_ _____  ____| |__
+ *               \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ *               _____) ) ____| | | || |_| ____( (___| | | |
+ *              (______/|_____)_|_|_| \__)_____)\____)_| |_|
+ *              (C)2013-2017 Semtech
+ *
+ *               ___ _____ _   ___ _  _____ ___  ___  ___ ___
+ *              / __|_   _/_\ / __| |/ / __/ _ \| _ \/ __| __|
+ *              \__ \ | |/ _ \ (__| ' <| _| (_) |   / (__| _|
+ *              |___/ |_/_/ \_\___|_|\_\_| \___/|_|_\\___|___|
+ *              embedded.connectivity.solutions===============
+ *
+ * \endcode
+ *
+ * \addtogroup REGION
+ *
+ *            Defining REGION_SPECIALIZED to one of the region names, e.g.
+ *            -DREGION_SPECIALIZED=US915, replaces the run-time dispatch of
+ *            Region.c by inline calls into that region. The region argument
+ *            is ignored, and LoRaMacInitialization only accepts the
+ *            specialized region. Combined with link time optimization, the
+ *            region implementation inlines into the MAC layer.
+ *
+ * \{
+ */
+#ifndef __REGION_SPECIALIZED_H__
+#define __REGION_SPECIALIZED_H__
+
+#define REGION_SPECIALIZED_CONCAT( a, b, c )        a##b##c
+#define REGION_SPECIALIZED_EXPAND( a, b, c )        REGION_SPECIALIZED_CONCAT( a, b, c )
+
+/*!
+ * Name of the region implementation of an API function.
+ * Example: REGION_SPECIALIZED_FN( GetPhyParam ) is RegionUS915GetPhyParam.
+ */
+#define REGION_SPECIALIZED_FN( name )               REGION_SPECIALIZED_EXPAND( Region, REGION_SPECIALIZED, name )
+
+/*!
+ * LoRaMacRegion_t value of the specialized region.
+ */
+#define REGION_SPECIALIZED_ID                       REGION_SPECIALIZED_EXPAND( LORAMAC_REGION_, REGION_SPECIALIZED, )
+
+PhyParam_t REGION_SPECIALIZED_FN( GetPhyParam )( GetPhyParams_t* getPhy );
+void REGION_SPECIALIZED_FN( SetBandTxDone )( SetBandTxDoneParams_t* txDone );
+void REGION_SPECIALIZED_FN( InitDefaults )( InitDefaultsParams_t* params );
+void* REGION_SPECIALIZED_FN( GetNvmCtx )( GetNvmCtxParams_t* params );
+bool REGION_SPECIALIZED_FN( Verify )( VerifyParams_t* verify, PhyAttribute_t phyAttribute );
+void REGION_SPECIALIZED_FN( ApplyCFList )( ApplyCFListParams_t* applyCFList );
+bool REGION_SPECIALIZED_FN( ChanMaskSet )( ChanMaskSetParams_t* chanMaskSet );
+void REGION_SPECIALIZED_FN( ComputeRxWindowParameters )( int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams );
+bool REGION_SPECIALIZED_FN( RxConfig )( RxConfigParams_t* rxConfig, int8_t* datarate );
+bool REGION_SPECIALIZED_FN( TxConfig )( TxConfigParams_t* txConfig, int8_t* txPower, TimerTime_t* txTimeOnAir );
+uint8_t REGION_SPECIALIZED_FN( LinkAdrReq )( LinkAdrReqParams_t* linkAdrReq, int8_t* drOut, int8_t* txPowOut, uint8_t* nbRepOut, uint8_t* nbBytesParsed );
+uint8_t REGION_SPECIALIZED_FN( RxParamSetupReq )( RxParamSetupReqParams_t* rxParamSetupReq );
+uint8_t REGION_SPECIALIZED_FN( NewChannelReq )( NewChannelReqParams_t* newChannelReq );
+int8_t REGION_SPECIALIZED_FN( TxParamSetupReq )( TxParamSetupReqParams_t* txParamSetupReq );
+uint8_t REGION_SPECIALIZED_FN( DlChannelReq )( DlChannelReqParams_t* dlChannelReq );
+int8_t REGION_SPECIALIZED_FN( AlternateDr )( int8_t currentDr, AlternateDrType_t type );
+LoRaMacStatus_t REGION_SPECIALIZED_FN( NextChannel )( NextChanParams_t* nextChanParams, uint8_t* channel, TimerTime_t* time, TimerTime_t* aggregatedTimeOff );
+LoRaMacStatus_t REGION_SPECIALIZED_FN( ChannelAdd )( ChannelAddParams_t* channelAdd );
+bool REGION_SPECIALIZED_FN( ChannelsRemove )( ChannelRemoveParams_t* channelRemove );
+uint8_t REGION_SPECIALIZED_FN( ApplyDrOffset )( uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset );
+void REGION_SPECIALIZED_FN( RxBeaconSetup )( RxBeaconSetup_t* rxBeaconSetup, uint8_t* outDr );
+
+static inline bool RegionIsActive( LoRaMacRegion_t region )
+{
+    return region == REGION_SPECIALIZED_ID;
+}
+
+static inline PhyParam_t RegionGetPhyParam( LoRaMacRegion_t region, GetPhyParams_t* getPhy )
+{
+    return REGION_SPECIALIZED_FN( GetPhyParam )( getPhy );
+}
+
+static inline void RegionSetBandTxDone( LoRaMacRegion_t region, SetBandTxDoneParams_t* txDone )
+{
+    REGION_SPECIALIZED_FN( SetBandTxDone )( txDone );
+}
+
+static inline void RegionInitDefaults( LoRaMacRegion_t region, InitDefaultsParams_t* params )
+{
+    REGION_SPECIALIZED_FN( InitDefaults )( params );
+}
+
+static inline void* RegionGetNvmCtx( LoRaMacRegion_t region, GetNvmCtxParams_t* params )
+{
+    return REGION_SPECIALIZED_FN( GetNvmCtx )( params );
+}
+
+static inline bool RegionVerify( LoRaMacRegion_t region, VerifyParams_t* verify, PhyAttribute_t phyAttribute )
+{
+    return REGION_SPECIALIZED_FN( Verify )( verify, phyAttribute );
+}
+
+static inline void RegionApplyCFList( LoRaMacRegion_t region, ApplyCFListParams_t* applyCFList )
+{
+    REGION_SPECIALIZED_FN( ApplyCFList )( applyCFList );
+}
+
+static inline bool RegionChanMaskSet( LoRaMacRegion_t region, ChanMaskSetParams_t* chanMaskSet )
+{
+    return REGION_SPECIALIZED_FN( ChanMaskSet )( chanMaskSet );
+}
+
+static inline void RegionComputeRxWindowParameters( LoRaMacRegion_t region, int8_t datarate, uint8_t minRxSymbols, uint32_t rxError, RxConfigParams_t *rxConfigParams )
+{
+    REGION_SPECIALIZED_FN( ComputeRxWindowParameters )( datarate, minRxSymbols, rxError, rxConfigParams );
+}
+
+static inline bool RegionRxConfig( LoRaMacRegion_t region, RxConfigParams_t* rxConfig, int8_t* datarate )
+{
+    return REGION_SPECIALIZED_FN( RxConfig )( rxConfig, datarate );
+}
+
+static inline bool RegionTxConfig( LoRaMacRegion_t region, TxConfigParams_t* txConfig, int8_t* txPower, TimerTime_t* txTimeOnAir )
+{
+    return REGION_SPECIALIZED_FN( TxConfig )( txConfig, txPower, txTimeOnAir );
+}
+
+static inline uint8_t RegionLinkAdrReq( LoRaMacRegion_t region, LinkAdrReqParams_t* linkAdrReq, int8_t* drOut, int8_t* txPowOut, uint8_t* nbRepOut, uint8_t* nbBytesParsed )
+{
+    return REGION_SPECIALIZED_FN( LinkAdrReq )( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed );
+}
+
+static inline uint8_t RegionRxParamSetupReq( LoRaMacRegion_t region, RxParamSetupReqParams_t* rxParamSetupReq )
+{
+    return REGION_SPECIALIZED_FN( RxParamSetupReq )( rxParamSetupReq );
+}
+
+static inline uint8_t RegionNewChannelReq( LoRaMacRegion_t region, NewChannelReqParams_t* newChannelReq )
+{
+    return REGION_SPECIALIZED_FN( NewChannelReq )( newChannelReq );
+}
+
+static inline int8_t RegionTxParamSetupReq( LoRaMacRegion_t region, TxParamSetupReqParams_t* txParamSetupReq )
+{
+    return REGION_SPECIALIZED_FN( TxParamSetupReq )( txParamSetupReq );
+}
+
+static inline uint8_t RegionDlChannelReq( LoRaMacRegion_t region, DlChannelReqParams_t* dlChannelReq )
+{
+    return REGION_SPECIALIZED_FN( DlChannelReq )( dlChannelReq );
+}
+
+static inline int8_t RegionAlternateDr( LoRaMacRegion_t region, int8_t currentDr, AlternateDrType_t type )
+{
+    return REGION_SPECIALIZED_FN( AlternateDr )( currentDr, type );
+}
+
+static inline LoRaMacStatus_t RegionNextChannel( LoRaMacRegion_t region, NextChanParams_t* nextChanParams, uint8_t* channel, TimerTime_t* time, TimerTime_t* aggregatedTimeOff )
+{
+    return REGION_SPECIALIZED_FN( NextChannel )( nextChanParams, channel, time, aggregatedTimeOff );
+}
+
+static inline LoRaMacStatus_t RegionChannelAdd( LoRaMacRegion_t region, ChannelAddParams_t* channelAdd )
+{
+    return REGION_SPECIALIZED_FN( ChannelAdd )( channelAdd );
+}
+
+static inline bool RegionChannelsRemove( LoRaMacRegion_t region, ChannelRemoveParams_t* channelRemove )
+{
+    return REGION_SPECIALIZED_FN( ChannelsRemove )( channelRemove );
+}
+
+static inline uint8_t RegionApplyDrOffset( LoRaMacRegion_t region, uint8_t downlinkDwellTime, int8_t dr, int8_t drOffset )
+{
+    return REGION_SPECIALIZED_FN( ApplyDrOffset )( downlinkDwellTime, dr, drOffset );
+}
+
+static inline void RegionRxBeaconSetup( LoRaMacRegion_t region, RxBeaconSetup_t* rxBeaconSetup, uint8_t* outDr )
+{
+    REGION_SPECIALIZED_FN( RxBeaconSetup )( rxBeaconSetup, outDr );
+}
+
+/*! \} addtogroup REGION */
+
+#endif // __REGION_SPECIALIZED_H__
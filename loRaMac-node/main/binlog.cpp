@@ -0,0 +1,445 @@
+#include "main/binlog.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace binlog {
+
+namespace detail {
+
+std::atomic<uint8_t> min_severity{static_cast<uint8_t>(Severity::info)};
+
+thread_local Ring* thread_ring = nullptr;
+
+} // namespace detail
+
+namespace {
+
+using detail::ArgType;
+using detail::Record;
+using detail::Ring;
+
+const char* const kSeverityNames[] = { "trace", "debug", "info", "warning", "error", "fatal" };
+
+struct Format {
+    Severity severity;
+    const char* text;
+};
+
+/*!
+ * Retires the ring of a thread when the thread exits
+ */
+struct ThreadExit {
+    std::shared_ptr<Ring> ring;
+
+    ~ThreadExit()
+    {
+        if (ring) {
+            ring->retired.store(true, std::memory_order_release);
+            detail::thread_ring = nullptr;
+        }
+    }
+};
+
+thread_local ThreadExit thread_exit;
+
+ArgType arg_type(const Record& record, size_t slot)
+{
+    return static_cast<ArgType>((record.types >> (4 * slot)) & 0x0F);
+}
+
+class Backend {
+public:
+    ~Backend() { stop(); }
+
+    bool start(const Config& config);
+    void stop();
+
+    uint16_t register_format(Severity severity, const char* text);
+    Ring* register_thread();
+    uint64_t dropped();
+
+private:
+    void run();
+    bool drain();
+    void format(const Record& record, std::string& line);
+    bool open_file();
+    void write(const std::string& text);
+    void calibrate();
+    uint64_t wall_time(uint64_t ticks) const;
+
+    Config config_;
+
+    // Conversion of the event ticks to wall clock time
+    uint64_t tick_base_ = 0;
+    uint64_t wall_base_ = 0;
+    uint64_t wall_calibrated_ = 0;
+    double ns_per_tick_ = 1.0;
+
+    Format formats_[kMaxFormats];
+    std::atomic<uint16_t> nb_formats_{0};
+    std::mutex formats_mutex_;
+
+    std::vector<std::shared_ptr<Ring>> rings_;
+    std::mutex rings_mutex_;
+    // Events dropped by the rings already freed
+    uint64_t retired_dropped_ = 0;
+
+    std::thread thread_;
+    std::mutex run_mutex_;
+    std::condition_variable run_cv_;
+    bool running_ = false;
+
+    FILE* file_ = nullptr;
+    unsigned file_counter_ = 0;
+    size_t file_size_ = 0;
+    int file_day_ = -1;
+
+    std::vector<Record> batch_;
+    std::string text_;
+};
+
+uint64_t wall_clock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+Backend& backend()
+{
+    static Backend instance;
+    return instance;
+}
+
+bool Backend::start(const Config& config)
+{
+    stop();
+
+    config_ = config;
+    file_counter_ = 0;
+    if (!config_.file_pattern.empty() && !open_file()) {
+        return false;
+    }
+    detail::min_severity.store(static_cast<uint8_t>(config_.min_severity), std::memory_order_relaxed);
+
+    // First estimate of the tick rate, refined by every drain
+    tick_base_ = detail::ticks();
+    wall_base_ = wall_clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    calibrate();
+
+    running_ = true;
+    thread_ = std::thread(&Backend::run, this);
+    return true;
+}
+
+void Backend::stop()
+{
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(run_mutex_);
+        running_ = false;
+    }
+    run_cv_.notify_one();
+    thread_.join();
+
+    if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+uint16_t Backend::register_format(Severity severity, const char* text)
+{
+    std::lock_guard<std::mutex> lock(formats_mutex_);
+    uint16_t id = nb_formats_.load(std::memory_order_relaxed);
+
+    if (id == kMaxFormats) {
+        // Out of ids, the messages of the remaining call sites share the last
+        return kMaxFormats - 1;
+    }
+    formats_[id] = { severity, text };
+    nb_formats_.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+Ring* Backend::register_thread()
+{
+    std::shared_ptr<Ring> ring = std::make_shared<Ring>();
+
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings_.push_back(ring);
+    }
+    thread_exit.ring = ring;
+    detail::thread_ring = ring.get();
+    return ring.get();
+}
+
+uint64_t Backend::dropped()
+{
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    uint64_t total = retired_dropped_;
+
+    for (const auto& ring : rings_) {
+        total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void Backend::run()
+{
+    std::unique_lock<std::mutex> lock(run_mutex_);
+
+    while (running_) {
+        lock.unlock();
+        bool idle = !drain();
+        lock.lock();
+        if (idle) {
+            run_cv_.wait_for(lock, config_.flush_interval);
+        }
+    }
+    lock.unlock();
+
+    // Events logged before stop()
+    while (drain()) {
+    }
+}
+
+bool Backend::drain()
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings = rings_;
+    }
+
+    batch_.clear();
+    for (const auto& ring : rings) {
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        uint64_t tail = ring->tail.load(std::memory_order_acquire);
+
+        for (; head != tail; head++) {
+            batch_.push_back(ring->records[head & (kRingSize - 1)]);
+        }
+        ring->head.store(head, std::memory_order_release);
+    }
+
+    {
+        // Threads that exited and were fully drained above
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (auto it = rings_.begin(); it != rings_.end();) {
+            Ring* ring = it->get();
+            if (ring->retired.load(std::memory_order_acquire) &&
+                ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_acquire)) {
+                retired_dropped_ += ring->dropped.load(std::memory_order_relaxed);
+                it = rings_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    if (batch_.empty()) {
+        return false;
+    }
+    calibrate();
+
+    // Each ring is in order, merge the threads
+    std::stable_sort(batch_.begin(), batch_.end(),
+                     [](const Record& a, const Record& b) { return a.time < b.time; });
+
+    text_.clear();
+    for (const Record& record : batch_) {
+        format(record, text_);
+    }
+    write(text_);
+    return true;
+}
+
+void Backend::calibrate()
+{
+    uint64_t ticks = detail::ticks();
+    uint64_t wall = wall_clock();
+
+    // The longer the base line, the better the estimate
+    if (wall - wall_calibrated_ < 1000000000 && wall_calibrated_ != 0) {
+        return;
+    }
+    if (ticks != tick_base_) {
+        ns_per_tick_ = static_cast<double>(wall - wall_base_) / static_cast<double>(ticks - tick_base_);
+    }
+    wall_calibrated_ = wall;
+}
+
+uint64_t Backend::wall_time(uint64_t ticks) const
+{
+    // Events logged before start() are before the base
+    return wall_base_ + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(ticks - tick_base_)) * ns_per_tick_);
+}
+
+void Backend::format(const Record& record, std::string& line)
+{
+    const Format& format = formats_[record.format];
+    uint64_t time = wall_time(record.time);
+    time_t seconds = static_cast<time_t>(time / 1000000000);
+    unsigned micros = static_cast<unsigned>((time % 1000000000) / 1000);
+    struct tm tm;
+    char buffer[64];
+    size_t slot = 0;
+
+    localtime_r(&seconds, &tm);
+    // Same layout as the former "[%TimeStamp%] [%Severity%] %Message%" sinks
+    size_t n = strftime(buffer, sizeof(buffer), "[%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(buffer + n, sizeof(buffer) - n, ".%06u] [%s] ", micros,
+             kSeverityNames[static_cast<uint8_t>(format.severity)]);
+    line += buffer;
+
+    for (const char* p = format.text; *p != '\0'; p++) {
+        if (p[0] != '{' || p[1] != '}' || slot >= record.nslots) {
+            line += *p;
+            continue;
+        }
+        p++;
+
+        uint64_t value = record.args[slot];
+        switch (arg_type(record, slot)) {
+        case ArgType::signed_int:
+            snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+            line += buffer;
+            break;
+        case ArgType::unsigned_int:
+            snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+            line += buffer;
+            break;
+        case ArgType::floating: {
+            double d;
+            std::memcpy(&d, &value, sizeof(d));
+            snprintf(buffer, sizeof(buffer), "%g", d);
+            line += buffer;
+            break;
+        }
+        case ArgType::boolean:
+            line += value ? "true" : "false";
+            break;
+        case ArgType::character:
+            line += static_cast<char>(value);
+            break;
+        case ArgType::string: {
+            size_t slots = 1;
+            while (slot + slots < record.nslots && arg_type(record, slot + slots) == ArgType::string_continued) {
+                slots++;
+            }
+            const char* s = reinterpret_cast<const char*>(&record.args[slot]);
+            line.append(s, strnlen(s, slots * sizeof(uint64_t)));
+            slot += slots - 1;
+            break;
+        }
+        case ArgType::string_continued:
+            break;
+        }
+        slot++;
+    }
+    line += '\n';
+}
+
+bool Backend::open_file()
+{
+    std::string path = config_.file_pattern;
+    size_t pos = path.find("%N");
+
+    if (pos != std::string::npos) {
+        path.replace(pos, 2, std::to_string(file_counter_));
+    }
+    file_counter_++;
+
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+    file_ = fopen(path.c_str(), "a");
+    file_size_ = 0;
+    // Appending to the file of a previous run, it counts towards the rotation
+    if (file_ != nullptr && fseek(file_, 0, SEEK_END) == 0) {
+        long size = ftell(file_);
+        file_size_ = (size > 0) ? static_cast<size_t>(size) : 0;
+    }
+
+    time_t now = time(nullptr);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    file_day_ = tm.tm_yday;
+
+    return file_ != nullptr;
+}
+
+void Backend::write(const std::string& text)
+{
+    if (config_.console) {
+        fwrite(text.data(), 1, text.size(), stdout);
+        fflush(stdout);
+    }
+    if (file_ == nullptr) {
+        return;
+    }
+
+    if (config_.rotate_daily) {
+        time_t now = time(nullptr);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        if (tm.tm_yday != file_day_) {
+            open_file();
+        }
+    }
+    if (file_size_ >= config_.rotation_size) {
+        open_file();
+    }
+    if (file_ != nullptr) {
+        // One write and one flush per batch rather than per message
+        fwrite(text.data(), 1, text.size(), file_);
+        fflush(file_);
+        file_size_ += text.size();
+    }
+}
+
+} // namespace
+
+bool start(const Config& config)
+{
+    return backend().start(config);
+}
+
+void stop()
+{
+    backend().stop();
+}
+
+uint64_t dropped()
+{
+    return backend().dropped();
+}
+
+uint16_t register_format(Severity severity, const char* format)
+{
+    return backend().register_format(severity, format);
+}
+
+namespace detail {
+
+Ring* register_thread()
+{
+    return backend().register_thread();
+}
+
+} // namespace detail
+
+} // namespace binlog
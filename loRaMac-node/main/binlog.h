@@ -0,0 +1,322 @@
+/*!
+ * \file      binlog.h
+ *
+ * \brief     Asynchronous binary logger
+ *
+ * \details   Logging a message on the hot path only records a binary event in
+ *            a ring buffer owned by the calling thread: the id of the format
+ *            string, a timestamp and the raw arguments. No formatting, no
+ *            lock, no system call.
+ *
+ *            A background thread drains the rings of all the threads, orders
+ *            the events by time, formats them as
+ *            "[TimeStamp] [Severity] Message" and writes them in batches to
+ *            the log file, rotated on size and at midnight, and optionally
+ *            to the console.
+ *
+ *            A thread whose ring is full drops its events rather than
+ *            waiting, see dropped().
+ *
+ *            Usage:
+ *                BINLOG(binlog::Severity::info, "device {} joined in {} ms", devAddr, latency);
+ *
+ *            Arguments are integers, floating point values, booleans,
+ *            characters and strings. A message has at most kMaxArgs
+ *            arguments, each "{}" of the format takes the next one.
+ *
+ *            Strings are copied into the record, so they may be freed as
+ *            soon as BINLOG returns. A string takes the argument slots the
+ *            other arguments leave, 8 characters per slot, and is
+ *            truncated to them: up to 48 characters alone in a message, 8
+ *            when every argument is a string.
+ */
+#ifndef __MAIN_BINLOG_H__
+#define __MAIN_BINLOG_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace binlog {
+
+enum class Severity : uint8_t {
+    trace,
+    debug,
+    info,
+    warning,
+    error,
+    fatal,
+};
+
+struct Config {
+    /*!
+     * Log file, "%N" is replaced by the rotation counter. Empty for no file.
+     */
+    std::string file_pattern;
+    /*!
+     * Size after which the file is rotated [bytes]
+     */
+    size_t rotation_size = 10 * 1024 * 1024;
+    /*!
+     * Also rotate the file at midnight
+     */
+    bool rotate_daily = true;
+    /*!
+     * Also write the messages to the standard output
+     */
+    bool console = false;
+    Severity min_severity = Severity::info;
+    /*!
+     * Background thread wake up period while the rings are empty
+     */
+    std::chrono::milliseconds flush_interval{10};
+};
+
+/*!
+ * Most arguments of one message
+ */
+constexpr size_t kMaxArgs = 6;
+
+/*!
+ * Events per thread ring, a power of two
+ */
+constexpr size_t kRingSize = 4096;
+
+/*!
+ * Most distinct format strings
+ */
+constexpr size_t kMaxFormats = 4096;
+
+/*!
+ * \brief Starts the background thread
+ *
+ * \retval true on success, false if the log file can not be opened
+ */
+bool start(const Config& config);
+
+/*!
+ * \brief Writes out the pending events and stops the background thread
+ */
+void stop();
+
+/*!
+ * \brief Number of events dropped because a ring was full
+ */
+uint64_t dropped();
+
+/*!
+ * \brief Registers a format string, once per call site, see BINLOG
+ *
+ * \retval Format id
+ */
+uint16_t register_format(Severity severity, const char* format);
+
+namespace detail {
+
+enum class ArgType : uint8_t {
+    signed_int,
+    unsigned_int,
+    floating,
+    boolean,
+    character,
+    // First slot of a string, continued in the following slots
+    string,
+    string_continued,
+};
+
+/*!
+ * One event, one cache line
+ */
+struct Record {
+    // See ticks()
+    uint64_t time;
+    uint16_t format;
+    // Argument slots in use, a string may take several
+    uint8_t nslots;
+    uint8_t reserved;
+    // ArgType of each slot, 4 bits each
+    uint32_t types;
+    uint64_t args[kMaxArgs];
+};
+static_assert(sizeof(Record) == 64, "a record fills a cache line");
+static_assert(kMaxArgs <= 8, "argument types do not fit the record");
+
+/*!
+ * Single producer, single consumer ring of a thread
+ */
+struct Ring {
+    // Written by the background thread
+    alignas(64) std::atomic<uint64_t> head{0};
+    // Written by the owning thread
+    alignas(64) std::atomic<uint64_t> tail{0};
+    uint64_t cached_head = 0;
+    std::atomic<uint64_t> dropped{0};
+    // Set when the owning thread exited, the ring is freed once drained
+    std::atomic<bool> retired{false};
+    Record records[kRingSize];
+};
+
+extern std::atomic<uint8_t> min_severity;
+
+/*!
+ * Ring of the calling thread, nullptr until its first message
+ */
+extern thread_local Ring* thread_ring;
+
+/*!
+ * \brief Creates and registers the ring of the calling thread
+ */
+Ring* register_thread();
+
+/*!
+ * \brief Event timestamp. The time stamp counter where there is one, the
+ *        logger thread converts it to wall clock time.
+ */
+inline uint64_t ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*!
+ * \brief Copies a string into the slots the arguments after it leave
+ */
+inline void encode_string(Record* record, size_t& slot, size_t after, const char* s, size_t size)
+{
+    size_t room = (kMaxArgs - slot - after) * sizeof(uint64_t);
+    size_t slots;
+
+    if (size > room) {
+        size = room;
+    }
+    slots = (size == 0) ? 1 : (size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    // The formatter stops at the first NUL of the slots or at their end
+    record->args[slot + slots - 1] = 0;
+    std::memcpy(&record->args[slot], s, size);
+    record->types |= static_cast<uint32_t>(ArgType::string) << (4 * slot);
+    for (size_t i = 1; i < slots; i++) {
+        record->types |= static_cast<uint32_t>(ArgType::string_continued) << (4 * (slot + i));
+    }
+    slot += slots;
+}
+
+/*!
+ * \brief Encodes an argument in the next slot, or slots for a string
+ *
+ * \param [IN] after Number of arguments that follow, each needs a slot
+ */
+template <typename T>
+inline void encode(Record* record, size_t& slot, size_t after, const T& value)
+{
+    using U = std::decay_t<T>;
+    ArgType type;
+
+    if constexpr (std::is_same<U, std::string>::value) {
+        encode_string(record, slot, after, value.data(), value.size());
+        return;
+    }
+    else if constexpr (std::is_convertible<U, const char*>::value && !std::is_same<U, std::nullptr_t>::value) {
+        const char* s = value;
+
+        if (s == nullptr) {
+            s = "(null)";
+        }
+        encode_string(record, slot, after, s, strnlen(s, (kMaxArgs - slot - after) * sizeof(uint64_t)));
+        return;
+    }
+    else if constexpr (std::is_same<U, bool>::value) {
+        type = ArgType::boolean;
+        record->args[slot] = value;
+    }
+    else if constexpr (std::is_same<U, char>::value) {
+        type = ArgType::character;
+        record->args[slot] = static_cast<unsigned char>(value);
+    }
+    else if constexpr (std::is_enum<U>::value) {
+        encode(record, slot, after, static_cast<std::underlying_type_t<U>>(value));
+        return;
+    }
+    else if constexpr (std::is_integral<U>::value && std::is_signed<U>::value) {
+        type = ArgType::signed_int;
+        record->args[slot] = static_cast<uint64_t>(static_cast<int64_t>(value));
+    }
+    else if constexpr (std::is_integral<U>::value) {
+        type = ArgType::unsigned_int;
+        record->args[slot] = static_cast<uint64_t>(value);
+    }
+    else {
+        static_assert(std::is_floating_point<U>::value, "unsupported log argument type");
+        double d = static_cast<double>(value);
+        type = ArgType::floating;
+        std::memcpy(&record->args[slot], &d, sizeof(d));
+    }
+    record->types |= static_cast<uint32_t>(type) << (4 * slot);
+    slot++;
+}
+
+template <typename... Args>
+inline void write(uint16_t format, const Args&... args)
+{
+    static_assert(sizeof...(Args) <= kMaxArgs, "too many log arguments");
+
+    Ring* ring = thread_ring;
+
+    if (ring == nullptr) {
+        ring = register_thread();
+    }
+
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+
+    if (tail - ring->cached_head >= kRingSize) {
+        ring->cached_head = ring->head.load(std::memory_order_acquire);
+        if (tail - ring->cached_head >= kRingSize) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    Record* record = &ring->records[tail & (kRingSize - 1)];
+    size_t slot = 0;
+    size_t after = sizeof...(Args);
+
+    record->time = ticks();
+    record->format = format;
+    record->types = 0;
+    (encode(record, slot, --after, args), ...);
+    (void)after;
+    record->nslots = static_cast<uint8_t>(slot);
+    ring->tail.store(tail + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+inline bool enabled(Severity severity)
+{
+    return static_cast<uint8_t>(severity) >= detail::min_severity.load(std::memory_order_relaxed);
+}
+
+} // namespace binlog
+
+/*!
+ * \brief Logs a message, the format string is registered on the first call
+ */
+#define BINLOG(severity, format, ...)                                                              \
+    do {                                                                                           \
+        if (::binlog::enabled(severity)) {                                                         \
+            static const uint16_t binlog_format_ = ::binlog::register_format((severity), (format)); \
+            ::binlog::detail::write(binlog_format_, ##__VA_ARGS__);                                \
+        }                                                                                          \
+    } while (0)
+
+#endif // __MAIN_BINLOG_H__
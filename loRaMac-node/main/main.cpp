@@ -1,100 +1,227 @@
 #include <iostream>
 #include <iterator>
 #include <stdio.h>
+#include <time.h>
+#include <vector>
 #include <boost/program_options.hpp>
 
 #include <czmq.h>
 // #include <zmq.h>
 
+#include "radio.h"
+#include "LoRaMac.h"
+#include "LoRaMacSnapshot.h"
+#include "LoRaMacTrace.h"
+#include "sim/trace.h"
+
 const char* ENV_MAC_SERVICE_RPC_ADDR = "MAC_RPC_BACKEND_ADDRESS";
 
 namespace po = boost::program_options;
 
 using namespace std;
 
-#include <boost/log/core.hpp>
-#include <boost/log/trivial.hpp>
-#include <boost/log/expressions.hpp>
-#include <boost/log/sinks/text_file_backend.hpp>
-#include <boost/log/utility/setup/file.hpp>
-#include <boost/log/utility/setup/common_attributes.hpp>
-#include <boost/log/sources/severity_logger.hpp>
-#include <boost/log/sources/record_ostream.hpp>
-#include <boost/log/utility/setup/console.hpp>
+static const struct {
+    const char* name;
+    LoRaMacRegion_t region;
+} region_names[] = {
+    { "AS923", LORAMAC_REGION_AS923 },
+    { "AU915", LORAMAC_REGION_AU915 },
+    { "CN470", LORAMAC_REGION_CN470 },
+    { "CN779", LORAMAC_REGION_CN779 },
+    { "EU433", LORAMAC_REGION_EU433 },
+    { "EU868", LORAMAC_REGION_EU868 },
+    { "KR920", LORAMAC_REGION_KR920 },
+    { "IN865", LORAMAC_REGION_IN865 },
+    { "US915", LORAMAC_REGION_US915 },
+    { "RU864", LORAMAC_REGION_RU864 },
+};
+
+static bool parse_region(const string& name, LoRaMacRegion_t* region)
+{
+    for (const auto& entry : region_names) {
+        if (name == entry.name) {
+            *region = entry.region;
+            return RegionIsActive(entry.region);
+        }
+    }
+    return false;
+}
 
-namespace logging = boost::log;
-namespace src = boost::log::sources;
-namespace sinks = boost::log::sinks;
-namespace keywords = boost::log::keywords;
+#include "main/binlog.h"
 
-using namespace logging::trivial;
+using binlog::Severity;
 
 
-void init_logging()
+static void init_logging()
 {
-    logging::register_simple_formatter_factory<logging::trivial::severity_level, char>("Severity");
-
-    logging::add_file_log
-    (
-        keywords::file_name = "/opt/siming/var/log/sample_%N.log",                    /*< file name pattern >*/
-        keywords::rotation_size = 10 * 1024 * 1024,                                   /*< rotate files every 10 MiB... >*/
-        keywords::time_based_rotation = sinks::file::rotation_at_time_point(0, 0, 0), /*< ...or at midnight >*/
-        keywords::format = "[%TimeStamp%] [%Severity%] %Message%",                    /*< log record format >*/
-        keywords::auto_flush = true
-    );
+    binlog::Config config;
+
+    // Formatting and writing happen on the logger thread, the worker only
+    // records binary events
+    config.file_pattern = "/opt/siming/var/log/sample_%N.log";
+    config.rotation_size = 10 * 1024 * 1024;
+    config.rotate_daily = true;
+    config.console = true;
+    config.min_severity = Severity::info;
+
+    if (!binlog::start(config)) {
+        cerr << "Can not open " << config.file_pattern << ", logging to the console only\n";
+        config.file_pattern.clear();
+        binlog::start(config);
+    }
+}
 
-    logging::core::get()->set_filter
-    (
-        logging::trivial::severity >= logging::trivial::info
-    );
+/*
+ * The device state outlives the process in its NVM context file, see --nvm.
+ * A worker restarted after a crash restores its session from it instead of
+ * joining again.
+ */
+
+static bool nvm_changed = false;
+
+static uint8_t GetBatteryLevel(void) { return 254; }
+static float GetTemperatureLevel(void) { return 25.0f; }
+static void OnNvmContextChange(LoRaMacNvmCtxModule_t module) { nvm_changed = true; }
+static void OnMacProcessNotify(void) { }
+static void OnMacMcpsConfirm(McpsConfirm_t* mcpsConfirm) { }
+static void OnMacMcpsIndication(McpsIndication_t* mcpsIndication) { }
+static void OnMacMlmeConfirm(MlmeConfirm_t* mlmeConfirm) { }
+static void OnMacMlmeIndication(MlmeIndication_t* mlmeIndication) { }
+
+static LoRaMacPrimitives_t mac_primitives = {
+    OnMacMcpsConfirm,
+    OnMacMcpsIndication,
+    OnMacMlmeConfirm,
+    OnMacMlmeIndication,
+};
+
+static LoRaMacCallback_t mac_callbacks = {
+    GetBatteryLevel,
+    GetTemperatureLevel,
+    OnNvmContextChange,
+    OnMacProcessNotify,
+};
+
+// Writes the snapshot of the device next to the file and renames it over,
+// a crash while storing leaves the previous contexts
+static bool nvm_store(const string& path)
+{
+    std::vector<uint8_t> image(LoRaMacSnapshotGetSize());
+    string tmp = path + ".tmp";
 
-    logging::add_console_log(std::cout, 
-                             boost::log::keywords::format = ">> [%TimeStamp%] [%Severity%] %Message%",
-                             boost::log::keywords::auto_flush = true);
+    if (LoRaMacSnapshotSave(image.data(), image.size()) != LORAMAC_SNAPSHOT_SUCCESS) {
+        return false;
+    }
 
+    FILE* file = fopen(tmp.c_str(), "wb");
+    if (file == NULL) {
+        return false;
+    }
+    bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+    written = (fclose(file) == 0) && written;
 
-    logging::add_common_attributes();
+    nvm_changed = false;
+    return written && rename(tmp.c_str(), path.c_str()) == 0;
 }
 
+// Restores the device from its NVM context file
+static bool nvm_restore(const string& path)
+{
+    std::vector<uint8_t> image(LoRaMacSnapshotGetSize());
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    size_t size = fread(image.data(), 1, image.size(), file);
+    fclose(file);
+
+    if (LoRaMacStop() != LORAMAC_STATUS_OK) {
+        return false;
+    }
+    bool restored = LoRaMacSnapshotRestore(image.data(), size) == LORAMAC_SNAPSHOT_SUCCESS;
+    LoRaMacStart();
+    return restored;
+}
 
-static void worker_task (const char* endpoint, const char *deveui, zsock_t *pipe, void *args)
+// Requests are [client, correlation, deadline, "", request], the deadline in
+// ms since the epoch. The broker and the worker share the host clock.
+static bool request_expired(zmsg_t *msg)
 {
-    // Signal ready
-    zsock_signal(pipe, 0);
+    zframe_t *deadline = NULL;
+    struct timespec now;
+
+    // The deadline is the last frame before the empty delimiter
+    for (zframe_t *frame = zmsg_first(msg); frame != NULL && zframe_size(frame) > 0; frame = zmsg_next(msg)) {
+        deadline = frame;
+    }
+    if (deadline == NULL) {
+        return false;
+    }
+
+    char *text = zframe_strdup(deadline);
+    uint64_t deadlineMs = strtoull(text, NULL, 10);
+    free(text);
 
-    zsock_t *worker = zsock_new_req (endpoint);
-    zpoller_t *poller = zpoller_new (pipe, worker, NULL);
-    zpoller_set_nonstop(poller, true);
+    clock_gettime(CLOCK_REALTIME, &now);
+    return deadlineMs != 0 && (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000 >= deadlineMs;
+}
+
+static void worker_task (const char* endpoint, const char *deveui, const string& nvm)
+{
+    uint64_t expired = 0;
+
+    // The broker routes the requests of the device by its EUI
+    zsock_t *worker = zsock_new (ZMQ_REQ);
+    zsock_set_identity(worker, deveui);
+    if (zsock_connect(worker, "%s", endpoint) != 0) {
+        BINLOG(Severity::error, "Can not connect to {}", endpoint);
+        zsock_destroy(&worker);
+        return;
+    }
 
 #define WORKER_READY "\001"
+#define WORKER_EXPIRED "\002"
     //  Tell broker we're ready for work
     zframe_t *frame = zframe_new (WORKER_READY, 1);
     zframe_send (&frame, worker, 0);
 
     //  Process messages as they arrive
     while (true) {
-        zsock_t *ready = zpoller_wait (poller, -1);
-        if (ready == NULL) continue;   // Interrupted
-        else if (ready == pipe) break; // Shutdown
-        else assert(ready == worker);  // Data Available
-
         zmsg_t *msg = zmsg_recv (worker);
         if (!msg)
             break;              //  Interrupted
+
+        // Nobody waits for the reply anymore, answer to stay in lock step
+        // with the broker and move on. The answer is [EXPIRED, client,
+        // correlation, deadline], the command in a frame of its own.
+        if (request_expired(msg)) {
+            BINLOG(Severity::warning, "Dropped request past its deadline, {} so far", ++expired);
+            for (int i = 0; i < 2; i++) {
+                zframe_t *last = zmsg_last (msg);
+                zmsg_remove (msg, last);
+                zframe_destroy (&last);
+            }
+            zmsg_pushmem (msg, WORKER_EXPIRED, 1);
+            zmsg_send (&msg, worker);
+            continue;
+        }
+
         zframe_print (zmsg_last (msg), "Worker: ");
         zframe_reset (zmsg_last (msg), "OK", 2);
         zmsg_send (&msg, worker);
+
+        if (nvm_changed && !nvm.empty() && !nvm_store(nvm)) {
+            BINLOG(Severity::error, "Can not store the NVM contexts to {}", nvm.c_str());
+        }
     }
 
-    zpoller_destroy(&poller);
     zsock_destroy(&worker);
 }
 
 
 static void start_mac_service(const char* endpoint, const char*deveui) {
-    src::severity_logger< severity_level > lg;
-
-    BOOST_LOG_SEV(lg, info) << "start_mac_services backend=" << ipc_address << " , identity=" << deveui;
+    BINLOG(Severity::info, "start_mac_services backend={} , identity={}", endpoint, deveui);
     // zmq_setsockopt(socket, ZMQ_IDENTITY, deveui, strlen(deveui));
 }
 
@@ -104,6 +231,8 @@ static void start_mac_service(const char* endpoint, const char*deveui) {
 int main(int ac, char* av[])
 {
     const char* endpoint = NULL;
+    // Region of the simulated device, selected at run time
+    LoRaMacRegion_t region = LORAMAC_REGION_US915;
     po::variables_map vm;        
 
     init_logging();
@@ -112,7 +241,12 @@ int main(int ac, char* av[])
         po::options_description desc("Options");
         desc.add_options()
             ("help, h", "Help screen")
-            ("deveui", po::value<string>(), "Device EUI ");
+            ("deveui", po::value<string>(), "Device EUI ")
+            ("seed", po::value<uint64_t>()->default_value(1), "Simulation master seed")
+            ("region", po::value<string>()->default_value("US915"), "LoRaWAN region of the device")
+            ("trace", po::value<string>(), "Record the frames of the device to this packet trace")
+            ("mac-trace", po::value<string>(), "Write the MAC hot path spans to this Chrome trace, needs -DLORAMAC_TRACE")
+            ("nvm", po::value<string>()->default_value(""), "Restore the device from, and store it to, this NVM context file");
 
         po::store(po::parse_command_line(ac, av, desc), vm);
         po::notify(vm);    
@@ -130,6 +264,11 @@ int main(int ac, char* av[])
         cerr << "Exception of unknown type!\n";
     } 
 
+    if (!parse_region(vm["region"].as<string>(), &region)) {
+        cerr << "Region " << vm["region"].as<string>() << " is not supported\n";
+        return 1;
+    }
+
     if((endpoint = std::getenv(ENV_MAC_SERVICE_RPC_ADDR)) != NULL){
         std::cout <<  ENV_MAC_SERVICE_RPC_ADDR << " set to: " << endpoint << '\n';
     }
@@ -138,15 +277,58 @@ int main(int ac, char* av[])
         return 1;
     } 
 
+    sim::TraceWriter trace;
+
     if (vm.count("deveui")) {
+        uint64_t devEui = std::stoull(vm["deveui"].as<string>(), nullptr, 16);
+
+        // Every device draws its own sequence from the run master seed
+        RadioSetRandomSeed(vm["seed"].as<uint64_t>(), devEui);
+
+        if (vm.count("trace")) {
+            if (!trace.open(vm["trace"].as<string>())) {
+                cerr << "Can not create " << vm["trace"].as<string>() << "\n";
+                return 1;
+            }
+            RadioAttachTrace(&trace, devEui);
+        }
+
+        if (vm.count("mac-trace") && !LoRaMacTraceStart(vm["mac-trace"].as<string>().c_str())) {
+            cerr << "Can not trace to " << vm["mac-trace"].as<string>() << ", is the MAC built with -DLORAMAC_TRACE?\n";
+            return 1;
+        }
 
         // start_mac_service(endpoint, vm["deveui"].as<string>().c_str());
-        worker_task(endpoint, vm["deveui"].as<string>().c_str());
+        // The MAC runs the region parsed from --region
+        if (LoRaMacInitialization(&mac_primitives, &mac_callbacks, region) != LORAMAC_STATUS_OK) {
+            cerr << "Can not initialize the MAC for region " << vm["region"].as<string>() << "\n";
+            return 1;
+        }
+        LoRaMacStart();
+        std::cout << "Region set to: " << vm["region"].as<string>() << " (" << region << ")\n";
+
+        const string& nvm = vm["nvm"].as<string>();
+        if (!nvm.empty()) {
+            if (nvm_restore(nvm)) {
+                BINLOG(Severity::info, "Restored the device from {}", nvm.c_str());
+            } else if (!nvm_store(nvm)) {
+                cerr << "Can not store the NVM contexts to " << nvm << "\n";
+                return 1;
+            }
+        }
+
+        worker_task(endpoint, vm["deveui"].as<string>().c_str(), nvm);
     }
     else{
         cerr << "Device EUI is not set\n";
         return 1;
     }
 
+    RadioAttachTrace(NULL, 0);
+    trace.close();
+    LoRaMacTraceStop();
+
+    // Events still in the rings are only written out by the logger thread
+    binlog::stop();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <boost/program_options.hpp>
+
+#include "radio.h"
+#include "rtc.h"
+#include "timer.h"
+#include "LmHandler.h"
+#include "LoRaMacCrypto.h"
+#include "LoRaMacSnapshot.h"
+#include "LoRaMacTrace.h"
+#include "sim/fleet_image.h"
+#include "sim/replay.h"
+#include "sim/trace.h"
+
+namespace po = boost::program_options;
+
+using namespace std;
+
+namespace {
+
+const char* const kEventNames[] = { "join", "send", "tx_done", "tx_timeout", "rx_done", "rx_timeout" };
+
+bool verbose = false;
+
+uint8_t AppDataBuffer[242];
+
+/*
+ * The stack callbacks only print what happens. The values handed to the MAC
+ * are constants, a recorded run answers the same.
+ */
+
+uint8_t GetBatteryLevel(void) { return 254; }
+float GetTemperature(void) { return 25.0f; }
+uint32_t GetRandomSeed(void) { return 0; }
+void OnMacProcess(void) { }
+void OnNvmContextChange(LmHandlerNvmContextStates_t state) { }
+void OnNetworkParametersChange(CommissioningParams_t* params) { }
+void OnClassChange(DeviceClass_t deviceClass) { }
+void OnBeaconStatusChange(LoRaMacHandlerBeaconParams_t* params) { }
+void OnSysTimeUpdate(bool isSynchronized, int32_t timeCorrection) { }
+
+void OnMacMcpsRequest(LoRaMacStatus_t status, McpsReq_t* mcpsReq, TimerTime_t nextTxDelay)
+{
+    if (verbose && status != LORAMAC_STATUS_OK) {
+        printf("%12u   mcps request status %d, next tx in %u\n", TimerGetCurrentTime(), status, nextTxDelay);
+    }
+}
+
+void OnMacMlmeRequest(LoRaMacStatus_t status, MlmeReq_t* mlmeReq, TimerTime_t nextTxDelay)
+{
+    if (verbose && status != LORAMAC_STATUS_OK) {
+        printf("%12u   mlme request %d status %d, next tx in %u\n", TimerGetCurrentTime(), mlmeReq->Type, status,
+               nextTxDelay);
+    }
+}
+
+void OnJoinRequest(LmHandlerJoinParams_t* params)
+{
+    if (verbose) {
+        printf("%12u   join %s, DR%d\n", TimerGetCurrentTime(),
+               params->Status == LORAMAC_HANDLER_SUCCESS ? "accepted" : "failed", params->Datarate);
+    }
+}
+
+void OnTxData(LmHandlerTxParams_t* params)
+{
+    if (verbose && params->IsMcpsConfirm) {
+        printf("%12u   tx FCnt %u status %d DR%d ack %u\n", TimerGetCurrentTime(), params->UplinkCounter,
+               params->Status, params->Datarate, params->AckReceived);
+    }
+}
+
+void OnRxData(LmHandlerAppData_t* appData, LmHandlerRxParams_t* params)
+{
+    if (verbose && params->IsMcpsIndication) {
+        printf("%12u   rx FCnt %u status %d slot %d port %u size %u\n", TimerGetCurrentTime(),
+               params->DownlinkCounter, params->Status, params->RxSlot, appData->Port, appData->BufferSize);
+    }
+}
+
+LmHandlerCallbacks_t callbacks = {
+    GetBatteryLevel,
+    GetTemperature,
+    GetRandomSeed,
+    OnMacProcess,
+    OnNvmContextChange,
+    OnNetworkParametersChange,
+    OnMacMcpsRequest,
+    OnMacMlmeRequest,
+    OnJoinRequest,
+    OnTxData,
+    OnRxData,
+    OnClassChange,
+    OnBeaconStatusChange,
+    OnSysTimeUpdate,
+};
+
+/*!
+ * \brief Sets the virtual clock. TimerGetCurrentTime reads the RTC counter
+ *        as is, see RtcTick2Ms.
+ */
+void set_clock(sim::Time time)
+{
+    RtcSetVirtualTime(static_cast<uint32_t>(time), RtcGetTimerContext());
+}
+
+/*!
+ * \brief Fires the timers due up to time, skipping the idle time between them
+ *
+ * \retval Number of timers fired
+ */
+uint64_t fast_forward(sim::Time time)
+{
+    uint64_t fired = 0;
+
+    while (true) {
+        TimerTime_t deadline = TimerGetNextDeadline();
+
+        if (deadline == TIMERTIME_T_MAX || deadline > time) {
+            break;
+        }
+        if (deadline > TimerGetCurrentTime()) {
+            set_clock(deadline);
+        }
+        TimerIrqHandler();
+        LmHandlerProcess();
+        fired++;
+    }
+    if (time > TimerGetCurrentTime()) {
+        set_clock(time);
+    }
+    return fired;
+}
+
+void replay_event(const sim::ReplayEvent& event, const uint8_t* payload)
+{
+    switch (event.type) {
+    case sim::ReplayEventType::join:
+        LmHandlerJoin();
+        break;
+    case sim::ReplayEventType::send: {
+        LmHandlerAppData_t appData = { event.port, event.size, AppDataBuffer };
+
+        std::copy(payload, payload + event.size, AppDataBuffer);
+        LmHandlerSend(&appData, event.confirmed ? LORAMAC_HANDLER_CONFIRMED_MSG : LORAMAC_HANDLER_UNCONFIRMED_MSG);
+        break;
+    }
+    default:
+        RadioReplay(event, payload);
+        break;
+    }
+    LmHandlerProcess();
+}
+
+void print_state(uint64_t events, uint64_t timers)
+{
+    MibRequestConfirm_t mibReq;
+    uint32_t fCntUp = 0;
+
+    printf("time %u, %llu events, %llu timers\n", TimerGetCurrentTime(),
+           static_cast<unsigned long long>(events), static_cast<unsigned long long>(timers));
+
+    mibReq.Type = MIB_DEV_ADDR;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    LoRaMacCryptoGetFCntUp(&fCntUp);
+    printf("joined %s, DevAddr %08x, next FCntUp %u\n",
+           LmHandlerJoinStatus() == LORAMAC_HANDLER_SET ? "yes" : "no", mibReq.Param.DevAddr, fCntUp);
+
+    mibReq.Type = MIB_CHANNELS_TX_POWER;
+    LoRaMacMibGetRequestConfirm(&mibReq);
+    printf("class %c, DR%d, tx power %d, busy %s, next timer %u\n", "ABC"[LmHandlerGetCurrentClass()],
+           LmHandlerGetCurrentDatarate(), mibReq.Param.ChannelsTxPower, LoRaMacIsBusy() ? "yes" : "no",
+           TimerGetNextDeadline());
+}
+
+} // namespace
+
+int main(int ac, char* av[])
+{
+    po::variables_map vm;
+    string path;
+    sim::Time until = UINT32_MAX;
+
+    try {
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h", "Help screen")
+            ("log", po::value<string>(&path), "Input log of the device")
+            ("until", po::value<sim::Time>(&until), "Stop at this virtual time and print the MAC state")
+            ("image", po::value<string>(), "Start from the device snapshot of this fleet image")
+            ("trace", po::value<string>(), "Record the frames sent and received to this packet trace")
+            ("record", po::value<string>(), "Log the inputs again, a deterministic replay logs the same")
+            ("mac-trace", po::value<string>(), "Write the MAC hot path spans to this Chrome trace, needs -DLORAMAC_TRACE")
+            ("verbose,v", "Print the inputs and the MAC events");
+
+        po::positional_options_description positional;
+        positional.add("log", 1);
+
+        po::store(po::command_line_parser(ac, av).options(desc).positional(positional).run(), vm);
+        po::notify(vm);
+
+        if (vm.count("help") || path.empty()) {
+            cout << "Usage: replay [options] log\n" << desc << "\n";
+            return 1;
+        }
+    }
+    catch(exception& e) {
+        cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+    verbose = vm.count("verbose") > 0;
+
+    sim::ReplayReader reader;
+    if (!reader.open(path)) {
+        cerr << path << ": not an input log\n";
+        return 2;
+    }
+    const sim::ReplaySetup& setup = reader.setup();
+
+    // Same stack setup as the recorded run
+    LmHandlerParams_t params = {};
+    params.Region = static_cast<LoRaMacRegion_t>(setup.region);
+    params.AdrEnable = setup.adr;
+    params.IsTxConfirmed = LORAMAC_HANDLER_UNCONFIRMED_MSG;
+    params.TxDatarate = setup.datarate;
+    params.PublicNetworkEnable = setup.public_network;
+    params.DutyCycleEnabled = setup.duty_cycle;
+    params.DataBufferMaxSize = sizeof(AppDataBuffer);
+    params.DataBuffer = AppDataBuffer;
+
+    if (!RegionIsActive(params.Region)) {
+        cerr << "Region " << static_cast<int>(setup.region) << " is not supported\n";
+        return 1;
+    }
+
+    RadioSetRandomSeed(setup.seed, setup.dev_eui);
+    RtcSetVirtualTime(static_cast<uint32_t>(setup.start), static_cast<uint32_t>(setup.start));
+    if (LmHandlerInit(&callbacks, &params) != LORAMAC_HANDLER_SUCCESS) {
+        cerr << "Can not initialize the stack\n";
+        return 1;
+    }
+
+    // Skip the inputs the snapshot already went through
+    sim::Time from = 0;
+    sim::FleetImage image;
+    if (vm.count("image")) {
+        uint32_t size = 0;
+        const uint8_t* snapshot = nullptr;
+
+        if (image.open(vm["image"].as<string>())) {
+            snapshot = image.image(setup.dev_eui, &size);
+        }
+        LoRaMacStop();
+        if (snapshot == nullptr || LoRaMacSnapshotRestore(snapshot, size) != LORAMAC_SNAPSHOT_SUCCESS) {
+            cerr << "No usable snapshot of " << hex << setup.dev_eui << " in " << vm["image"].as<string>() << "\n";
+            return 1;
+        }
+        LoRaMacStart();
+        from = image.clock();
+    }
+
+    sim::TraceWriter trace;
+    if (vm.count("trace")) {
+        if (!trace.open(vm["trace"].as<string>())) {
+            cerr << "Can not create " << vm["trace"].as<string>() << "\n";
+            return 1;
+        }
+        RadioAttachTrace(&trace, setup.dev_eui);
+    }
+
+    sim::ReplayRecorder recorder;
+    if (vm.count("record")) {
+        if (!recorder.open(vm["record"].as<string>(), setup)) {
+            cerr << "Can not create " << vm["record"].as<string>() << "\n";
+            return 1;
+        }
+        RadioAttachRecorder(&recorder);
+    }
+
+    if (vm.count("mac-trace") && !LoRaMacTraceStart(vm["mac-trace"].as<string>().c_str())) {
+        cerr << "Can not trace to " << vm["mac-trace"].as<string>() << ", is the MAC built with -DLORAMAC_TRACE?\n";
+        return 1;
+    }
+
+    sim::ReplayEvent event;
+    const uint8_t* payload;
+    uint64_t events = 0;
+    uint64_t timers = 0;
+
+    while (reader.next(&event, &payload)) {
+        if (event.time < from) {
+            continue;
+        }
+        if (event.time > until) {
+            break;
+        }
+
+        timers += fast_forward(event.time);
+        if (verbose) {
+            printf("%12llu %s size %u\n", static_cast<unsigned long long>(event.time),
+                   kEventNames[static_cast<uint8_t>(event.type)], event.size);
+        }
+        // The radio logs its own outcomes again, the application inputs are
+        // logged here like a recorded application does
+        if (event.type == sim::ReplayEventType::join || event.type == sim::ReplayEventType::send) {
+            recorder.record(event.time, event.type, payload, event.size, event.port, event.confirmed);
+        }
+        replay_event(event, payload);
+        events++;
+    }
+    if (until != UINT32_MAX) {
+        timers += fast_forward(until);
+    }
+
+    print_state(events, timers);
+
+    RadioAttachRecorder(NULL);
+    RadioAttachTrace(NULL, 0);
+    recorder.close();
+    trace.close();
+    LoRaMacTraceStop();
+    return 0;
+}
@@ -12,6 +12,12 @@
 #include "assert.h"
 #include "radio.h"
 #include "stdlib.h"
+#include "string.h"
+#include "timer.h"
+#include "utilities.h"
+#include "sim/medium.h"
+#include "sim/trace.h"
+#include "sim/replay.h"
 
 /*!
  * \brief Represents the possible spreading factor values in LoRa packet types
@@ -336,6 +342,21 @@ uint32_t RadioGetWakeupTime( void );
  */
 void RadioIrqProcess( void );
 
+/*!
+ * \brief Sets an address filter slot of the simulated radio
+ *
+ * \param [IN] slot    Filter slot [0: device address, 1..4: multicast groups]
+ * \param [IN] address Address to accept
+ * \param [IN] enable  Enables or disables the slot
+ */
+void RadioSetAddressFilter( uint8_t slot, uint32_t address, bool enable );
+
+/*!
+ * \brief Sets whether the simulated radio accepts join-accepts
+ *
+ * \param [IN] enable  true while a join is pending
+ */
+void RadioSetJoinFilter( bool enable );
 
 /*!
  * Radio driver structure initialization
@@ -369,7 +390,10 @@ const struct Radio_s Radio =
     RadioIrqProcess,
     // Available on SX126x only
     NULL,
-    NULL
+    NULL,
+    // Available on the simulated radio only
+    RadioSetAddressFilter,
+    RadioSetJoinFilter
 };
 
 /*
@@ -397,6 +421,26 @@ void RadioOnTxTimeoutIrq( void* context );
  */
 void RadioOnRxTimeoutIrq( void* context );
 
+/*!
+ * \brief Signals the end of a transmission to the MAC
+ */
+static void RadioOnTxDone( void );
+
+/*!
+ * \brief Hands a received frame to the MAC
+ */
+static void RadioOnRxDone( const sim::Frame& frame );
+
+/*!
+ * \brief Logs a radio outcome when an input log is attached
+ */
+static void RadioRecord( sim::ReplayEventType type, const uint8_t* payload, uint8_t size, int16_t rssi, int8_t snr );
+
+/*!
+ * \brief Gets the LoRa bandwidth in Hz
+ */
+static uint32_t RadioGetLoRaBandwidthInHz( RadioLoRaBandwidths_t bw );
+
 /*
  * Private global variables
  */
@@ -407,6 +451,54 @@ void RadioOnRxTimeoutIrq( void* context );
  */
 static RadioEvents_t* RadioEvents;
 
+/*!
+ * Radio entropy source, see RadioSetRandomSeed
+ */
+static RandCtx_t RadioRandCtx = RAND_CTX_INIT;
+
+/*!
+ * Shared radio medium, see RadioAttachMedium
+ */
+static sim::Medium* RadioMedium = NULL;
+static sim::ListenerId RadioListener = 0;
+
+/*!
+ * Join-accept filter, see RadioSetJoinFilter. The DevEUI is taken from the
+ * last join-request sent, the medium only hands over the join-accepts
+ * answering it.
+ */
+static bool RadioJoinPending = false;
+static uint64_t RadioJoinDevEui = 0;
+
+/*!
+ * Packet trace, see RadioAttachTrace
+ */
+static sim::TraceWriter* RadioTrace = NULL;
+static uint64_t RadioTraceDevEui = 0;
+
+/*!
+ * Input log, see RadioAttachRecorder
+ */
+static sim::ReplayRecorder* RadioRecorder = NULL;
+
+/*!
+ * Current channel and modulations
+ */
+static uint32_t RadioFrequency = 0;
+static uint8_t RadioRxModulation = 0;
+static uint8_t RadioTxModulation = 0;
+
+/*!
+ * Time the radio searches for a preamble before timing out, from the
+ * symbol timeout of the reception window [ms]
+ */
+static uint32_t RadioRxWindow = 0;
+
+/*!
+ * Ends a reception window of the medium that received no frame
+ */
+static TimerEvent_t RadioRxTimeoutTimer;
+
 /*
  * Public global variables
  */
@@ -427,6 +519,7 @@ void RadioInit( RadioEvents_t *events )
     TimerInit( &TxTimeoutTimer, RadioOnTxTimeoutIrq );
     TimerInit( &RxTimeoutTimer, RadioOnRxTimeoutIrq );
     #endif
+    TimerInit( &RadioRxTimeoutTimer, RadioOnRxTimeoutIrq );
 
     IrqFired = false;
 }
@@ -448,13 +541,40 @@ bool RadioIsChannelFree( uint32_t freq, uint32_t rxBandwidth, int16_t rssiThresh
 
 uint32_t RadioRandom( void )
 {
-#warning RadioRandom not implemented
-    uint32_t rnd = 0;
-    return rnd;
+    return RandCtxNext( &RadioRandCtx );
+}
+
+void RadioSetRandomSeed( uint64_t masterSeed, uint64_t deviceId )
+{
+    RandCtxSeed( &RadioRandCtx, RandDeriveSeed( masterSeed, deviceId ) );
+}
+
+void RadioGetSnapshot( RadioSnapshot_t* snapshot )
+{
+    snapshot->Frequency = RadioFrequency;
+    snapshot->RxModulation = RadioRxModulation;
+    snapshot->TxModulation = RadioTxModulation;
+    snapshot->MaxPayloadLength = MaxPayloadLength;
+    snapshot->RxContinuous = RxContinuous;
+    snapshot->TxTimeout = TxTimeout;
+    memcpy1( ( uint8_t* )snapshot->RandState, ( uint8_t* )RadioRandCtx.State, sizeof( snapshot->RandState ) );
+}
+
+void RadioRestoreSnapshot( const RadioSnapshot_t* snapshot )
+{
+    RadioStandby( );
+    RadioFrequency = snapshot->Frequency;
+    RadioRxModulation = snapshot->RxModulation;
+    RadioTxModulation = snapshot->TxModulation;
+    MaxPayloadLength = snapshot->MaxPayloadLength;
+    RxContinuous = snapshot->RxContinuous;
+    TxTimeout = snapshot->TxTimeout;
+    memcpy1( ( uint8_t* )RadioRandCtx.State, ( uint8_t* )snapshot->RandState, sizeof( RadioRandCtx.State ) );
 }
 
 void RadioSetChannel( uint32_t freq )
 {
+    RadioFrequency = freq;
 }
 
 void RadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
@@ -467,8 +587,12 @@ void RadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
 {
     assert(modem == MODEM_LORA);
 
-#if 0
     RxContinuous = rxContinuous;
+    RadioRxModulation = sim::modulation( datarate, bandwidth );
+    // LoRa symbol time is 2^SF / BW
+    uint32_t bandwidthInHz = RadioGetLoRaBandwidthInHz( Bandwidths[bandwidth] );
+    RadioRxWindow = ( ( uint32_t )symbTimeout * ( 1u << datarate ) * 1000 + bandwidthInHz - 1 ) / bandwidthInHz;
+#if 0
     SX126x.ModulationParams.Params.LoRa.SpreadingFactor = ( RadioLoRaSpreadingFactors_t )datarate;
     SX126x.ModulationParams.Params.LoRa.Bandwidth = Bandwidths[bandwidth];
     SX126x.PacketParams.Params.LoRa.PayloadLength = MaxPayloadLength;
@@ -484,6 +608,7 @@ void RadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
 {
     assert(modem == MODEM_LORA);
 
+    RadioTxModulation = sim::modulation( datarate, bandwidth );
 #if 0
     SX126x.ModulationParams.Params.LoRa.SpreadingFactor = ( RadioLoRaSpreadingFactors_t ) datarate;
     SX126x.ModulationParams.Params.LoRa.Bandwidth =  Bandwidths[bandwidth];
@@ -494,6 +619,34 @@ void RadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
 
 void RadioSend( uint8_t *buffer, uint8_t size )
 {
+    sim::Frame frame = { RadioFrequency, RadioTxModulation, TimerGetCurrentTime( ), buffer, size, 0, 0, 0 };
+
+    // MHDR | JoinEUI | DevEUI | DevNonce | MIC
+    if( ( size == 23 ) && ( ( buffer[0] >> 5 ) == 0 ) )
+    {
+        uint64_t devEui = 0;
+
+        for( int8_t i = 7; i >= 0; i-- )
+        {
+            devEui = ( devEui << 8 ) | buffer[9 + i];
+        }
+        if( devEui != RadioJoinDevEui )
+        {
+            RadioJoinDevEui = devEui;
+            RadioSetJoinFilter( RadioJoinPending );
+        }
+    }
+    if( RadioTrace != NULL )
+    {
+        RadioTrace->record( sim::TraceDirection::uplink, RadioTraceDevEui, frame );
+    }
+    if( RadioMedium != NULL )
+    {
+        RadioMedium->transmit( frame );
+        // The frame is on the air as soon as it is handed to the medium
+        RadioOnTxDone( );
+        return;
+    }
 #if 0
     SX126x.PacketParams.Params.LoRa.PayloadLength = size;
     SX126xSendPayload( buffer, size, 0 );
@@ -515,6 +668,7 @@ bool RadioCheckRfFrequency( uint32_t frequency )
 
 void RadioOnTxTimeoutIrq( void* context )
 {
+    RadioRecord( sim::ReplayEventType::tx_timeout, NULL, 0, 0, 0 );
     if( ( RadioEvents != NULL ) && ( RadioEvents->TxTimeout != NULL ) )
     {
         RadioEvents->TxTimeout( );
@@ -523,6 +677,11 @@ void RadioOnTxTimeoutIrq( void* context )
 
 void RadioOnRxTimeoutIrq( void* context )
 {
+    if( RadioMedium != NULL )
+    {
+        RadioMedium->close_rx_window( RadioListener );
+    }
+    RadioRecord( sim::ReplayEventType::rx_timeout, NULL, 0, 0, 0 );
     if( ( RadioEvents != NULL ) && ( RadioEvents->RxTimeout != NULL ) )
     {
         RadioEvents->RxTimeout( );
@@ -645,13 +804,153 @@ void RadioSetPublicNetwork( bool enable )
 
 uint32_t RadioGetWakeupTime( void )
 {
-    assert(false);
+    // The simulated radio leaves sleep instantly
+    return 0;
 }
 
 
-void RadioSleep( void ) { }
-void RadioStandby( void ) { }
-void RadioRx( uint32_t timeout ) { }
+void RadioSleep( void )
+{
+    if( RadioMedium != NULL )
+    {
+        TimerStop( &RadioRxTimeoutTimer );
+        RadioMedium->close_rx_window( RadioListener );
+    }
+}
+
+void RadioStandby( void )
+{
+    if( RadioMedium != NULL )
+    {
+        TimerStop( &RadioRxTimeoutTimer );
+        RadioMedium->close_rx_window( RadioListener );
+    }
+}
+
+void RadioRx( uint32_t timeout )
+{
+    if( RadioMedium != NULL )
+    {
+        sim::Time deadline = sim::kForever;
+
+        if( ( timeout != 0 ) && ( RxContinuous == false ) )
+        {
+            // Without a preamble within the symbol timeout the window ends
+            // with an RxTimeout, as on the real radio
+            uint32_t window = ( RadioRxWindow != 0 ) ? MIN( RadioRxWindow, timeout ) : timeout;
+
+            deadline = TimerGetCurrentTime( ) + window;
+            TimerSetValue( &RadioRxTimeoutTimer, window );
+            TimerStart( &RadioRxTimeoutTimer );
+        }
+        RadioMedium->open_rx_window( RadioListener, RadioFrequency, RadioRxModulation, deadline );
+    }
+}
+
+void RadioSetAddressFilter( uint8_t slot, uint32_t address, bool enable )
+{
+    if( RadioMedium != NULL )
+    {
+        RadioMedium->set_address( RadioListener, slot, address, enable );
+    }
+}
+
+void RadioSetJoinFilter( bool enable )
+{
+    RadioJoinPending = enable;
+    if( RadioMedium != NULL )
+    {
+        RadioMedium->set_join_pending( RadioListener, enable, RadioJoinDevEui );
+    }
+}
+
+static void RadioRecord( sim::ReplayEventType type, const uint8_t* payload, uint8_t size, int16_t rssi, int8_t snr )
+{
+    if( RadioRecorder != NULL )
+    {
+        RadioRecorder->record( TimerGetCurrentTime( ), type, payload, size, 0, false, rssi, snr );
+    }
+}
+
+static void RadioOnTxDone( void )
+{
+    RadioRecord( sim::ReplayEventType::tx_done, NULL, 0, 0, 0 );
+    if( ( RadioEvents != NULL ) && ( RadioEvents->TxDone != NULL ) )
+    {
+        RadioEvents->TxDone( );
+    }
+}
+
+static void RadioOnRxDone( const sim::Frame& frame )
+{
+    // Recorded as handed to OnRadioRxDone, the only receive path of the MAC
+    if( RadioTrace != NULL )
+    {
+        RadioTrace->record( sim::TraceDirection::downlink, RadioTraceDevEui, frame );
+    }
+    TimerStop( &RadioRxTimeoutTimer );
+    RadioRecord( sim::ReplayEventType::rx_done, frame.payload, frame.size, frame.rssi, frame.snr );
+    memcpy1( RadioRxPayload, frame.payload, frame.size );
+    if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
+    {
+        RadioEvents->RxDone( RadioRxPayload, frame.size, frame.rssi, frame.snr );
+    }
+}
+
+static void RadioOnMediumRx( void* context, const sim::Frame& frame )
+{
+    RadioOnRxDone( frame );
+}
+
+void RadioAttachMedium( sim::Medium* medium )
+{
+    if( RadioMedium != NULL )
+    {
+        RadioMedium->close_rx_window( RadioListener );
+    }
+    RadioMedium = medium;
+    if( RadioMedium != NULL )
+    {
+        RadioListener = RadioMedium->add_listener( RadioOnMediumRx, NULL );
+    }
+}
+
+void RadioAttachTrace( sim::TraceWriter* trace, uint64_t devEui )
+{
+    RadioTrace = trace;
+    RadioTraceDevEui = devEui;
+}
+
+void RadioAttachRecorder( sim::ReplayRecorder* recorder )
+{
+    RadioRecorder = recorder;
+}
+
+void RadioReplay( const sim::ReplayEvent& event, const uint8_t* payload )
+{
+    switch( event.type )
+    {
+    case sim::ReplayEventType::tx_done:
+        RadioOnTxDone( );
+        break;
+    case sim::ReplayEventType::tx_timeout:
+        RadioOnTxTimeoutIrq( NULL );
+        break;
+    case sim::ReplayEventType::rx_done:
+    {
+        // Received on the channel the MAC tuned the radio to
+        sim::Frame frame = { RadioFrequency, RadioRxModulation, event.time, payload, event.size, event.rssi, event.snr };
+        RadioOnRxDone( frame );
+        break;
+    }
+    case sim::ReplayEventType::rx_timeout:
+        RadioOnRxTimeoutIrq( NULL );
+        break;
+    default:
+        // Application inputs, see LmHandlerSend
+        break;
+    }
+}
 void RadioStartCad( void ) { }
 void RadioSetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time ) { }
 int16_t RadioRssi( RadioModems_t modem ) { return 0; }
@@ -400,6 +400,26 @@ struct Radio_s
      * \param [in]  sleepTime     Structure describing sleep timeout value
      */
     void ( *SetRxDutyCycle ) ( uint32_t rxTime, uint32_t sleepTime );
+    /*!
+     * \brief Sets an address filter slot. Downlinks are only delivered to
+     *        the radios accepting their DevAddr.
+     *
+     * \remark Available on the simulated radio only.
+     *
+     * \param [IN] slot    Filter slot [0: device address, 1..4: multicast groups]
+     * \param [IN] address Address to accept
+     * \param [IN] enable  Enables or disables the slot
+     */
+    void ( *SetAddressFilter )( uint8_t slot, uint32_t address, bool enable );
+    /*!
+     * \brief Sets whether the radio accepts join-accepts, which are not
+     *        addressed by DevAddr.
+     *
+     * \remark Available on the simulated radio only.
+     *
+     * \param [IN] enable  true while a join is pending
+     */
+    void ( *SetJoinFilter )( bool enable );
 };
 
 /*!
@@ -410,8 +430,88 @@ struct Radio_s
  */
 extern const struct Radio_s Radio;
 
+/*!
+ * \brief Seeds the simulated radio random generator
+ *
+ * \remark Radio.Random is the entropy source of the device. Seeding it from
+ *         the simulation master seed and the device identity makes a run
+ *         reproducible while giving every device its own sequence.
+ *
+ * \param [IN] masterSeed Simulation master seed
+ * \param [IN] deviceId   Device identity, e.g. the device EUI
+ */
+void RadioSetRandomSeed( uint64_t masterSeed, uint64_t deviceId );
+
+/*!
+ * Simulated radio state kept in a device snapshot
+ */
+typedef struct sRadioSnapshot
+{
+    uint32_t Frequency;
+    uint8_t RxModulation;
+    uint8_t TxModulation;
+    uint8_t MaxPayloadLength;
+    bool RxContinuous;
+    uint32_t TxTimeout;
+    /*!
+     * Random generator state, see RadioSetRandomSeed
+     */
+    uint32_t RandState[4];
+}RadioSnapshot_t;
+
+/*!
+ * \brief Saves the simulated radio state
+ *
+ * \param [OUT] snapshot Radio state
+ */
+void RadioGetSnapshot( RadioSnapshot_t* snapshot );
+
+/*!
+ * \brief Restores the simulated radio state. The radio is left in standby.
+ *
+ * \param [IN] snapshot Radio state
+ */
+void RadioRestoreSnapshot( const RadioSnapshot_t* snapshot );
+
 #ifdef __cplusplus
 }
+
+namespace sim { class Medium; class TraceWriter; class ReplayRecorder; struct ReplayEvent; }
+
+/*!
+ * \brief Connects the simulated radio to the shared radio medium. Reception
+ *        windows are registered with the medium, which delivers the
+ *        downlinks addressed to this device. A window that receives
+ *        nothing within its symbol timeout ends with an RxTimeout.
+ *
+ * \param [IN] medium Radio medium, NULL to detach
+ */
+void RadioAttachMedium( sim::Medium* medium );
+
+/*!
+ * \brief Records every frame sent and received by the radio in a packet
+ *        trace.
+ *
+ * \param [IN] trace  Packet trace, NULL to stop recording
+ * \param [IN] devEui Device EUI recorded with the frames
+ */
+void RadioAttachTrace( sim::TraceWriter* trace, uint64_t devEui );
+
+/*!
+ * \brief Logs the radio outcomes ( TxDone, RxDone with the frame, timeouts )
+ *        as replay inputs, see sim/replay.h
+ *
+ * \param [IN] recorder Input log, NULL to stop recording
+ */
+void RadioAttachRecorder( sim::ReplayRecorder* recorder );
+
+/*!
+ * \brief Raises a logged radio outcome, in place of the medium
+ *
+ * \param [IN] event   Logged outcome, application inputs are ignored
+ * \param [IN] payload Received frame of rx_done events
+ */
+void RadioReplay( const sim::ReplayEvent& event, const uint8_t* payload );
 #endif
 
 #endif // __RADIO_H__
@@ -0,0 +1,222 @@
+#include "sim/fleet_image.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+namespace sim {
+
+namespace {
+
+// "FLTI"
+constexpr uint32_t kMagic = 0x49544C46;
+constexpr uint16_t kVersion = 1;
+constexpr size_t kPageSize = 4096;
+
+size_t page_align(size_t size)
+{
+    return (size + kPageSize - 1) & ~(kPageSize - 1);
+}
+
+bool write_all(int fd, const void* data, size_t size, off_t offset)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+} // namespace
+
+struct FleetImage::Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t devices;
+    uint32_t slot_size;
+    uint64_t clock;
+    // Offset of the first slot, after the device index
+    uint64_t slots;
+};
+
+struct FleetImage::Entry {
+    uint64_t dev_eui;
+    // 0 while the slot was not written
+    uint32_t size;
+    uint32_t reserved;
+};
+
+FleetImage::~FleetImage()
+{
+    close();
+}
+
+bool FleetImage::create(const std::string& path, uint32_t devices, uint32_t slotSize, Time clock)
+{
+    Header header = {};
+
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.devices = devices;
+    header.slot_size = static_cast<uint32_t>(page_align(slotSize));
+    header.clock = clock;
+    header.slots = page_align(sizeof(Header) + static_cast<size_t>(devices) * sizeof(Entry));
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Slots are left as holes until written, the index starts zeroed
+    bool ok = (ftruncate(fd, header.slots + static_cast<off_t>(devices) * header.slot_size) == 0) &&
+              write_all(fd, &header, sizeof(header), 0);
+    ::close(fd);
+    return ok;
+}
+
+bool FleetImage::write_slot(const std::string& path, uint32_t slot, uint64_t devEui,
+                            const uint8_t* image, uint32_t size)
+{
+    Header header;
+    Entry entry = {};
+
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = (pread(fd, &header, sizeof(header), 0) == sizeof(header)) && (header.magic == kMagic) &&
+              (header.version == kVersion) && (slot < header.devices) && (size <= header.slot_size);
+    if (ok) {
+        // Data first, a reader never sees an entry pointing to a partial image
+        entry.dev_eui = devEui;
+        entry.size = size;
+        ok = write_all(fd, image, size, header.slots + static_cast<off_t>(slot) * header.slot_size) &&
+             write_all(fd, &entry, sizeof(entry), sizeof(Header) + static_cast<off_t>(slot) * sizeof(Entry));
+    }
+    ::close(fd);
+    return ok;
+}
+
+bool FleetImage::open(const std::string& path)
+{
+    struct stat st;
+
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    // Private mapping: pages are shared with every other scenario until written
+    void* base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    base_ = static_cast<uint8_t*>(base);
+    size_ = st.st_size;
+
+    const Header* h = header();
+    if (h->magic != kMagic || h->version != kVersion ||
+        h->slots < sizeof(Header) + static_cast<uint64_t>(h->devices) * sizeof(Entry) ||
+        h->slots + static_cast<uint64_t>(h->devices) * h->slot_size > size_) {
+        close();
+        return false;
+    }
+
+    by_dev_eui_.reserve(h->devices);
+    for (uint32_t i = 0; i < h->devices; i++) {
+        // An image larger than its slot would run into the next one
+        if (entries()[i].size > h->slot_size) {
+            close();
+            return false;
+        }
+        if (entries()[i].size != 0) {
+            by_dev_eui_[entries()[i].dev_eui] = i;
+        }
+    }
+    return true;
+}
+
+void FleetImage::close()
+{
+    if (base_ != nullptr) {
+        munmap(base_, size_);
+        base_ = nullptr;
+        size_ = 0;
+    }
+    by_dev_eui_.clear();
+}
+
+const FleetImage::Entry* FleetImage::entries() const
+{
+    return reinterpret_cast<const Entry*>(base_ + sizeof(Header));
+}
+
+const FleetImage::Entry* FleetImage::find(uint64_t devEui) const
+{
+    auto it = by_dev_eui_.find(devEui);
+    return (it == by_dev_eui_.end()) ? nullptr : &entries()[it->second];
+}
+
+const uint8_t* FleetImage::image(uint64_t devEui, uint32_t* size) const
+{
+    const Entry* entry = find(devEui);
+    if (entry == nullptr) {
+        return nullptr;
+    }
+
+    *size = entry->size;
+    return base_ + header()->slots + static_cast<size_t>(entry - entries()) * header()->slot_size;
+}
+
+uint8_t* FleetImage::mutable_image(uint64_t devEui, uint32_t* size)
+{
+    return const_cast<uint8_t*>(image(devEui, size));
+}
+
+bool FleetImage::save(const std::string& path) const
+{
+    if (base_ == nullptr) {
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool ok = write_all(fd, base_, size_, 0);
+    ::close(fd);
+    return ok;
+}
+
+Time FleetImage::clock() const
+{
+    return (base_ != nullptr) ? header()->clock : 0;
+}
+
+uint32_t FleetImage::devices() const
+{
+    return (base_ != nullptr) ? static_cast<uint32_t>(by_dev_eui_.size()) : 0;
+}
+
+} // namespace sim
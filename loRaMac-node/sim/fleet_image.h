@@ -0,0 +1,108 @@
+/*!
+ * \file      fleet_image.h
+ *
+ * \brief     Fleet snapshot image
+ *
+ * \details   One file holding the snapshot image (see LoRaMacSnapshot.h) of
+ *            every hosted device, so a warmed-up fleet can be forked into
+ *            many scenario variants instead of joining it again for each.
+ *
+ *            Layout: a header page with the simulation clock and the device
+ *            index, then one page aligned slot per device. The device
+ *            processes capture the fleet by each writing their own slot.
+ *
+ *            A scenario opens the image copy on write: the file is mapped
+ *            private, restoring a device only reads its slot, and changes
+ *            made to a slot (e.g. another ADR setting) copy that slot's
+ *            pages only, for this process only.
+ */
+#ifndef __SIM_FLEET_IMAGE_H__
+#define __SIM_FLEET_IMAGE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "sim/medium.h"
+
+namespace sim {
+
+class FleetImage {
+public:
+    FleetImage() = default;
+    ~FleetImage();
+
+    FleetImage(const FleetImage&) = delete;
+    FleetImage& operator=(const FleetImage&) = delete;
+
+    /*!
+     * \brief Creates an empty image file
+     *
+     * \param [IN] path     Image file
+     * \param [IN] devices  Number of device slots
+     * \param [IN] slotSize Largest device image [bytes], LoRaMacSnapshotGetSize
+     * \param [IN] clock    Simulation time of the snapshot
+     * \retval true on success
+     */
+    static bool create(const std::string& path, uint32_t devices, uint32_t slotSize, Time clock);
+
+    /*!
+     * \brief Writes a device image into its slot of the file. Devices write
+     *        distinct slots and can do it concurrently.
+     *
+     * \retval true on success
+     */
+    static bool write_slot(const std::string& path, uint32_t slot, uint64_t devEui,
+                           const uint8_t* image, uint32_t size);
+
+    /*!
+     * \brief Maps an image copy on write
+     *
+     * \retval true on success, false if the file is not a consistent image
+     */
+    bool open(const std::string& path);
+
+    void close();
+
+    /*!
+     * \brief Gets the image of a device
+     *
+     * \param [IN]  devEui Device EUI
+     * \param [OUT] size   Image size
+     * \retval Device image, nullptr if the device is not in the fleet
+     */
+    const uint8_t* image(uint64_t devEui, uint32_t* size) const;
+
+    /*!
+     * \brief Gets the image of a device for modification, private to this
+     *        process
+     */
+    uint8_t* mutable_image(uint64_t devEui, uint32_t* size);
+
+    /*!
+     * \brief Writes the image, with the changes made here, to a new file
+     *
+     * \retval true on success
+     */
+    bool save(const std::string& path) const;
+
+    Time clock() const;
+    uint32_t devices() const;
+
+private:
+    struct Header;
+    struct Entry;
+
+    const Header* header() const { return reinterpret_cast<const Header*>(base_); }
+    const Entry* entries() const;
+    const Entry* find(uint64_t devEui) const;
+
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    std::unordered_map<uint64_t, uint32_t> by_dev_eui_;
+};
+
+} // namespace sim
+
+#endif // __SIM_FLEET_IMAGE_H__
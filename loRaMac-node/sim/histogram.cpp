@@ -0,0 +1,195 @@
+#include "sim/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim {
+
+namespace {
+
+// Lines printed per halving of the distance to 100%
+constexpr int kTicksPerHalfDistance = 5;
+
+} // namespace
+
+Histogram::Histogram(uint64_t highest, int digits) :
+    highest_(std::max<uint64_t>(highest, 2))
+{
+    digits = std::min(std::max(digits, 1), 5);
+
+    // Sub-buckets resolve 1 part in 10^digits across each bucket
+    uint64_t largest = 2 * static_cast<uint64_t>(std::pow(10.0, digits));
+    uint32_t magnitude = static_cast<uint32_t>(std::ceil(std::log2(static_cast<double>(largest))));
+
+    sub_bucket_half_count_magnitude_ = std::max<uint32_t>(magnitude, 1) - 1;
+    sub_bucket_half_count_ = 1u << sub_bucket_half_count_magnitude_;
+    sub_bucket_mask_ = (static_cast<uint64_t>(sub_bucket_half_count_) << 1) - 1;
+
+    uint64_t untrackable = static_cast<uint64_t>(sub_bucket_half_count_) << 1;
+    bucket_count_ = 1;
+    while (untrackable <= highest_) {
+        if (untrackable > (UINT64_MAX >> 1)) {
+            bucket_count_++;
+            break;
+        }
+        untrackable <<= 1;
+        bucket_count_++;
+    }
+    counts_.assign(static_cast<size_t>(bucket_count_ + 1) * sub_bucket_half_count_, 0);
+}
+
+size_t Histogram::index(uint64_t value) const
+{
+    value = std::min(value, highest_);
+
+    uint32_t pow2Ceiling = 64 - __builtin_clzll(value | sub_bucket_mask_);
+    uint32_t bucket = pow2Ceiling - (sub_bucket_half_count_magnitude_ + 1);
+    uint64_t subBucket = value >> bucket;
+
+    return (static_cast<size_t>(bucket + 1) << sub_bucket_half_count_magnitude_) +
+           static_cast<size_t>(subBucket - sub_bucket_half_count_);
+}
+
+uint64_t Histogram::lowest_value(size_t index) const
+{
+    int32_t bucket = static_cast<int32_t>(index >> sub_bucket_half_count_magnitude_) - 1;
+    uint64_t subBucket = (index & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+
+    if (bucket < 0) {
+        subBucket -= sub_bucket_half_count_;
+        bucket = 0;
+    }
+    return subBucket << bucket;
+}
+
+uint64_t Histogram::highest_value(size_t index) const
+{
+    int32_t bucket = std::max<int32_t>(static_cast<int32_t>(index >> sub_bucket_half_count_magnitude_) - 1, 0);
+
+    return lowest_value(index) + (static_cast<uint64_t>(1) << bucket) - 1;
+}
+
+void Histogram::record(uint64_t value)
+{
+    counts_[index(value)]++;
+    total_++;
+}
+
+void Histogram::add_counts(const uint64_t* counts)
+{
+    for (size_t i = 0; i < counts_.size(); i++) {
+        counts_[i] += counts[i];
+        total_ += counts[i];
+    }
+}
+
+void Histogram::reset()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = 0;
+}
+
+uint64_t Histogram::percentile(double percentile) const
+{
+    if (total_ == 0) {
+        return 0;
+    }
+
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(total_)));
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+        cumulative += counts_[i];
+        if (cumulative >= rank) {
+            return highest_value(i);
+        }
+    }
+    return highest_;
+}
+
+uint64_t Histogram::min() const
+{
+    for (size_t i = 0; i < counts_.size(); i++) {
+        if (counts_[i] > 0) {
+            return lowest_value(i);
+        }
+    }
+    return 0;
+}
+
+uint64_t Histogram::max() const
+{
+    for (size_t i = counts_.size(); i > 0; i--) {
+        if (counts_[i - 1] > 0) {
+            return highest_value(i - 1);
+        }
+    }
+    return 0;
+}
+
+double Histogram::mean() const
+{
+    double sum = 0;
+
+    if (total_ == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < counts_.size(); i++) {
+        if (counts_[i] > 0) {
+            double middle = (lowest_value(i) + highest_value(i)) / 2.0;
+            sum += middle * counts_[i];
+        }
+    }
+    return sum / total_;
+}
+
+double Histogram::stddev() const
+{
+    double mean = this->mean();
+    double sum = 0;
+
+    if (total_ == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < counts_.size(); i++) {
+        if (counts_[i] > 0) {
+            double deviation = (lowest_value(i) + highest_value(i)) / 2.0 - mean;
+            sum += deviation * deviation * counts_[i];
+        }
+    }
+    return std::sqrt(sum / total_);
+}
+
+void Histogram::print(FILE* file, double scale) const
+{
+    fprintf(file, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+
+    double level = 0;
+    while (total_ > 0) {
+        uint64_t value = percentile(level);
+        uint64_t cumulative = 0;
+
+        for (size_t i = 0; i <= index(value); i++) {
+            cumulative += counts_[i];
+        }
+        if (cumulative >= total_) {
+            fprintf(file, "%12.3f %2.12f %10llu\n", value / scale, 1.0, static_cast<unsigned long long>(total_));
+            break;
+        }
+        fprintf(file, "%12.3f %2.12f %10llu %14.2f\n", value / scale, level / 100.0,
+                static_cast<unsigned long long>(cumulative), 1.0 / (1.0 - level / 100.0));
+
+        // Finer steps as the percentiles get closer to 100
+        double halvings = std::floor(std::log2(100.0 / (100.0 - level))) + 1;
+        level += 100.0 / (kTicksPerHalfDistance * std::pow(2.0, halvings));
+    }
+
+    fprintf(file, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean() / scale, stddev() / scale);
+    fprintf(file, "#[Max     = %12.3f, Total count    = %12llu]\n", max() / scale,
+            static_cast<unsigned long long>(total_));
+    fprintf(file, "#[Buckets = %12u, SubBuckets     = %12u]\n", bucket_count_, sub_bucket_half_count_ << 1);
+}
+
+} // namespace sim
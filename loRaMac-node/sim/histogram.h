@@ -0,0 +1,89 @@
+/*!
+ * \file      histogram.h
+ *
+ * \brief     High dynamic range histogram of latencies
+ *
+ * \details   Same layout as HdrHistogram: values up to highest are counted
+ *            in buckets of doubling width, each split into sub-buckets so
+ *            that a value is known within 10^-digits of itself. Recording
+ *            is an index computation and an increment, with no allocation.
+ *
+ *            The counts are a flat array, so histograms recorded in other
+ *            processes, e.g. in shared memory, are summed with add_counts.
+ */
+#ifndef __SIM_HISTOGRAM_H__
+#define __SIM_HISTOGRAM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace sim {
+
+class Histogram {
+public:
+    /*!
+     * \param [IN] highest Highest value counted, larger values count as it
+     * \param [IN] digits  Significant decimal digits kept, 1 to 5
+     */
+    Histogram(uint64_t highest, int digits);
+
+    void record(uint64_t value);
+
+    /*!
+     * \brief Adds the counts of a histogram with the same highest value and
+     *        digits
+     *
+     * \param [IN] counts counts_size() counts, see counts()
+     */
+    void add_counts(const uint64_t* counts);
+
+    void add(const Histogram& other) { add_counts(other.counts()); }
+
+    void reset();
+
+    /*!
+     * \brief Gets the value at a percentile
+     *
+     * \param [IN] percentile 0 to 100
+     * \retval Highest value equivalent to the one at the percentile, 0 if
+     *         the histogram is empty
+     */
+    uint64_t percentile(double percentile) const;
+
+    uint64_t count() const { return total_; }
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    double stddev() const;
+
+    const uint64_t* counts() const { return counts_.data(); }
+    size_t counts_size() const { return counts_.size(); }
+
+    /*!
+     * \brief Prints the percentile distribution in the HdrHistogram .hgrm
+     *        format, which the HdrHistogram plotter reads
+     *
+     * \param [IN] file  Output
+     * \param [IN] scale Values are divided by it, e.g. 1000 for ns in us
+     */
+    void print(FILE* file, double scale) const;
+
+private:
+    size_t index(uint64_t value) const;
+    uint64_t lowest_value(size_t index) const;
+    uint64_t highest_value(size_t index) const;
+
+    uint64_t highest_;
+    uint32_t sub_bucket_half_count_magnitude_;
+    uint32_t sub_bucket_half_count_;
+    uint64_t sub_bucket_mask_;
+    uint32_t bucket_count_;
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+};
+
+} // namespace sim
+
+#endif // __SIM_HISTOGRAM_H__
@@ -0,0 +1,208 @@
+#include "sim/join_storm.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "aes.h"
+#include "sim/lorawan.h"
+
+namespace sim {
+
+using namespace lorawan;
+
+namespace {
+
+constexpr uint64_t kJoinEui = 0x70B3D57ED0000000;
+constexpr uint64_t kDevEuiBase = 0x0004A30B00000000;
+
+// Nearest rank percentile of sorted values
+Time percentile(const std::vector<Time>& sorted, uint32_t rank)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t i = (sorted.size() * rank + 99) / 100;
+    return sorted[std::max<size_t>(i, 1) - 1];
+}
+
+} // namespace
+
+JoinStorm::JoinStorm(const JoinStormConfig& config, const NetworkServerConfig& nsConfig)
+    : config_(config), ns_(medium_, nsConfig)
+{
+    // The listeners keep pointers to the devices
+    devices_.resize(config_.devices);
+    for (uint32_t i = 0; i < config_.devices; i++) {
+        Device& device = devices_[i];
+
+        device.storm = this;
+        device.listener = medium_.add_listener(on_rx, &device);
+        device.dev_eui = kDevEuiBase + i;
+        medium_.set_join_pending(device.listener, true, device.dev_eui);
+        RandCtxSeed(&device.rand, RandDeriveSeed(config_.seed, device.dev_eui));
+        for (uint8_t k = 0; k < 16; k += 4) {
+            put_le(&device.app_key[k], RandCtxNext(&device.rand), 4);
+        }
+        ns_.add_device(device.dev_eui, kJoinEui, device.app_key);
+
+        device.start = (config_.spread > 0) ? RandCtxNext(&device.rand) % config_.spread : 0;
+        events_.push({ device.start, i, EventType::Transmit });
+    }
+}
+
+JoinStormReport JoinStorm::run()
+{
+    report_ = {};
+    report_.devices = config_.devices;
+    latencies_.clear();
+
+    while (!events_.empty() || ns_.next_downlink_time() != kForever) {
+        Time now = ns_.next_downlink_time();
+
+        if (!events_.empty()) {
+            now = std::min(now, events_.top().time);
+        }
+        // Windows open and join-requests go out before the network server runs
+        while (!events_.empty() && events_.top().time == now) {
+            Event event = events_.top();
+            events_.pop();
+            handle(event);
+        }
+        ns_.process(now);
+        complete_joins(now);
+        report_.duration = now;
+    }
+
+    std::sort(latencies_.begin(), latencies_.end());
+    report_.joined = static_cast<uint32_t>(latencies_.size());
+    report_.latency_p50 = percentile(latencies_, 50);
+    report_.latency_p90 = percentile(latencies_, 90);
+    report_.latency_p99 = percentile(latencies_, 99);
+    report_.latency_max = latencies_.empty() ? 0 : latencies_.back();
+    return report_;
+}
+
+void JoinStorm::handle(const Event& event)
+{
+    Device& device = devices_[event.device];
+    uint32_t frequency;
+    uint8_t modulation;
+
+    switch (event.type) {
+    case EventType::Transmit:
+        transmit(device, event.device, event.time);
+        break;
+    case EventType::OpenRx1:
+        if (device.joined) {
+            break;
+        }
+        ns_.rx1(device.frequency, device.modulation, &frequency, &modulation);
+        medium_.open_rx_window(device.listener, frequency, modulation, event.time);
+        break;
+    case EventType::OpenRx2:
+        if (device.joined) {
+            break;
+        }
+        ns_.rx2(&frequency, &modulation);
+        medium_.open_rx_window(device.listener, frequency, modulation, event.time);
+        break;
+    case EventType::Timeout:
+        medium_.close_rx_window(device.listener);
+        if (device.joined) {
+            break;
+        }
+        if (device.attempts < config_.max_attempts) {
+            Time delay = config_.retry_min;
+            if (config_.retry_max > config_.retry_min) {
+                delay += RandCtxNext(&device.rand) % (config_.retry_max - config_.retry_min);
+            }
+            events_.push({ event.time + delay, event.device, EventType::Transmit });
+        } else {
+            report_.failed++;
+        }
+        break;
+    }
+}
+
+void JoinStorm::transmit(Device& device, uint32_t index, Time now)
+{
+    uint8_t frame[kJoinRequestSize];
+
+    if (ns_.config().plan == ChannelPlan::US915) {
+        // DR0 on one of the 64 125 kHz channels
+        device.frequency = 902300000 + (RandCtxNext(&device.rand) % 64) * 200000;
+        device.modulation = modulation(10, 0);
+    } else {
+        // DR0 on one of the 3 default channels
+        device.frequency = 868100000 + (RandCtxNext(&device.rand) % 3) * 200000;
+        device.modulation = modulation(12, 0);
+    }
+    device.dev_nonce++;
+    device.attempts++;
+    device.tx_time = now;
+
+    // MHDR | JoinEUI | DevEUI | DevNonce | MIC
+    frame[0] = kMTypeJoinRequest << 5;
+    put_le(&frame[1], kJoinEui, 8);
+    put_le(&frame[9], device.dev_eui, 8);
+    put_le(&frame[17], device.dev_nonce, 2);
+    put_le(&frame[19], cmac(device.app_key, nullptr, frame, kJoinRequestSize - kMicSize), 4);
+
+    medium_.transmit({ device.frequency, device.modulation, now, frame, kJoinRequestSize, 0, 0 });
+    report_.join_requests++;
+
+    events_.push({ now + kJoinAcceptDelay1, index, EventType::OpenRx1 });
+    events_.push({ now + kJoinAcceptDelay1 + kRx2Offset, index, EventType::OpenRx2 });
+    events_.push({ now + kJoinAcceptDelay1 + kRx2Offset + 1, index, EventType::Timeout });
+}
+
+void JoinStorm::on_rx(void* context, const Frame& frame)
+{
+    Device* device = static_cast<Device*>(context);
+    JoinStorm* storm = device->storm;
+
+    if (frame.size == kJoinAcceptSize && !device->joined) {
+        Accept accept;
+
+        accept.device = static_cast<uint32_t>(device - storm->devices_.data());
+        std::memcpy(accept.payload, frame.payload, kJoinAcceptSize);
+        storm->accepts_.push_back(accept);
+    }
+}
+
+void JoinStorm::complete_joins(Time now)
+{
+    aes_context aes;
+
+    // Decrypt and check all the join-accepts received in this step
+    key_jobs_.clear();
+    for (Accept& accept : accepts_) {
+        Device& device = devices_[accept.device];
+        uint8_t* payload = accept.payload;
+
+        if (device.joined) {
+            continue;
+        }
+        // The device decrypts with an AES encrypt operation
+        aes_set_key(device.app_key, 16, &aes);
+        aes_encrypt(&payload[1], &payload[1], &aes);
+        if (cmac(device.app_key, nullptr, payload, kJoinAcceptSize - kMicSize) !=
+            get_le32(&payload[kJoinAcceptSize - kMicSize])) {
+            report_.foreign_accepts++;
+            continue;
+        }
+
+        device.joined = true;
+        device.dev_addr = get_le32(&payload[7]);
+        medium_.close_rx_window(device.listener);
+        medium_.set_join_pending(device.listener, false, 0);
+        latencies_.push_back(now - device.start);
+        key_jobs_.push_back({ device.app_key, get_le32(&payload[1]) & 0xFFFFFF, get_le32(&payload[4]) & 0xFFFFFF,
+                              device.dev_nonce, device.nwk_s_key, device.app_s_key });
+    }
+    accepts_.clear();
+
+    derive_session_keys(key_jobs_.data(), key_jobs_.size(), config_.key_threads);
+}
+
+} // namespace sim
@@ -0,0 +1,154 @@
+/*!
+ * \file      join_storm.h
+ *
+ * \brief     Bulk OTAA join driver
+ *
+ * \details   Pushes a fleet of devices through the OTAA join in virtual
+ *            time, against the network server stand-in. This models the
+ *            power-outage recovery, where every device of the fleet joins
+ *            again at about the same time.
+ *
+ *            A device sends a join-request on a random channel, listens in
+ *            RX1 and RX2, and retries after a random delay when no
+ *            join-accept arrived. Join-accepts received in a step are
+ *            decrypted and MIC checked in one pass, and the session keys
+ *            of the devices that joined are derived in one batch.
+ */
+#ifndef __SIM_JOIN_STORM_H__
+#define __SIM_JOIN_STORM_H__
+
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+#include "utilities.h"
+#include "sim/medium.h"
+#include "sim/network_server.h"
+#include "sim/session_keys.h"
+
+namespace sim {
+
+struct JoinStormConfig {
+    uint32_t devices = 1000;
+    uint64_t seed = 1;
+    /*!
+     * The first join-requests are spread over [0, spread) [ms]. 0 models
+     * all the devices powering up at once.
+     */
+    Time spread = 0;
+    /*!
+     * Random delay before a new join-request when the previous one got no
+     * answer [ms]
+     */
+    Time retry_min = 5000;
+    Time retry_max = 30000;
+    /*!
+     * Join-requests sent before a device gives up
+     */
+    uint32_t max_attempts = 16;
+    /*!
+     * Threads used for the device side session key derivations
+     */
+    unsigned key_threads = 1;
+};
+
+struct JoinStormReport {
+    uint32_t devices;
+    uint32_t joined;
+    uint32_t failed;
+    uint64_t join_requests;
+    /*!
+     * Join-accepts received by a device they were not meant for
+     */
+    uint64_t foreign_accepts;
+    /*!
+     * Virtual time until the last device joined or gave up [ms]
+     */
+    Time duration;
+    /*!
+     * Time from the first join-request to the join [ms]
+     */
+    Time latency_p50;
+    Time latency_p90;
+    Time latency_p99;
+    Time latency_max;
+};
+
+class JoinStorm {
+public:
+    JoinStorm(const JoinStormConfig& config, const NetworkServerConfig& nsConfig);
+
+    /*!
+     * \brief Runs the storm until every device joined or gave up
+     */
+    JoinStormReport run();
+
+    const NetworkServer& network_server() const { return ns_; }
+
+private:
+    static constexpr uint8_t kJoinAcceptSize = 17;
+
+    struct Device {
+        JoinStorm* storm;
+        ListenerId listener;
+        uint64_t dev_eui;
+        uint8_t app_key[16];
+        uint8_t nwk_s_key[16];
+        uint8_t app_s_key[16];
+        uint16_t dev_nonce;
+        uint32_t dev_addr;
+        uint32_t attempts;
+        bool joined;
+        Time start;
+        // Channel of the last join-request
+        uint32_t frequency;
+        uint8_t modulation;
+        Time tx_time;
+        RandCtx_t rand;
+    };
+
+    enum class EventType {
+        Transmit,
+        OpenRx1,
+        OpenRx2,
+        Timeout,
+    };
+
+    struct Event {
+        Time time;
+        uint32_t device;
+        EventType type;
+    };
+
+    struct EventLater {
+        bool operator()(const Event& a, const Event& b) const
+        {
+            return (a.time != b.time) ? (a.time > b.time) : (a.device > b.device);
+        }
+    };
+
+    struct Accept {
+        uint32_t device;
+        uint8_t payload[kJoinAcceptSize];
+    };
+
+    static void on_rx(void* context, const Frame& frame);
+
+    void handle(const Event& event);
+    void transmit(Device& device, uint32_t index, Time now);
+    void complete_joins(Time now);
+
+    JoinStormConfig config_;
+    Medium medium_;
+    NetworkServer ns_;
+    std::vector<Device> devices_;
+    std::priority_queue<Event, std::vector<Event>, EventLater> events_;
+    std::vector<Accept> accepts_;
+    std::vector<SessionKeyJob> key_jobs_;
+    std::vector<Time> latencies_;
+    JoinStormReport report_ = {};
+};
+
+} // namespace sim
+
+#endif // __SIM_JOIN_STORM_H__
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <string>
+#include <boost/program_options.hpp>
+
+#include "sim/join_storm.h"
+
+namespace po = boost::program_options;
+
+using namespace std;
+
+int main(int ac, char* av[])
+{
+    sim::JoinStormConfig config;
+    sim::NetworkServerConfig nsConfig;
+    po::variables_map vm;
+
+    try {
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h", "Help screen")
+            ("devices", po::value<uint32_t>(&config.devices)->default_value(config.devices), "Number of devices joining")
+            ("seed", po::value<uint64_t>(&config.seed)->default_value(config.seed), "Simulation master seed")
+            ("spread", po::value<sim::Time>(&config.spread)->default_value(config.spread), "First join-requests spread [ms]")
+            ("retry-min", po::value<sim::Time>(&config.retry_min)->default_value(config.retry_min), "Minimum join retry delay [ms]")
+            ("retry-max", po::value<sim::Time>(&config.retry_max)->default_value(config.retry_max), "Maximum join retry delay [ms]")
+            ("max-attempts", po::value<uint32_t>(&config.max_attempts)->default_value(config.max_attempts), "Join-requests before a device gives up")
+            ("threads", po::value<unsigned>(&config.key_threads)->default_value(config.key_threads), "Session key derivation threads")
+            ("gateways", po::value<uint32_t>(&nsConfig.gateways)->default_value(1), "Gateways answering, 0 for no limit")
+            ("airtime", po::value<sim::Time>(&nsConfig.downlink_airtime)->default_value(nsConfig.downlink_airtime), "Gateway time per downlink [ms]")
+            ("region", po::value<string>()->default_value("US915"), "Channel plan, US915 or EU868");
+
+        po::store(po::parse_command_line(ac, av, desc), vm);
+        po::notify(vm);
+
+        if (vm.count("help")) {
+            cout << desc << "\n";
+            return 1;
+        }
+    }
+    catch(exception& e) {
+        cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (vm["region"].as<string>() == "EU868") {
+        nsConfig.plan = sim::ChannelPlan::EU868;
+    }
+    else if (vm["region"].as<string>() != "US915") {
+        cerr << "Region " << vm["region"].as<string>() << " is not supported\n";
+        return 1;
+    }
+    nsConfig.key_threads = config.key_threads;
+
+    sim::JoinStorm storm(config, nsConfig);
+    sim::JoinStormReport report = storm.run();
+    const sim::NetworkServerStats& ns = storm.network_server().stats();
+
+    cout << "devices:          " << report.devices << "\n"
+         << "joined:           " << report.joined << "\n"
+         << "failed:           " << report.failed << "\n"
+         << "join-requests:    " << report.join_requests << "\n"
+         << "join-accepts:     " << ns.joins_accepted << " (" << ns.rx2_downlinks << " in RX2), "
+                                 << ns.joins_dropped << " not sent\n"
+         << "foreign accepts:  " << report.foreign_accepts << "\n"
+         << "duration:         " << report.duration << " ms\n"
+         << "latency p50:      " << report.latency_p50 << " ms\n"
+         << "latency p90:      " << report.latency_p90 << " ms\n"
+         << "latency p99:      " << report.latency_p99 << " ms\n"
+         << "latency max:      " << report.latency_max << " ms\n";
+
+    return report.failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,36 @@
+#include "sim/lorawan.h"
+
+#include "cmac.h"
+
+namespace sim {
+namespace lorawan {
+
+uint32_t cmac(const uint8_t key[16], const uint8_t* b0, const uint8_t* data, uint8_t size)
+{
+    AES_CMAC_CTX ctx;
+    uint8_t digest[AES_CMAC_DIGEST_LENGTH];
+
+    AES_CMAC_Init(&ctx);
+    AES_CMAC_SetKey(&ctx, key);
+    if (b0 != nullptr) {
+        AES_CMAC_Update(&ctx, b0, 16);
+    }
+    AES_CMAC_Update(&ctx, data, size);
+    AES_CMAC_Final(digest, &ctx);
+    return get_le32(digest);
+}
+
+uint32_t data_mic(const uint8_t key[16], bool downlink, uint32_t devAddr, uint32_t fcnt,
+                  const uint8_t* data, uint8_t size)
+{
+    uint8_t b0[16] = { 0x49 };
+
+    b0[5] = downlink ? 1 : 0;
+    put_le(&b0[6], devAddr, 4);
+    put_le(&b0[10], fcnt, 4);
+    b0[15] = size;
+    return cmac(key, b0, data, size);
+}
+
+} // namespace lorawan
+} // namespace sim
@@ -0,0 +1,77 @@
+/*!
+ * \file      lorawan.h
+ *
+ * \brief     LoRaWAN 1.0.x frame helpers shared by the simulated network
+ *            server and devices
+ */
+#ifndef __SIM_LORAWAN_H__
+#define __SIM_LORAWAN_H__
+
+#include <cstdint>
+
+#include "sim/medium.h"
+
+namespace sim {
+namespace lorawan {
+
+/*!
+ * MHDR message types
+ */
+constexpr uint8_t kMTypeJoinRequest = 0x00;
+constexpr uint8_t kMTypeJoinAccept = 0x01;
+constexpr uint8_t kMTypeUnconfirmedUp = 0x02;
+constexpr uint8_t kMTypeUnconfirmedDown = 0x03;
+constexpr uint8_t kMTypeConfirmedUp = 0x04;
+
+/*!
+ * Frame sizes
+ */
+constexpr uint8_t kJoinRequestSize = 23;
+constexpr uint8_t kJoinAcceptSize = 17;
+constexpr uint8_t kMicSize = 4;
+
+/*!
+ * Receive delays [ms]
+ */
+constexpr Time kJoinAcceptDelay1 = 5000;
+constexpr Time kRx2Offset = 1000;
+
+inline uint32_t get_le32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t get_le64(const uint8_t* p)
+{
+    return static_cast<uint64_t>(get_le32(p)) | (static_cast<uint64_t>(get_le32(p + 4)) << 32);
+}
+
+inline void put_le(uint8_t* p, uint64_t value, uint8_t size)
+{
+    for (uint8_t i = 0; i < size; i++) {
+        p[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+/*!
+ * \brief Computes a frame MIC, the first 4 bytes of the AES-CMAC
+ *
+ * \param [IN] key  AES key
+ * \param [IN] b0   Block prepended to the data, nullptr if none
+ * \param [IN] data Data to authenticate
+ * \param [IN] size Data size
+ */
+uint32_t cmac(const uint8_t key[16], const uint8_t* b0, const uint8_t* data, uint8_t size);
+
+/*!
+ * \brief Computes the MIC of a data frame, the B0 block depends on the
+ *        direction and the frame counter
+ */
+uint32_t data_mic(const uint8_t key[16], bool downlink, uint32_t devAddr, uint32_t fcnt,
+                  const uint8_t* data, uint8_t size);
+
+} // namespace lorawan
+} // namespace sim
+
+#endif // __SIM_LORAWAN_H__
@@ -0,0 +1,240 @@
+#include "sim/medium.h"
+
+namespace sim {
+
+namespace {
+
+// LoRaWAN MHDR message types carried by downlinks
+constexpr uint8_t kMTypeJoinAccept = 0x01;
+constexpr uint8_t kMTypeUnconfirmedDown = 0x03;
+constexpr uint8_t kMTypeConfirmedDown = 0x05;
+
+// MHDR + DevAddr
+constexpr uint8_t kDataHeaderSize = 5;
+
+} // namespace
+
+uint64_t Medium::key(uint32_t frequency, uint8_t modulation, bool join, uint32_t address)
+{
+    // LoRaWAN frequencies are multiples of 100 Hz and fit in 24 bits
+    return (static_cast<uint64_t>(frequency / 100) << 40) |
+           (static_cast<uint64_t>(modulation & 0x7F) << 33) |
+           (static_cast<uint64_t>(join) << 32) | address;
+}
+
+uint32_t Medium::join_address(uint64_t devEui)
+{
+    // Folded DevEUI, the listeners check the full one
+    return static_cast<uint32_t>(devEui) ^ static_cast<uint32_t>(devEui >> 32);
+}
+
+ListenerId Medium::add_listener(RxHandler handler, void* context)
+{
+    Listener listener = {};
+    listener.handler = handler;
+    listener.context = context;
+    listeners_.push_back(listener);
+    return static_cast<ListenerId>(listeners_.size() - 1);
+}
+
+void Medium::set_uplink_handler(RxHandler handler, void* context)
+{
+    uplink_handler_ = handler;
+    uplink_context_ = context;
+}
+
+void Medium::transmit(const Frame& frame)
+{
+    stats_.uplinks++;
+    if (uplink_handler_ != nullptr) {
+        uplink_handler_(uplink_context_, frame);
+    }
+}
+
+void Medium::set_address(ListenerId id, uint8_t slot, uint32_t address, bool enabled)
+{
+    if (id >= listeners_.size() || slot >= kAddressSlots) {
+        return;
+    }
+
+    Listener& listener = listeners_[id];
+    bool open = listener.open;
+
+    if (open) {
+        unindex(id);
+    }
+    listener.addresses[slot] = address;
+    if (enabled) {
+        listener.enabled |= (1 << slot);
+    } else {
+        listener.enabled &= ~(1 << slot);
+    }
+    if (open) {
+        index(id);
+    }
+}
+
+void Medium::set_join_pending(ListenerId id, bool pending, uint64_t devEui)
+{
+    if (id >= listeners_.size()) {
+        return;
+    }
+
+    Listener& listener = listeners_[id];
+    bool open = listener.open;
+
+    if (open) {
+        unindex(id);
+    }
+    listener.join_pending = pending;
+    listener.join_dev_eui = devEui;
+    if (open) {
+        index(id);
+    }
+}
+
+void Medium::open_rx_window(ListenerId id, uint32_t frequency, uint8_t modulation, Time deadline)
+{
+    if (id >= listeners_.size()) {
+        return;
+    }
+
+    Listener& listener = listeners_[id];
+    if (listener.open) {
+        unindex(id);
+    }
+    listener.frequency = frequency;
+    listener.modulation = modulation;
+    listener.deadline = deadline;
+    index(id);
+}
+
+void Medium::close_rx_window(ListenerId id)
+{
+    if (id < listeners_.size() && listeners_[id].open) {
+        unindex(id);
+    }
+}
+
+void Medium::index(ListenerId id)
+{
+    Listener& listener = listeners_[id];
+
+    for (uint8_t slot = 0; slot < kAddressSlots; slot++) {
+        if (listener.enabled & (1 << slot)) {
+            index_[key(listener.frequency, listener.modulation, false, listener.addresses[slot])].push_back(id);
+        }
+    }
+    if (listener.join_pending) {
+        index_[key(listener.frequency, listener.modulation, true, join_address(listener.join_dev_eui))].push_back(id);
+    }
+    listener.open = true;
+}
+
+void Medium::unindex_key(uint64_t k, ListenerId id)
+{
+    auto it = index_.find(k);
+    if (it == index_.end()) {
+        return;
+    }
+
+    std::vector<ListenerId>& bucket = it->second;
+    for (size_t i = 0; i < bucket.size(); i++) {
+        if (bucket[i] == id) {
+            bucket[i] = bucket.back();
+            bucket.pop_back();
+            break;
+        }
+    }
+    if (bucket.empty()) {
+        index_.erase(it);
+    }
+}
+
+void Medium::unindex(ListenerId id)
+{
+    Listener& listener = listeners_[id];
+
+    for (uint8_t slot = 0; slot < kAddressSlots; slot++) {
+        if (listener.enabled & (1 << slot)) {
+            unindex_key(key(listener.frequency, listener.modulation, false, listener.addresses[slot]), id);
+        }
+    }
+    if (listener.join_pending) {
+        unindex_key(key(listener.frequency, listener.modulation, true, join_address(listener.join_dev_eui)), id);
+    }
+    listener.open = false;
+}
+
+size_t Medium::deliver(const Frame& frame)
+{
+    size_t delivered = 0;
+
+    stats_.downlinks++;
+    if (frame.size == 0) {
+        stats_.rejected++;
+        return 0;
+    }
+
+    uint8_t mtype = frame.payload[0] >> 5;
+    if (mtype == kMTypeJoinAccept) {
+        // The join-accept is encrypted, it goes to the device it answers and
+        // to the joining devices that did not give their DevEUI
+        uint32_t address = join_address(frame.dev_eui);
+        if (address != 0) {
+            delivered += deliver_to(key(frame.frequency, frame.modulation, true, address), frame);
+        }
+        delivered += deliver_to(key(frame.frequency, frame.modulation, true, 0), frame);
+    } else if ((mtype == kMTypeUnconfirmedDown || mtype == kMTypeConfirmedDown) &&
+               frame.size >= kDataHeaderSize) {
+        uint32_t devAddr = static_cast<uint32_t>(frame.payload[1]) |
+                           (static_cast<uint32_t>(frame.payload[2]) << 8) |
+                           (static_cast<uint32_t>(frame.payload[3]) << 16) |
+                           (static_cast<uint32_t>(frame.payload[4]) << 24);
+        delivered = deliver_to(key(frame.frequency, frame.modulation, false, devAddr), frame);
+    }
+
+    stats_.deliveries += delivered;
+    if (delivered == 0) {
+        stats_.rejected++;
+    }
+    return delivered;
+}
+
+size_t Medium::deliver_to(uint64_t k, const Frame& frame)
+{
+    size_t delivered = 0;
+
+    auto it = index_.find(k);
+    if (it == index_.end()) {
+        return 0;
+    }
+
+    // The handlers may open or close windows, work on a copy of the bucket
+    scratch_.assign(it->second.begin(), it->second.end());
+    for (ListenerId id : scratch_) {
+        Listener& listener = listeners_[id];
+
+        if (!listener.open) {
+            continue;
+        }
+        // Join-accept of another device with the same folded DevEUI
+        if ((frame.payload[0] >> 5) == kMTypeJoinAccept && listener.join_dev_eui != 0 &&
+            listener.join_dev_eui != frame.dev_eui) {
+            continue;
+        }
+        if (frame.time > listener.deadline) {
+            unindex(id);
+            stats_.expired++;
+            continue;
+        }
+        if (listener.deadline != kForever) {
+            unindex(id);
+        }
+        listener.handler(listener.context, frame);
+        delivered++;
+    }
+    return delivered;
+}
+
+} // namespace sim
@@ -0,0 +1,188 @@
+/*!
+ * \file      medium.h
+ *
+ * \brief     Simulated radio medium shared by the hosted devices
+ *
+ * \details   Uplinks are handed to a single uplink handler, the gateway
+ *            side of the simulation.
+ *
+ *            Every simulated radio registers as a listener. While a radio
+ *            has a reception window open, the listener is indexed by
+ *            ( frequency, modulation, address ) for each address it
+ *            accepts: the device address, the multicast group addresses
+ *            and, while a join is pending, the join-accept key built from
+ *            the DevEUI of the device. A device joining again keeps its
+ *            previous DevAddr until the accept arrives, the join-accept key
+ *            does not depend on it.
+ *
+ *            A downlink is only handed to the listeners found under the
+ *            key built from its own frequency, modulation and DevAddr, or
+ *            the DevEUI the network server answers for a join-accept.
+ *            Devices the frame is not addressed to never see it, so the
+ *            cost of a downlink does not depend on the fleet size.
+ */
+#ifndef __SIM_MEDIUM_H__
+#define __SIM_MEDIUM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace sim {
+
+/*!
+ * Virtual simulation time [ms]
+ */
+using Time = uint64_t;
+
+/*!
+ * Handle of a listener registered with the medium
+ */
+using ListenerId = uint32_t;
+
+/*!
+ * Window deadline used for continuous reception (class C)
+ */
+constexpr Time kForever = UINT64_MAX;
+
+/*!
+ * Number of address filter slots per listener. Slot 0 holds the device
+ * address, the following slots the multicast groups.
+ */
+constexpr uint8_t kAddressSlots = 5;
+
+/*!
+ * \brief Encodes a LoRa modulation as used in the medium index
+ *
+ * \param [IN] spreadingFactor Spreading factor [5..12]
+ * \param [IN] bandwidth       Bandwidth index [0: 125 kHz, 1: 250 kHz, 2: 500 kHz]
+ */
+constexpr uint8_t modulation(uint32_t spreadingFactor, uint32_t bandwidth)
+{
+    return static_cast<uint8_t>(((bandwidth & 0x03) << 4) | (spreadingFactor & 0x0F));
+}
+
+/*!
+ * Frame on the air
+ */
+struct Frame {
+    uint32_t frequency;
+    uint8_t modulation;
+    Time time;
+    const uint8_t* payload;
+    uint8_t size;
+    int16_t rssi;
+    int8_t snr;
+    /*!
+     * DevEUI a join-accept answers, 0 when unknown. The encrypted frame does
+     * not carry it, the network server passes it along.
+     */
+    uint64_t dev_eui;
+};
+
+/*!
+ * Called for each listener a frame is delivered to
+ */
+using RxHandler = void (*)(void* context, const Frame& frame);
+
+/*!
+ * Delivery counters
+ */
+struct MediumStats {
+    uint64_t uplinks;
+    uint64_t downlinks;
+    uint64_t deliveries;
+    uint64_t rejected;
+    uint64_t expired;
+};
+
+class Medium {
+public:
+    /*!
+     * \brief Registers a radio
+     *
+     * \param [IN] handler Reception handler of the radio
+     * \param [IN] context Passed back to the handler
+     * \retval Listener handle
+     */
+    ListenerId add_listener(RxHandler handler, void* context);
+
+    /*!
+     * \brief Registers the receiver of the uplinks
+     */
+    void set_uplink_handler(RxHandler handler, void* context);
+
+    /*!
+     * \brief Transmits an uplink
+     */
+    void transmit(const Frame& frame);
+
+    /*!
+     * \brief Sets or clears an address filter slot of a listener
+     */
+    void set_address(ListenerId id, uint8_t slot, uint32_t address, bool enabled);
+
+    /*!
+     * \brief Sets whether a listener waits for a join-accept
+     *
+     * \param [IN] devEui DevEUI of the join-accepts accepted, 0 for those of
+     *                    every device
+     */
+    void set_join_pending(ListenerId id, bool pending, uint64_t devEui);
+
+    /*!
+     * \brief Opens a reception window. An already open window is replaced.
+     *
+     * \param [IN] deadline Last time a frame is accepted, kForever for continuous reception
+     */
+    void open_rx_window(ListenerId id, uint32_t frequency, uint8_t modulation, Time deadline);
+
+    /*!
+     * \brief Closes the reception window of a listener, if open
+     */
+    void close_rx_window(ListenerId id);
+
+    /*!
+     * \brief Delivers a downlink to the listeners it is addressed to.
+     *        Single-shot windows are closed before the handler runs.
+     *
+     * \retval Number of listeners the frame was delivered to
+     */
+    size_t deliver(const Frame& frame);
+
+    const MediumStats& stats() const { return stats_; }
+
+private:
+    struct Listener {
+        RxHandler handler;
+        void* context;
+        uint32_t addresses[kAddressSlots];
+        uint8_t enabled;
+        bool join_pending;
+        uint64_t join_dev_eui;
+        bool open;
+        uint32_t frequency;
+        uint8_t modulation;
+        Time deadline;
+    };
+
+    static uint64_t key(uint32_t frequency, uint8_t modulation, bool join, uint32_t address);
+    static uint32_t join_address(uint64_t devEui);
+
+    void index(ListenerId id);
+    void unindex(ListenerId id);
+    void unindex_key(uint64_t k, ListenerId id);
+    size_t deliver_to(uint64_t k, const Frame& frame);
+
+    std::vector<Listener> listeners_;
+    std::unordered_map<uint64_t, std::vector<ListenerId>> index_;
+    std::vector<ListenerId> scratch_;
+    RxHandler uplink_handler_ = nullptr;
+    void* uplink_context_ = nullptr;
+    MediumStats stats_ = {};
+};
+
+} // namespace sim
+
+#endif // __SIM_MEDIUM_H__
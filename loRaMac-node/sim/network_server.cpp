@@ -0,0 +1,460 @@
+#include "sim/network_server.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "aes.h"
+#include "sim/lorawan.h"
+
+namespace sim {
+
+using namespace lorawan;
+
+namespace {
+
+// Frame sizes
+constexpr uint8_t kDataMinSize = 12;
+constexpr uint8_t kMaxFOptsSize = 15;
+
+// FCtrl bits
+constexpr uint8_t kFCtrlAdr = 0x80;
+constexpr uint8_t kFCtrlAdrAckReq = 0x40;
+constexpr uint8_t kFCtrlAck = 0x20;
+
+// MAC command identifiers
+constexpr uint8_t kLinkCheck = 0x02;
+constexpr uint8_t kLinkAdr = 0x03;
+constexpr uint8_t kDeviceTime = 0x0D;
+
+// Demodulation floor per spreading factor [dB]
+int8_t required_snr(uint8_t spreadingFactor)
+{
+    static const int8_t snr[] = { -5, -7, -10, -12, -15, -17, -20 };
+    uint8_t sf = std::min<uint8_t>(std::max<uint8_t>(spreadingFactor, 6), 12);
+    return snr[sf - 6];
+}
+
+// Length of the payload of the uplink MAC commands, 0xFF for unknown commands
+uint8_t uplink_cmd_size(uint8_t cid)
+{
+    switch (cid) {
+    case 0x02: return 0; // LinkCheckReq
+    case 0x03: return 1; // LinkAdrAns
+    case 0x04: return 0; // DutyCycleAns
+    case 0x05: return 1; // RxParamSetupAns
+    case 0x06: return 2; // DevStatusAns
+    case 0x07: return 1; // NewChannelAns
+    case 0x08: return 0; // RxTimingSetupAns
+    case 0x09: return 0; // TxParamSetupAns
+    case 0x0A: return 1; // DlChannelAns
+    case 0x0D: return 0; // DeviceTimeReq
+    default: return 0xFF;
+    }
+}
+
+} // namespace
+
+NetworkServer::NetworkServer(Medium& medium, const NetworkServerConfig& config)
+    : medium_(medium), config_(config)
+{
+    medium_.set_uplink_handler(on_uplink, this);
+}
+
+void NetworkServer::add_device(uint64_t devEui, uint64_t joinEui, const uint8_t appKey[16])
+{
+    Device device = {};
+
+    device.dev_eui = devEui;
+    device.join_eui = joinEui;
+    std::memcpy(device.app_key, appKey, 16);
+    device.dev_addr = config_.dev_addr_base + static_cast<uint32_t>(devices_.size());
+    device.nb_trans = 1;
+
+    by_dev_eui_[devEui] = static_cast<uint32_t>(devices_.size());
+    by_dev_addr_[device.dev_addr] = static_cast<uint32_t>(devices_.size());
+    devices_.push_back(device);
+}
+
+void NetworkServer::on_uplink(void* context, const Frame& frame)
+{
+    NetworkServer* ns = static_cast<NetworkServer*>(context);
+    Uplink uplink;
+
+    ns->stats_.uplinks++;
+    uplink.time = frame.time;
+    uplink.frequency = frame.frequency;
+    uplink.modulation = frame.modulation;
+    uplink.snr = frame.snr;
+    uplink.size = frame.size;
+    std::memcpy(uplink.payload, frame.payload, frame.size);
+    ns->uplinks_.push_back(uplink);
+}
+
+void NetworkServer::process(Time now)
+{
+    // Uplinks transmitted while processing are handled in the next step
+    processing_.swap(uplinks_);
+    for (const Uplink& uplink : processing_) {
+        uint8_t mtype = uplink.payload[0] >> 5;
+
+        if (mtype == kMTypeJoinRequest) {
+            handle_join_request(uplink);
+        } else if (mtype == kMTypeUnconfirmedUp || mtype == kMTypeConfirmedUp) {
+            handle_data_uplink(uplink, now);
+        }
+    }
+    processing_.clear();
+
+    accept_joins(now);
+
+    // Downlinks are never scheduled in the past, the ones over do not matter anymore
+    while (!gateway_busy_.empty() && *gateway_busy_.begin() + config_.downlink_airtime <= now) {
+        gateway_busy_.erase(gateway_busy_.begin());
+    }
+
+    while (!downlinks_.empty() && downlinks_.top().time <= now) {
+        const Downlink& downlink = downlinks_.top();
+        Frame frame = { downlink.frequency, downlink.modulation, downlink.time,
+                        downlink.payload, downlink.size, config_.downlink_rssi, config_.downlink_snr,
+                        downlink.dev_eui };
+
+        medium_.deliver(frame);
+        stats_.downlinks++;
+        downlinks_.pop();
+    }
+}
+
+Time NetworkServer::next_downlink_time() const
+{
+    return downlinks_.empty() ? kForever : downlinks_.top().time;
+}
+
+void NetworkServer::handle_join_request(const Uplink& uplink)
+{
+    stats_.join_requests++;
+    if (uplink.size != kJoinRequestSize) {
+        stats_.joins_rejected++;
+        return;
+    }
+
+    auto it = by_dev_eui_.find(get_le64(&uplink.payload[9]));
+    if (it == by_dev_eui_.end()) {
+        stats_.unknown_devices++;
+        return;
+    }
+
+    Device& device = devices_[it->second];
+    uint16_t devNonce = static_cast<uint16_t>(uplink.payload[17] | (uplink.payload[18] << 8));
+    uint32_t mic = get_le32(&uplink.payload[kJoinRequestSize - kMicSize]);
+
+    if ((get_le64(&uplink.payload[1]) != device.join_eui) ||
+        (cmac(device.app_key, nullptr, uplink.payload, kJoinRequestSize - kMicSize) != mic)) {
+        stats_.mic_failures++;
+        stats_.joins_rejected++;
+        return;
+    }
+    // Replayed join-request
+    if (device.joined && devNonce == device.last_dev_nonce) {
+        stats_.joins_rejected++;
+        return;
+    }
+
+    JoinJob job = {};
+    job.device = it->second;
+    job.dev_nonce = devNonce;
+    job.time = uplink.time;
+    job.frequency = uplink.frequency;
+    job.modulation = uplink.modulation;
+    joins_.push_back(job);
+}
+
+void NetworkServer::accept_joins(Time now)
+{
+    aes_context aes;
+
+    // Session keys of all the joins received in this step in one pass
+    key_jobs_.clear();
+    for (JoinJob& job : joins_) {
+        Device& device = devices_[job.device];
+
+        job.join_nonce = device.join_nonce + 1;
+        key_jobs_.push_back({ device.app_key, job.join_nonce, config_.net_id, job.dev_nonce,
+                              job.nwk_s_key, job.app_s_key });
+    }
+    derive_session_keys(key_jobs_.data(), key_jobs_.size(), config_.key_threads);
+
+    for (const JoinJob& job : joins_) {
+        Device& device = devices_[job.device];
+        uint8_t frame[kJoinAcceptSize];
+
+        aes_set_key(device.app_key, 16, &aes);
+
+        // MHDR | JoinNonce | NetID | DevAddr | DLSettings | RxDelay | MIC
+        frame[0] = kMTypeJoinAccept << 5;
+        put_le(&frame[1], job.join_nonce, 3);
+        put_le(&frame[4], config_.net_id, 3);
+        put_le(&frame[7], device.dev_addr, 4);
+        frame[11] = (config_.plan == ChannelPlan::US915) ? 8 : 0;
+        frame[12] = config_.rx_delay;
+        put_le(&frame[13], cmac(device.app_key, nullptr, frame, 13), 4);
+        // The join-accept is encrypted with an AES decrypt operation
+        aes_decrypt(&frame[1], &frame[1], &aes);
+
+        Uplink uplink = {};
+        uplink.time = job.time;
+        uplink.frequency = job.frequency;
+        uplink.modulation = job.modulation;
+        if (!schedule(uplink, kJoinAcceptDelay1, frame, kJoinAcceptSize, device.dev_eui, now)) {
+            // The device never hears of this session, it keeps the previous one
+            stats_.joins_dropped++;
+            continue;
+        }
+
+        device.join_nonce = job.join_nonce;
+        device.last_dev_nonce = job.dev_nonce;
+        std::memcpy(device.nwk_s_key, job.nwk_s_key, 16);
+        std::memcpy(device.app_s_key, job.app_s_key, 16);
+        device.joined = true;
+        device.fcnt_up = 0;
+        device.fcnt_down = 0;
+        device.snr_head = 0;
+        device.snr_count = 0;
+        device.tx_power = 0;
+        device.mac_cmds_size = 0;
+        stats_.joins_accepted++;
+    }
+    joins_.clear();
+}
+
+void NetworkServer::handle_data_uplink(const Uplink& uplink, Time now)
+{
+    stats_.data_uplinks++;
+    if (uplink.size < kDataMinSize) {
+        return;
+    }
+
+    auto it = by_dev_addr_.find(get_le32(&uplink.payload[1]));
+    if (it == by_dev_addr_.end() || !devices_[it->second].joined) {
+        stats_.unknown_devices++;
+        return;
+    }
+
+    Device& device = devices_[it->second];
+    uint8_t fCtrl = uplink.payload[5];
+    uint8_t fOptsLen = fCtrl & 0x0F;
+    uint16_t fCnt16 = static_cast<uint16_t>(uplink.payload[6] | (uplink.payload[7] << 8));
+    uint32_t fCnt = (device.fcnt_up & 0xFFFF0000) | fCnt16;
+    uint8_t micOffset = uplink.size - kMicSize;
+
+    // Restore the 32 bits frame counter
+    if (fCnt < device.fcnt_up) {
+        fCnt += 0x10000;
+    }
+    if ((8 + fOptsLen > micOffset) ||
+        (data_mic(device.nwk_s_key, false, device.dev_addr, fCnt, uplink.payload, micOffset) !=
+         get_le32(&uplink.payload[micOffset]))) {
+        stats_.mic_failures++;
+        return;
+    }
+    device.fcnt_up = fCnt;
+
+    handle_mac_commands(device, &uplink.payload[8], fOptsLen, uplink.time);
+    if (config_.adr && (fCtrl & kFCtrlAdr)) {
+        run_adr(device, uplink);
+    }
+
+    bool ack = (uplink.payload[0] >> 5) == kMTypeConfirmedUp;
+    if (ack || (device.mac_cmds_size > 0) || (fCtrl & kFCtrlAdrAckReq)) {
+        send_data_downlink(device, uplink, ack, now);
+    }
+}
+
+void NetworkServer::handle_mac_commands(Device& device, const uint8_t* cmds, uint8_t size, Time now)
+{
+    uint8_t i = 0;
+
+    while (i < size) {
+        uint8_t cid = cmds[i++];
+        uint8_t cmdSize = uplink_cmd_size(cid);
+
+        if (cmdSize == 0xFF || i + cmdSize > size) {
+            // The rest can not be decoded
+            return;
+        }
+        if (cid == kLinkCheck && device.mac_cmds_size + 3 <= kMaxFOptsSize) {
+            device.mac_cmds[device.mac_cmds_size++] = kLinkCheck;
+            device.mac_cmds[device.mac_cmds_size++] = 20; // Margin [dB]
+            device.mac_cmds[device.mac_cmds_size++] = 1;  // Gateway count
+        } else if (cid == kLinkAdr && (cmds[i] & 0x07) != 0x07) {
+            // LinkAdrReq refused, go back to the default power
+            device.tx_power = 0;
+        } else if (cid == kDeviceTime && device.mac_cmds_size + 6 <= kMaxFOptsSize) {
+            device.mac_cmds[device.mac_cmds_size++] = kDeviceTime;
+            put_le(&device.mac_cmds[device.mac_cmds_size], static_cast<uint32_t>(now / 1000), 4);
+            device.mac_cmds[device.mac_cmds_size + 4] = static_cast<uint8_t>(((now % 1000) * 256) / 1000);
+            device.mac_cmds_size += 5;
+        }
+        i += cmdSize;
+    }
+}
+
+void NetworkServer::run_adr(Device& device, const Uplink& uplink)
+{
+    uint8_t sf = uplink.modulation & 0x0F;
+    bool us915 = config_.plan == ChannelPlan::US915;
+    uint8_t maxDr = us915 ? 3 : 5;
+    uint8_t maxTxPower = us915 ? 10 : 7;
+
+    // 500 kHz uplinks are not adapted
+    if ((uplink.modulation >> 4) != 0) {
+        return;
+    }
+
+    // Ring of the last kAdrHistory uplinks
+    device.snr_history[device.snr_head] = uplink.snr;
+    device.snr_head = static_cast<uint8_t>((device.snr_head + 1) % kAdrHistory);
+    device.snr_count = std::min<uint8_t>(device.snr_count + 1, kAdrHistory);
+
+    int8_t maxSnr = INT8_MIN;
+    for (uint8_t i = 0; i < device.snr_count; i++) {
+        maxSnr = std::max(maxSnr, device.snr_history[i]);
+    }
+
+    int8_t datarate = static_cast<int8_t>((us915 ? 10 : 12) - sf);
+    int8_t txPower = static_cast<int8_t>(device.tx_power);
+    int steps = (maxSnr - required_snr(sf) - config_.adr_margin) / 3;
+
+    datarate = std::max<int8_t>(datarate, 0);
+    while (steps > 0 && datarate < maxDr) {
+        datarate++;
+        steps--;
+    }
+    while (steps > 0 && txPower < maxTxPower) {
+        txPower++;
+        steps--;
+    }
+    while (steps < 0 && txPower > 0) {
+        txPower--;
+        steps++;
+    }
+
+    if ((datarate == (us915 ? 10 : 12) - sf && txPower == device.tx_power) ||
+        (device.mac_cmds_size + 5 > kMaxFOptsSize)) {
+        return;
+    }
+
+    uint8_t* cmd = &device.mac_cmds[device.mac_cmds_size];
+    cmd[0] = kLinkAdr;
+    cmd[1] = static_cast<uint8_t>((datarate << 4) | txPower);
+    if (us915) {
+        // ChMaskCntl 6: all 125 kHz channels on, ChMask for the 500 kHz channels
+        put_le(&cmd[2], 0x00FF, 2);
+        cmd[4] = (6 << 4) | device.nb_trans;
+    } else {
+        put_le(&cmd[2], 0x0007, 2);
+        cmd[4] = device.nb_trans;
+    }
+    device.mac_cmds_size += 5;
+    device.datarate = static_cast<uint8_t>(datarate);
+    device.tx_power = static_cast<uint8_t>(txPower);
+    stats_.link_adr_requests++;
+}
+
+void NetworkServer::send_data_downlink(Device& device, const Uplink& uplink, bool ack, Time now)
+{
+    uint8_t frame[kMaxFrameSize];
+    uint8_t size = 0;
+
+    frame[size++] = kMTypeUnconfirmedDown << 5;
+    put_le(&frame[size], device.dev_addr, 4);
+    size += 4;
+    frame[size++] = (config_.adr ? kFCtrlAdr : 0) | (ack ? kFCtrlAck : 0) | device.mac_cmds_size;
+    put_le(&frame[size], device.fcnt_down, 2);
+    size += 2;
+    std::memcpy(&frame[size], device.mac_cmds, device.mac_cmds_size);
+    size += device.mac_cmds_size;
+    put_le(&frame[size], data_mic(device.nwk_s_key, true, device.dev_addr, device.fcnt_down, frame, size), 4);
+    size += kMicSize;
+
+    device.fcnt_down++;
+    device.mac_cmds_size = 0;
+    schedule(uplink, static_cast<Time>(config_.rx_delay) * 1000, frame, size, 0, now);
+}
+
+bool NetworkServer::schedule(const Uplink& uplink, Time rx1Delay, const uint8_t* payload, uint8_t size, uint64_t devEui,
+                             Time now)
+{
+    Downlink downlink;
+
+    downlink.time = uplink.time + rx1Delay;
+    if (now <= downlink.time && reserve_gateway(downlink.time)) {
+        rx1(uplink.frequency, uplink.modulation, &downlink.frequency, &downlink.modulation);
+    } else if (now <= downlink.time + kRx2Offset && reserve_gateway(downlink.time + kRx2Offset)) {
+        downlink.time += kRx2Offset;
+        rx2(&downlink.frequency, &downlink.modulation);
+        stats_.rx2_downlinks++;
+    } else {
+        // Both reception windows are over or no gateway is free
+        stats_.missed_downlinks++;
+        return false;
+    }
+    downlink.seq = seq_++;
+    downlink.size = size;
+    std::memcpy(downlink.payload, payload, size);
+    downlink.dev_eui = devEui;
+    downlinks_.push(downlink);
+    return true;
+}
+
+bool NetworkServer::reserve_gateway(Time time)
+{
+    if (config_.gateways == 0) {
+        return true;
+    }
+
+    // Downlinks overlapping [time, time + airtime)
+    auto first = gateway_busy_.upper_bound(time > config_.downlink_airtime ? time - config_.downlink_airtime : 0);
+    auto last = gateway_busy_.lower_bound(time + config_.downlink_airtime);
+    if (static_cast<uint32_t>(std::distance(first, last)) >= config_.gateways) {
+        return false;
+    }
+    gateway_busy_.insert(time);
+    return true;
+}
+
+void NetworkServer::rx1(uint32_t frequency, uint8_t modulation, uint32_t* rx1Frequency, uint8_t* rx1Modulation) const
+{
+    if (config_.plan == ChannelPlan::US915) {
+        uint8_t sf = modulation & 0x0F;
+        uint32_t channel;
+
+        if ((modulation >> 4) == 0) {
+            // 125 kHz uplink channels 0..63
+            channel = (frequency - 902300000) / 200000;
+        } else {
+            // 500 kHz uplink channels 64..71, the RX1 modulation is one step faster
+            channel = 64 + (frequency - 903000000) / 1600000;
+            sf = std::max<uint8_t>(sf - 1, 7);
+        }
+        *rx1Frequency = 923300000 + (channel % 8) * 600000;
+        *rx1Modulation = sim::modulation(sf, 2);
+    } else {
+        *rx1Frequency = frequency;
+        *rx1Modulation = modulation;
+    }
+}
+
+void NetworkServer::rx2(uint32_t* frequency, uint8_t* modulation) const
+{
+    if (config_.plan == ChannelPlan::US915) {
+        // DR8
+        *frequency = 923300000;
+        *modulation = sim::modulation(12, 2);
+    } else {
+        // DR0
+        *frequency = 869525000;
+        *modulation = sim::modulation(12, 0);
+    }
+}
+
+} // namespace sim
@@ -0,0 +1,246 @@
+/*!
+ * \file      network_server.h
+ *
+ * \brief     In-process network server and gateway stand-in
+ *
+ * \details   Consumes the uplinks transmitted on the simulated medium and
+ *            answers them like a LoRaWAN 1.0.x network server would:
+ *            join-requests get a join-accept, data uplinks are
+ *            acknowledged and get MAC commands (LinkAdrReq from the ADR
+ *            algorithm, LinkCheckAns, DeviceTimeAns). Downlinks are sent in
+ *            RX1, or in RX2 when RX1 was missed, at the times the devices
+ *            open their reception windows.
+ *
+ *            Uplinks are queued on reception and handled in process(), so
+ *            the joins received in one step have their session keys
+ *            derived in one pass, see derive_session_keys.
+ *
+ *            With a limited number of gateways a downlink that finds every
+ *            gateway busy in RX1 falls back to RX2, and is dropped when
+ *            RX2 is busy too.
+ */
+#ifndef __SIM_NETWORK_SERVER_H__
+#define __SIM_NETWORK_SERVER_H__
+
+#include <cstdint>
+#include <queue>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "sim/medium.h"
+#include "sim/session_keys.h"
+
+namespace sim {
+
+/*!
+ * Downlink channel plans
+ */
+enum class ChannelPlan {
+    /*!
+     * RX1 on the uplink channel with the uplink modulation (EU868 and alike)
+     */
+    EU868,
+    /*!
+     * RX1 on one of the 8 downlink channels with 500 kHz modulations
+     */
+    US915,
+};
+
+struct NetworkServerConfig {
+    ChannelPlan plan = ChannelPlan::US915;
+    uint32_t net_id = 0x000013;
+    uint32_t dev_addr_base = 0x26000000;
+    /*!
+     * RX1 delay announced in the join-accept [s]
+     */
+    uint8_t rx_delay = 1;
+    /*!
+     * Run the ADR algorithm for devices setting the ADR bit
+     */
+    bool adr = true;
+    /*!
+     * ADR installation margin [dB]
+     */
+    int8_t adr_margin = 10;
+    /*!
+     * Downlink RSSI and SNR seen by the devices
+     */
+    int16_t downlink_rssi = -60;
+    int8_t downlink_snr = 8;
+    /*!
+     * Number of downlinks that can be on the air at the same time, one per
+     * gateway. 0 for no limit.
+     */
+    uint32_t gateways = 0;
+    /*!
+     * Time a downlink keeps a gateway busy [ms]
+     */
+    Time downlink_airtime = 100;
+    /*!
+     * Threads used for the session key derivations
+     */
+    unsigned key_threads = 1;
+};
+
+struct NetworkServerStats {
+    uint64_t uplinks;
+    uint64_t join_requests;
+    /*!
+     * Join-accepts scheduled, the device session is only replaced then
+     */
+    uint64_t joins_accepted;
+    uint64_t joins_rejected;
+    /*!
+     * Valid join-requests whose join-accept found no free gateway
+     */
+    uint64_t joins_dropped;
+    uint64_t data_uplinks;
+    uint64_t mic_failures;
+    uint64_t unknown_devices;
+    uint64_t downlinks;
+    uint64_t rx2_downlinks;
+    uint64_t missed_downlinks;
+    uint64_t link_adr_requests;
+};
+
+class NetworkServer {
+public:
+    NetworkServer(Medium& medium, const NetworkServerConfig& config);
+
+    /*!
+     * \brief Provisions an OTAA device
+     *
+     * \param [IN] devEui  Device EUI
+     * \param [IN] joinEui Join (application) EUI
+     * \param [IN] appKey  Root key of the device
+     */
+    void add_device(uint64_t devEui, uint64_t joinEui, const uint8_t appKey[16]);
+
+    /*!
+     * \brief Handles the uplinks received so far and sends the downlinks
+     *        due until now
+     *
+     * \param [IN] now Current virtual time
+     */
+    void process(Time now);
+
+    /*!
+     * \brief Gets the time of the next scheduled downlink
+     *
+     * \retval Time of the next downlink, kForever if none
+     */
+    Time next_downlink_time() const;
+
+    const NetworkServerStats& stats() const { return stats_; }
+    const NetworkServerConfig& config() const { return config_; }
+
+    /*!
+     * \brief Gets the RX1 channel and modulation for an uplink
+     */
+    void rx1(uint32_t frequency, uint8_t modulation, uint32_t* rx1Frequency, uint8_t* rx1Modulation) const;
+
+    /*!
+     * \brief Gets the RX2 channel and modulation
+     */
+    void rx2(uint32_t* frequency, uint8_t* modulation) const;
+
+private:
+    static constexpr uint8_t kMaxFrameSize = 64;
+    static constexpr uint8_t kAdrHistory = 20;
+
+    struct Device {
+        uint64_t dev_eui;
+        uint64_t join_eui;
+        uint8_t app_key[16];
+        uint8_t nwk_s_key[16];
+        uint8_t app_s_key[16];
+        uint32_t dev_addr;
+        uint32_t join_nonce;
+        uint16_t last_dev_nonce;
+        bool joined;
+        uint32_t fcnt_up;
+        uint32_t fcnt_down;
+        // ADR state
+        int8_t snr_history[kAdrHistory];
+        // Next slot of the history ring, and number of slots filled
+        uint8_t snr_head;
+        uint8_t snr_count;
+        uint8_t datarate;
+        uint8_t tx_power;
+        uint8_t nb_trans;
+        // MAC commands to send with the next downlink
+        uint8_t mac_cmds[15];
+        uint8_t mac_cmds_size;
+    };
+
+    struct Uplink {
+        Time time;
+        uint32_t frequency;
+        uint8_t modulation;
+        int8_t snr;
+        uint8_t size;
+        uint8_t payload[255];
+    };
+
+    struct JoinJob {
+        uint32_t device;
+        uint16_t dev_nonce;
+        Time time;
+        uint32_t frequency;
+        uint8_t modulation;
+        // Session of the join-accept, given to the device once it is scheduled
+        uint32_t join_nonce;
+        uint8_t nwk_s_key[16];
+        uint8_t app_s_key[16];
+    };
+
+    struct Downlink {
+        Time time;
+        uint64_t seq;
+        uint32_t frequency;
+        uint8_t modulation;
+        uint8_t size;
+        uint8_t payload[kMaxFrameSize];
+        // Device a join-accept answers, 0 for data downlinks
+        uint64_t dev_eui;
+    };
+
+    struct DownlinkLater {
+        bool operator()(const Downlink& a, const Downlink& b) const
+        {
+            return (a.time != b.time) ? (a.time > b.time) : (a.seq > b.seq);
+        }
+    };
+
+    static void on_uplink(void* context, const Frame& frame);
+
+    void handle_join_request(const Uplink& uplink);
+    void handle_data_uplink(const Uplink& uplink, Time now);
+    void accept_joins(Time now);
+    void handle_mac_commands(Device& device, const uint8_t* cmds, uint8_t size, Time now);
+    void run_adr(Device& device, const Uplink& uplink);
+    void send_data_downlink(Device& device, const Uplink& uplink, bool ack, Time now);
+    bool schedule(const Uplink& uplink, Time rx1Delay, const uint8_t* payload, uint8_t size, uint64_t devEui,
+                  Time now);
+    bool reserve_gateway(Time time);
+
+    Medium& medium_;
+    NetworkServerConfig config_;
+    NetworkServerStats stats_ = {};
+    std::vector<Device> devices_;
+    std::unordered_map<uint64_t, uint32_t> by_dev_eui_;
+    std::unordered_map<uint32_t, uint32_t> by_dev_addr_;
+    std::vector<Uplink> uplinks_;
+    std::vector<Uplink> processing_;
+    std::vector<JoinJob> joins_;
+    std::vector<SessionKeyJob> key_jobs_;
+    // Start times of the downlinks occupying the gateways
+    std::multiset<Time> gateway_busy_;
+    std::priority_queue<Downlink, std::vector<Downlink>, DownlinkLater> downlinks_;
+    uint64_t seq_ = 0;
+};
+
+} // namespace sim
+
+#endif // __SIM_NETWORK_SERVER_H__
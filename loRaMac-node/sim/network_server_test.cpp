@@ -0,0 +1,229 @@
+/*!
+ * \file      network_server_test.cpp
+ *
+ * \brief     Checks of the network server join and ADR handling, with the
+ *            devices played by the test on the medium
+ */
+#include <cstdio>
+#include <cstring>
+
+#include "aes.h"
+#include "sim/lorawan.h"
+#include "sim/network_server.h"
+
+using namespace sim;
+using namespace sim::lorawan;
+
+namespace {
+
+constexpr uint64_t kJoinEui = 0x70B3D57ED0000000;
+constexpr uint32_t kFrequency = 868100000;
+constexpr uint8_t kModulation = modulation(7, 0);
+
+int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+struct TestDevice {
+    Medium* medium;
+    ListenerId listener;
+    uint64_t dev_eui;
+    uint8_t app_key[16];
+    uint16_t dev_nonce;
+    bool joined;
+    uint32_t dev_addr;
+    uint8_t nwk_s_key[16];
+    uint8_t app_s_key[16];
+    uint32_t fcnt_up;
+    // TXPower of the last LinkAdrReq, -1 if none
+    int tx_power;
+};
+
+void on_rx(void* context, const Frame& frame)
+{
+    TestDevice* device = static_cast<TestDevice*>(context);
+
+    if ((frame.payload[0] >> 5) == kMTypeJoinAccept) {
+        uint8_t payload[kJoinAcceptSize];
+        aes_context aes;
+
+        std::memcpy(payload, frame.payload, kJoinAcceptSize);
+        aes_set_key(device->app_key, 16, &aes);
+        aes_encrypt(&payload[1], &payload[1], &aes);
+        if (cmac(device->app_key, nullptr, payload, kJoinAcceptSize - kMicSize) !=
+            get_le32(&payload[kJoinAcceptSize - kMicSize])) {
+            // Join-accept of another device
+            return;
+        }
+
+        SessionKeyJob job = { device->app_key, get_le32(&payload[1]) & 0xFFFFFF, get_le32(&payload[4]) & 0xFFFFFF,
+                              device->dev_nonce, device->nwk_s_key, device->app_s_key };
+        derive_session_keys(&job, 1, 1);
+        device->joined = true;
+        device->dev_addr = get_le32(&payload[7]);
+        device->fcnt_up = 0;
+        device->medium->set_join_pending(device->listener, false, 0);
+        device->medium->set_address(device->listener, 0, device->dev_addr, true);
+        return;
+    }
+
+    // FOpts of the data downlinks
+    uint8_t fOptsLen = frame.payload[5] & 0x0F;
+    for (uint8_t i = 0; i + 5 <= fOptsLen; i++) {
+        if (frame.payload[8 + i] == 0x03) {
+            device->tx_power = frame.payload[8 + i + 1] & 0x0F;
+            break;
+        }
+    }
+}
+
+void add_device(NetworkServer& ns, Medium& medium, TestDevice& device, uint64_t devEui)
+{
+    device = {};
+    device.medium = &medium;
+    device.dev_eui = devEui;
+    for (uint8_t i = 0; i < 16; i++) {
+        device.app_key[i] = static_cast<uint8_t>(devEui + i);
+    }
+    device.tx_power = -1;
+    ns.add_device(devEui, kJoinEui, device.app_key);
+
+    // Always listening on the uplink channel, the RX1 channel of EU868
+    device.listener = medium.add_listener(on_rx, &device);
+    medium.open_rx_window(device.listener, kFrequency, kModulation, kForever);
+}
+
+void send_join_request(Medium& medium, TestDevice& device, Time now)
+{
+    uint8_t frame[kJoinRequestSize];
+
+    device.dev_nonce++;
+    frame[0] = kMTypeJoinRequest << 5;
+    put_le(&frame[1], kJoinEui, 8);
+    put_le(&frame[9], device.dev_eui, 8);
+    put_le(&frame[17], device.dev_nonce, 2);
+    put_le(&frame[19], cmac(device.app_key, nullptr, frame, kJoinRequestSize - kMicSize), 4);
+
+    medium.set_join_pending(device.listener, true, device.dev_eui);
+    medium.transmit({ kFrequency, kModulation, now, frame, kJoinRequestSize, -80, 0 });
+}
+
+void send_adr_uplink(Medium& medium, TestDevice& device, int8_t snr, Time now)
+{
+    uint8_t frame[12];
+
+    device.fcnt_up++;
+    frame[0] = kMTypeUnconfirmedUp << 5;
+    put_le(&frame[1], device.dev_addr, 4);
+    frame[5] = 0x80; // ADR
+    put_le(&frame[6], device.fcnt_up, 2);
+    put_le(&frame[8], data_mic(device.nwk_s_key, false, device.dev_addr, device.fcnt_up, frame, 8), 4);
+
+    medium.transmit({ kFrequency, kModulation, now, frame, sizeof(frame), -80, snr });
+}
+
+// Processes the uplinks sent at now and delivers the answers
+void run(NetworkServer& ns, Time now)
+{
+    ns.process(now);
+    ns.process(now + kJoinAcceptDelay1 + kRx2Offset);
+}
+
+// The ADR decision follows the SNR of the last 20 uplinks only
+void test_adr_history()
+{
+    Medium medium;
+    NetworkServerConfig config;
+    TestDevice device;
+
+    config.plan = ChannelPlan::EU868;
+    NetworkServer ns(medium, config);
+    add_device(ns, medium, device, 0x0004A30B00000001);
+
+    send_join_request(medium, device, 0);
+    run(ns, 0);
+    CHECK(device.joined);
+
+    // Good link, the power is lowered to the minimum (TXPower 7)
+    Time now = 10000;
+    for (int i = 0; i < 45; i++, now += 10000) {
+        send_adr_uplink(medium, device, 10, now);
+        run(ns, now);
+    }
+    CHECK(device.tx_power == 7);
+    CHECK(ns.stats().mic_failures == 0);
+
+    // Once the good uplinks are out of the history the power is raised again
+    device.tx_power = -1;
+    for (int i = 1; i <= 25; i++, now += 10000) {
+        send_adr_uplink(medium, device, -20, now);
+        run(ns, now);
+        if (i < 20) {
+            CHECK(device.tx_power == -1);
+        } else if (i == 20) {
+            CHECK(device.tx_power == 0);
+        }
+    }
+    CHECK(device.tx_power == 0);
+}
+
+// A join-accept that can not be sent leaves the previous session in place
+void test_dropped_join_accept()
+{
+    Medium medium;
+    NetworkServerConfig config;
+    TestDevice devices[3];
+
+    config.plan = ChannelPlan::EU868;
+    config.gateways = 1;
+    NetworkServer ns(medium, config);
+    for (uint8_t i = 0; i < 3; i++) {
+        add_device(ns, medium, devices[i], 0x0004A30B00000010 + i);
+    }
+
+    send_join_request(medium, devices[0], 0);
+    run(ns, 0);
+    CHECK(devices[0].joined);
+    CHECK(ns.stats().joins_accepted == 1);
+
+    // Devices 1 and 2 take RX1 and RX2 of the only gateway, the join-accept
+    // of device 0 joining again is dropped
+    send_join_request(medium, devices[1], 100000);
+    send_join_request(medium, devices[2], 100000);
+    send_join_request(medium, devices[0], 100000);
+    run(ns, 100000);
+    CHECK(devices[1].joined);
+    CHECK(ns.stats().joins_accepted == 3);
+    CHECK(ns.stats().rx2_downlinks == 1);
+    CHECK(ns.stats().joins_dropped == 1);
+    // Each join-accept only reaches the device it answers, and nobody
+    // listens in RX2
+    CHECK(medium.stats().deliveries == 2);
+
+    // Device 0 still uses the session of its first join
+    send_adr_uplink(medium, devices[0], 0, 200000);
+    run(ns, 200000);
+    CHECK(ns.stats().data_uplinks == 1);
+    CHECK(ns.stats().mic_failures == 0);
+}
+
+} // namespace
+
+int main()
+{
+    test_adr_history();
+    test_dropped_join_accept();
+
+    if (failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("network_server_test: OK\n");
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "sim/replay.h"
+
+namespace sim {
+
+namespace {
+
+// Buffered events, written out by flush() or when full
+constexpr size_t kBufferSize = 64 * 1024;
+
+} // namespace
+
+ReplayRecorder::~ReplayRecorder()
+{
+    close();
+}
+
+bool ReplayRecorder::open(const std::string& path, const ReplaySetup& setup)
+{
+    ReplayFileHeader header = {};
+
+    close();
+
+    file_ = fopen(path.c_str(), "wb");
+    if (file_ == nullptr) {
+        return false;
+    }
+    setvbuf(file_, nullptr, _IOFBF, kBufferSize);
+    events_ = 0;
+
+    header.magic = kReplayMagic;
+    header.version = kReplayVersion;
+    header.event_size = sizeof(ReplayEvent);
+    header.setup = setup;
+    if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ReplayRecorder::close()
+{
+    if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void ReplayRecorder::flush()
+{
+    if (file_ != nullptr) {
+        fflush(file_);
+    }
+}
+
+void ReplayRecorder::record(Time time, ReplayEventType type, const uint8_t* payload, uint8_t size,
+                            uint8_t port, bool confirmed, int16_t rssi, int8_t snr)
+{
+    static const uint8_t padding[8] = {};
+    ReplayEvent event = {};
+
+    if (file_ == nullptr) {
+        return;
+    }
+
+    event.time = time;
+    event.type = type;
+    event.port = port;
+    event.confirmed = confirmed;
+    event.size = (payload != nullptr) ? size : 0;
+    event.rssi = rssi;
+    event.snr = snr;
+
+    fwrite(&event, sizeof(event), 1, file_);
+    if (event.size > 0) {
+        fwrite(payload, event.size, 1, file_);
+    }
+    fwrite(padding, replay_event_size(event.size) - sizeof(event) - event.size, 1, file_);
+    events_++;
+}
+
+ReplayReader::~ReplayReader()
+{
+    close();
+}
+
+bool ReplayReader::open(const std::string& path)
+{
+    ReplayFileHeader header;
+
+    close();
+
+    file_ = fopen(path.c_str(), "rb");
+    if (file_ == nullptr) {
+        return false;
+    }
+    if (fread(&header, sizeof(header), 1, file_) != 1 || header.magic != kReplayMagic ||
+        header.version != kReplayVersion || header.event_size != sizeof(ReplayEvent)) {
+        close();
+        return false;
+    }
+    setup_ = header.setup;
+    return true;
+}
+
+void ReplayReader::close()
+{
+    if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool ReplayReader::next(ReplayEvent* event, const uint8_t** payload)
+{
+    if (file_ == nullptr || fread(event, sizeof(*event), 1, file_) != 1) {
+        return false;
+    }
+
+    size_t size = replay_event_size(event->size) - sizeof(*event);
+    if (size > 0 && fread(payload_, size, 1, file_) != 1) {
+        return false;
+    }
+    *payload = payload_;
+    return true;
+}
+
+} // namespace sim
@@ -0,0 +1,210 @@
+/*!
+ * \file      replay.h
+ *
+ * \brief     Input log of a simulated device, for deterministic replay
+ *
+ * \details   With the virtual clock and the per-device random generator,
+ *            the MAC state of a device only depends on its setup and on
+ *            its inputs: the application requests (LmHandlerJoin,
+ *            LmHandlerSend) and the radio outcomes (TxDone, RxDone with the
+ *            received frame, timeouts), each at a virtual time.
+ *
+ *            The recorder logs these inputs as they happen; the radio logs
+ *            its outcomes, see RadioAttachRecorder, and the application
+ *            logs its requests before making them:
+ *                recorder.record(TimerGetCurrentTime(), sim::ReplayEventType::send,
+ *                                appData.Buffer, appData.BufferSize, appData.Port, confirmed);
+ *                LmHandlerSend(&appData, confirmed);
+ *
+ *            A replay feeds the log back to a fresh stack, without a medium
+ *            and without the other devices of the fleet: they only ever
+ *            reached the device through the logged radio outcomes. Between
+ *            two inputs the replay jumps from timer deadline to timer
+ *            deadline, so idle virtual time costs nothing.
+ *
+ *            File layout:
+ *                ReplayFileHeader
+ *                { ReplayEvent payload padding }...
+ */
+#ifndef __SIM_REPLAY_H__
+#define __SIM_REPLAY_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "sim/medium.h"
+
+namespace sim {
+
+// "LWRP"
+constexpr uint32_t kReplayMagic = 0x5052574C;
+constexpr uint16_t kReplayVersion = 1;
+
+enum class ReplayEventType : uint8_t {
+    /*!
+     * LmHandlerJoin
+     */
+    join,
+    /*!
+     * LmHandlerSend, the payload is the application data
+     */
+    send,
+    tx_done,
+    tx_timeout,
+    /*!
+     * Frame handed to the MAC, the payload is the PHYPayload
+     */
+    rx_done,
+    rx_timeout,
+};
+
+/*!
+ * Device parameters the inputs were recorded with. The replay sets up the
+ * stack the same way.
+ */
+struct ReplaySetup {
+    uint64_t dev_eui;
+    /*!
+     * Simulation master seed, see RadioSetRandomSeed
+     */
+    uint64_t seed;
+    /*!
+     * Virtual time the recording started at
+     */
+    Time start;
+    /*!
+     * LmHandlerParams_t
+     */
+    uint8_t region;
+    uint8_t adr;
+    int8_t datarate;
+    uint8_t duty_cycle;
+    uint8_t public_network;
+    uint8_t reserved[3];
+};
+
+struct ReplayFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t event_size;
+    ReplaySetup setup;
+};
+
+/*!
+ * Input event, followed by its payload padded to 8 bytes
+ */
+struct ReplayEvent {
+    Time time;
+    ReplayEventType type;
+    /*!
+     * Port and confirmation of send events
+     */
+    uint8_t port;
+    uint8_t confirmed;
+    uint8_t size;
+    /*!
+     * Reception quality of rx_done events
+     */
+    int16_t rssi;
+    int8_t snr;
+    uint8_t reserved;
+};
+
+/*!
+ * \brief Size of an event with its payload in the log
+ */
+constexpr size_t replay_event_size(uint8_t payloadSize)
+{
+    return (sizeof(ReplayEvent) + payloadSize + 7) & ~static_cast<size_t>(7);
+}
+
+class ReplayRecorder {
+public:
+    ReplayRecorder() = default;
+    ~ReplayRecorder();
+
+    ReplayRecorder(const ReplayRecorder&) = delete;
+    ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+
+    /*!
+     * \brief Creates an input log
+     *
+     * \param [IN] path  Log file
+     * \param [IN] setup Device parameters
+     * \retval true on success
+     */
+    bool open(const std::string& path, const ReplaySetup& setup);
+
+    /*!
+     * \brief Writes out the buffered events and closes the file
+     */
+    void close();
+
+    /*!
+     * \brief Writes out the buffered events, e.g. before aborting on a MAC
+     *        failure
+     */
+    void flush();
+
+    /*!
+     * \brief Records an input
+     *
+     * \param [IN] time    Virtual time of the input
+     * \param [IN] type    Input
+     * \param [IN] payload Application data or PHYPayload, NULL if none
+     * \param [IN] size    Payload size
+     * \param [IN] port    Port of send events
+     * \param [IN] confirmed Confirmation of send events
+     * \param [IN] rssi    Reception quality of rx_done events
+     * \param [IN] snr     Reception quality of rx_done events
+     */
+    void record(Time time, ReplayEventType type, const uint8_t* payload = nullptr, uint8_t size = 0,
+                uint8_t port = 0, bool confirmed = false, int16_t rssi = 0, int8_t snr = 0);
+
+    uint64_t events() const { return events_; }
+
+private:
+    FILE* file_ = nullptr;
+    uint64_t events_ = 0;
+};
+
+class ReplayReader {
+public:
+    ReplayReader() = default;
+    ~ReplayReader();
+
+    ReplayReader(const ReplayReader&) = delete;
+    ReplayReader& operator=(const ReplayReader&) = delete;
+
+    /*!
+     * \brief Opens an input log
+     *
+     * \retval false if the file is not a readable log
+     */
+    bool open(const std::string& path);
+
+    void close();
+
+    const ReplaySetup& setup() const { return setup_; }
+
+    /*!
+     * \brief Reads the next event. A log cut short by a crash ends with a
+     *        partial event, which is dropped.
+     *
+     * \param [OUT] event   Event
+     * \param [OUT] payload Payload of the event, valid until the next call
+     * \retval false at the end of the log
+     */
+    bool next(ReplayEvent* event, const uint8_t** payload);
+
+private:
+    FILE* file_ = nullptr;
+    ReplaySetup setup_ = {};
+    uint8_t payload_[replay_event_size(UINT8_MAX) - sizeof(ReplayEvent)];
+};
+
+} // namespace sim
+
+#endif // __SIM_REPLAY_H__
@@ -0,0 +1,77 @@
+#include "sim/session_keys.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "aes.h"
+
+namespace sim {
+
+namespace {
+
+// Jobs whose key schedules are expanded together, about 15 kB of schedules
+constexpr size_t kBatchSize = 64;
+
+// Below this number of jobs per thread, starting threads costs more than it saves
+constexpr size_t kMinJobsPerThread = 256;
+
+void derive_range(const SessionKeyJob* jobs, size_t count)
+{
+    aes_context ctx[kBatchSize];
+    uint8_t block[kBatchSize][16];
+
+    for (size_t first = 0; first < count; first += kBatchSize) {
+        size_t n = std::min(kBatchSize, count - first);
+        const SessionKeyJob* batch = &jobs[first];
+
+        for (size_t i = 0; i < n; i++) {
+            aes_set_key(batch[i].root_key, 16, &ctx[i]);
+
+            // 0x0? | JoinNonce | NetID | DevNonce | pad16
+            std::fill(block[i], block[i] + 16, 0);
+            block[i][1] = static_cast<uint8_t>(batch[i].join_nonce);
+            block[i][2] = static_cast<uint8_t>(batch[i].join_nonce >> 8);
+            block[i][3] = static_cast<uint8_t>(batch[i].join_nonce >> 16);
+            block[i][4] = static_cast<uint8_t>(batch[i].net_id);
+            block[i][5] = static_cast<uint8_t>(batch[i].net_id >> 8);
+            block[i][6] = static_cast<uint8_t>(batch[i].net_id >> 16);
+            block[i][7] = static_cast<uint8_t>(batch[i].dev_nonce);
+            block[i][8] = static_cast<uint8_t>(batch[i].dev_nonce >> 8);
+        }
+        for (size_t i = 0; i < n; i++) {
+            block[i][0] = 0x01;
+            aes_encrypt(block[i], batch[i].nwk_s_key, &ctx[i]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            block[i][0] = 0x02;
+            aes_encrypt(block[i], batch[i].app_s_key, &ctx[i]);
+        }
+    }
+}
+
+} // namespace
+
+void derive_session_keys(const SessionKeyJob* jobs, size_t count, unsigned threads)
+{
+    size_t workers = std::min<size_t>(std::max(threads, 1u), count / kMinJobsPerThread);
+
+    if (workers <= 1) {
+        derive_range(jobs, count);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    size_t share = (count + workers - 1) / workers;
+
+    // The calling thread takes the first share
+    for (size_t first = share; first < count; first += share) {
+        pool.emplace_back(derive_range, &jobs[first], std::min(share, count - first));
+    }
+    derive_range(jobs, share);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
+
+} // namespace sim
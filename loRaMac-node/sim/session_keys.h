@@ -0,0 +1,52 @@
+/*!
+ * \file      session_keys.h
+ *
+ * \brief     Batched LoRaWAN 1.0.x session key derivation
+ *
+ * \details   A join costs three AES key expansions and two block encryptions
+ *            per device for the session keys alone. When a whole fleet joins
+ *            at once the derivations of one simulation step are collected
+ *            and run in one pass: the key schedules of a batch are expanded
+ *            first, then the NwkSKey blocks and the AppSKey blocks are
+ *            encrypted. Large batches are split across threads.
+ */
+#ifndef __SIM_SESSION_KEYS_H__
+#define __SIM_SESSION_KEYS_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sim {
+
+/*!
+ * Session key derivation of one join
+ */
+struct SessionKeyJob {
+    /*!
+     * AppKey of the device
+     */
+    const uint8_t* root_key;
+    uint32_t join_nonce;
+    uint32_t net_id;
+    uint16_t dev_nonce;
+    /*!
+     * Derived keys, 16 bytes each
+     */
+    uint8_t* nwk_s_key;
+    uint8_t* app_s_key;
+};
+
+/*!
+ * \brief Derives the session keys of a batch of joins
+ *
+ *        keys = aes128_encrypt( AppKey, 0x01 | 0x02 | JoinNonce | NetID | DevNonce | pad16 )
+ *
+ * \param [IN] jobs    Derivations to run
+ * \param [IN] count   Number of derivations
+ * \param [IN] threads Maximum number of threads to use
+ */
+void derive_session_keys(const SessionKeyJob* jobs, size_t count, unsigned threads);
+
+} // namespace sim
+
+#endif // __SIM_SESSION_KEYS_H__
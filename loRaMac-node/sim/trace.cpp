@@ -0,0 +1,296 @@
+#include "sim/trace.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace sim {
+
+namespace {
+
+// The file grows by mapped chunks of this size
+constexpr size_t kMapChunk = 64 * 1024 * 1024;
+
+// LoRaWAN MHDR message types with a DevAddr after the MHDR
+constexpr uint8_t kMTypeUnconfirmedUp = 0x02;
+constexpr uint8_t kMTypeConfirmedDown = 0x05;
+
+uint32_t frame_dev_addr(const Frame& frame)
+{
+    if (frame.size < 5) {
+        return 0;
+    }
+
+    uint8_t mType = frame.payload[0] >> 5;
+    if (mType < kMTypeUnconfirmedUp || mType > kMTypeConfirmedDown) {
+        return 0;
+    }
+    return static_cast<uint32_t>(frame.payload[1]) | (static_cast<uint32_t>(frame.payload[2]) << 8) |
+           (static_cast<uint32_t>(frame.payload[3]) << 16) | (static_cast<uint32_t>(frame.payload[4]) << 24);
+}
+
+} // namespace
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const std::string& path, size_t blockSize)
+{
+    TraceFileHeader header = {};
+
+    close();
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    block_size_ = std::max(blockSize, sizeof(TraceBlockHeader) + trace_record_size(UINT8_MAX));
+    block_.assign(block_size_, 0);
+    full_.assign(block_size_, 0);
+    block_used_ = sizeof(TraceBlockHeader);
+    block_header_ = {};
+    frames_ = 0;
+
+    map_ = nullptr;
+    map_offset_ = 0;
+    map_size_ = 0;
+    map_used_ = 0;
+    file_size_ = 0;
+
+    header.magic = kTraceMagic;
+    header.version = kTraceVersion;
+    header.block_header_size = sizeof(TraceBlockHeader);
+    header.record_size = sizeof(TraceRecord);
+    if (!append(reinterpret_cast<const uint8_t*>(&header), sizeof(header))) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    stopping_ = false;
+    full_pending_ = false;
+    thread_ = std::thread(&TraceWriter::run, this);
+    return true;
+}
+
+void TraceWriter::close()
+{
+    if (fd_ < 0) {
+        return;
+    }
+
+    flush_block();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+    if (map_ != nullptr) {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+    // Drop the unused end of the last chunk, a reader stops at it anyway
+    int rc = ftruncate(fd_, file_size_);
+    (void)rc;
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void TraceWriter::record(TraceDirection direction, uint64_t devEui, const Frame& frame)
+{
+    size_t size = trace_record_size(frame.size);
+
+    if (fd_ < 0) {
+        return;
+    }
+    if (block_used_ + size > block_size_) {
+        flush_block();
+    }
+
+    TraceRecord* record = reinterpret_cast<TraceRecord*>(&block_[block_used_]);
+    record->time = frame.time;
+    record->dev_eui = devEui;
+    record->dev_addr = frame_dev_addr(frame);
+    record->frequency = frame.frequency;
+    record->rssi = frame.rssi;
+    record->snr = frame.snr;
+    record->modulation = frame.modulation;
+    record->direction = direction;
+    record->size = frame.size;
+    record->reserved = 0;
+    std::memcpy(record + 1, frame.payload, frame.size);
+    std::memset(reinterpret_cast<uint8_t*>(record + 1) + frame.size, 0, size - sizeof(TraceRecord) - frame.size);
+
+    if (block_header_.records == 0) {
+        block_header_.first_time = frame.time;
+        block_header_.last_time = frame.time;
+    }
+    // Downlinks are scheduled ahead, keep the true range of the block
+    block_header_.first_time = std::min(block_header_.first_time, frame.time);
+    block_header_.last_time = std::max(block_header_.last_time, frame.time);
+    block_header_.records++;
+    block_used_ += size;
+    frames_++;
+}
+
+void TraceWriter::flush_block()
+{
+    if (block_header_.records == 0) {
+        return;
+    }
+
+    block_header_.size = static_cast<uint32_t>(block_used_);
+    std::memcpy(block_.data(), &block_header_, sizeof(block_header_));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Only waits when the writer thread is a whole block behind
+    cv_.wait(lock, [this] { return !full_pending_; });
+    block_.swap(full_);
+    full_used_ = block_used_;
+    full_pending_ = true;
+    lock.unlock();
+    cv_.notify_all();
+
+    block_used_ = sizeof(TraceBlockHeader);
+    block_header_ = {};
+}
+
+void TraceWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        cv_.wait(lock, [this] { return full_pending_ || stopping_; });
+        if (!full_pending_) {
+            break;
+        }
+
+        // The recording thread only touches full_ again once it is released
+        lock.unlock();
+        append(full_.data(), full_used_);
+        lock.lock();
+
+        full_pending_ = false;
+        cv_.notify_all();
+    }
+}
+
+bool TraceWriter::append(const uint8_t* data, size_t size)
+{
+    while (size > 0) {
+        if (map_ == nullptr || map_used_ == map_size_) {
+            if (map_ != nullptr) {
+                munmap(map_, map_size_);
+                map_offset_ += map_size_;
+                map_ = nullptr;
+            }
+            if (ftruncate(fd_, map_offset_ + kMapChunk) != 0) {
+                return false;
+            }
+            void* map = mmap(nullptr, kMapChunk, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, map_offset_);
+            if (map == MAP_FAILED) {
+                return false;
+            }
+            map_ = static_cast<uint8_t*>(map);
+            map_size_ = kMapChunk;
+            map_used_ = 0;
+        }
+
+        size_t n = std::min(size, map_size_ - map_used_);
+        std::memcpy(map_ + map_used_, data, n);
+        map_used_ += n;
+        file_size_ += n;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool read_trace(const std::string& path, Time from, Time to,
+                const std::function<void(const TraceRecord&, const uint8_t*)>& handler)
+{
+    struct stat st;
+    TraceFileHeader header;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(header)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    const uint8_t* base = static_cast<const uint8_t*>(map);
+    const uint8_t* end = base + st.st_size;
+    bool ok = true;
+
+    std::memcpy(&header, base, sizeof(header));
+    if (header.magic != kTraceMagic || header.version != kTraceVersion ||
+        header.block_header_size != sizeof(TraceBlockHeader) || header.record_size != sizeof(TraceRecord)) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    for (const uint8_t* p = base + sizeof(header); p < end;) {
+        TraceBlockHeader block;
+
+        if (static_cast<size_t>(end - p) < sizeof(block)) {
+            ok = false;
+            break;
+        }
+        std::memcpy(&block, p, sizeof(block));
+        if (block.size == 0) {
+            // Unused end of the last chunk, the writer was not closed
+            break;
+        }
+        if (block.size < sizeof(block) || block.size > static_cast<size_t>(end - p)) {
+            ok = false;
+            break;
+        }
+
+        if (block.last_time >= from && block.first_time <= to) {
+            const uint8_t* r = p + sizeof(block);
+            const uint8_t* blockEnd = p + block.size;
+            for (uint32_t i = 0; i < block.records; i++) {
+                // A corrupt record count or payload size must not read past the block
+                if (static_cast<size_t>(blockEnd - r) < sizeof(TraceRecord)) {
+                    ok = false;
+                    break;
+                }
+                const TraceRecord* record = reinterpret_cast<const TraceRecord*>(r);
+                if (trace_record_size(record->size) > static_cast<size_t>(blockEnd - r)) {
+                    ok = false;
+                    break;
+                }
+                handler(*record, reinterpret_cast<const uint8_t*>(record + 1));
+                r += trace_record_size(record->size);
+            }
+            if (!ok) {
+                break;
+            }
+        }
+        p += block.size;
+    }
+
+    munmap(map, st.st_size);
+    return ok;
+}
+
+} // namespace sim
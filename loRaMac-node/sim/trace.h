@@ -0,0 +1,177 @@
+/*!
+ * \file      trace.h
+ *
+ * \brief     Packet trace of the simulated radio
+ *
+ * \details   Every uplink sent and downlink received by a simulated radio is
+ *            recorded with its virtual timestamp, the device EUI, the
+ *            channel and the PHYPayload, see RadioAttachTrace.
+ *
+ *            The trace is an append-only file of blocks. The radio appends
+ *            records to an in-memory block; a full block is handed to a
+ *            background thread that copies it into the memory mapped file,
+ *            so tracing does not stall the simulation on I/O.
+ *
+ *            Each block header holds the time range of its records, a
+ *            reader looking for a time range skips the other blocks without
+ *            reading them.
+ *
+ *            File layout:
+ *                TraceFileHeader
+ *                { TraceBlockHeader { TraceRecord payload padding }... }...
+ */
+#ifndef __SIM_TRACE_H__
+#define __SIM_TRACE_H__
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sim/medium.h"
+
+namespace sim {
+
+// "LWTR"
+constexpr uint32_t kTraceMagic = 0x5254574C;
+constexpr uint16_t kTraceVersion = 1;
+
+enum class TraceDirection : uint8_t {
+    uplink,
+    downlink,
+};
+
+struct TraceFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t block_header_size;
+    uint32_t record_size;
+};
+
+struct TraceBlockHeader {
+    /*!
+     * Size of the block, header included [bytes]
+     */
+    uint32_t size;
+    uint32_t records;
+    Time first_time;
+    Time last_time;
+};
+
+/*!
+ * Frame record, followed by the PHYPayload padded to 8 bytes
+ */
+struct TraceRecord {
+    Time time;
+    uint64_t dev_eui;
+    /*!
+     * DevAddr of data frames, 0 for join frames
+     */
+    uint32_t dev_addr;
+    uint32_t frequency;
+    int16_t rssi;
+    int8_t snr;
+    /*!
+     * Spreading factor and bandwidth, see sim::modulation
+     */
+    uint8_t modulation;
+    TraceDirection direction;
+    uint8_t size;
+    uint16_t reserved;
+};
+
+/*!
+ * \brief Size of a record with its payload in the trace
+ */
+constexpr size_t trace_record_size(uint8_t payloadSize)
+{
+    return (sizeof(TraceRecord) + payloadSize + 7) & ~static_cast<size_t>(7);
+}
+
+class TraceWriter {
+public:
+    TraceWriter() = default;
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    /*!
+     * \brief Creates a trace file and starts the writer thread
+     *
+     * \param [IN] path      Trace file
+     * \param [IN] blockSize Size of the in-memory blocks [bytes]
+     * \retval true on success
+     */
+    bool open(const std::string& path, size_t blockSize = 1024 * 1024);
+
+    /*!
+     * \brief Writes out the pending records and closes the file
+     */
+    void close();
+
+    /*!
+     * \brief Records a frame
+     *
+     * \param [IN] direction Uplink or downlink
+     * \param [IN] devEui    Device the frame was sent or received by
+     * \param [IN] frame     Frame on the air
+     */
+    void record(TraceDirection direction, uint64_t devEui, const Frame& frame);
+
+    uint64_t frames() const { return frames_; }
+
+private:
+    void flush_block();
+    void run();
+    bool append(const uint8_t* data, size_t size);
+
+    int fd_ = -1;
+    size_t block_size_ = 0;
+    uint64_t frames_ = 0;
+
+    // Block being filled by record()
+    std::vector<uint8_t> block_;
+    size_t block_used_ = 0;
+    TraceBlockHeader block_header_ = {};
+
+    // Block handed to the writer thread
+    std::vector<uint8_t> full_;
+    size_t full_used_ = 0;
+    bool full_pending_ = false;
+    bool stopping_ = false;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+
+    // Mapped end of the file, grown by whole chunks
+    uint8_t* map_ = nullptr;
+    size_t map_offset_ = 0;
+    size_t map_size_ = 0;
+    size_t map_used_ = 0;
+    size_t file_size_ = 0;
+};
+
+/*!
+ * \brief Reads the records of a trace file
+ *
+ * \param [IN] path    Trace file
+ * \param [IN] from    Skip the blocks ending before [ms]
+ * \param [IN] to      Skip the blocks starting after [ms]
+ * \param [IN] handler Called for each record of the blocks read, with its
+ *                     payload
+ * \retval false if the file is not a readable trace or is corrupt, e.g. a
+ *         block whose records overrun it. The records before the
+ *         corruption are handed to the handler.
+ */
+bool read_trace(const std::string& path, Time from, Time to,
+                const std::function<void(const TraceRecord&, const uint8_t*)>& handler);
+
+} // namespace sim
+
+#endif // __SIM_TRACE_H__
@@ -0,0 +1,194 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/program_options.hpp>
+
+#include "sim/trace.h"
+
+namespace po = boost::program_options;
+
+using namespace std;
+
+namespace {
+
+// LINKTYPE_LORATAP
+constexpr uint32_t kPcapLinkType = 270;
+constexpr uint16_t kLoRaTapHeaderSize = 15;
+// LoRaWAN public network sync word
+constexpr uint8_t kSyncWord = 0x34;
+
+void put_be(uint8_t* p, uint32_t value, int size)
+{
+    for (int i = size - 1; i >= 0; i--) {
+        p[i] = static_cast<uint8_t>(value);
+        value >>= 8;
+    }
+}
+
+class PcapWriter {
+public:
+    bool open(const string& path)
+    {
+        file_ = fopen(path.c_str(), "wb");
+        if (file_ == nullptr) {
+            return false;
+        }
+
+        uint32_t header[6] = { 0xA1B2C3D4, 0x00040002, 0, 0, 65535, kPcapLinkType };
+        return fwrite(header, sizeof(header), 1, file_) == 1;
+    }
+
+    void close()
+    {
+        if (file_ != nullptr) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+    void write(const sim::TraceRecord& record, const uint8_t* payload)
+    {
+        static const uint8_t bandwidths[] = { 1, 2, 4, 0 };
+        uint32_t packet[4];
+        uint8_t tap[kLoRaTapHeaderSize] = {};
+        int rssi = record.rssi + 139;
+
+        // Virtual time
+        packet[0] = static_cast<uint32_t>(record.time / 1000);
+        packet[1] = static_cast<uint32_t>(record.time % 1000) * 1000;
+        packet[2] = kLoRaTapHeaderSize + record.size;
+        packet[3] = packet[2];
+
+        // LoRaTap version 0
+        put_be(&tap[2], kLoRaTapHeaderSize, 2);
+        put_be(&tap[4], record.frequency, 4);
+        tap[8] = bandwidths[(record.modulation >> 4) & 0x03];
+        tap[9] = record.modulation & 0x0F;
+        tap[10] = tap[11] = tap[12] = static_cast<uint8_t>(rssi < 0 ? 0 : (rssi > 255 ? 255 : rssi));
+        tap[13] = static_cast<uint8_t>(record.snr * 4);
+        tap[14] = kSyncWord;
+
+        fwrite(packet, sizeof(packet), 1, file_);
+        fwrite(tap, sizeof(tap), 1, file_);
+        fwrite(payload, record.size, 1, file_);
+    }
+
+private:
+    FILE* file_ = nullptr;
+};
+
+void print(const sim::TraceRecord& record, const uint8_t* payload)
+{
+    static const char* const bandwidths[] = { "125", "250", "500", "?" };
+    char line[640];
+    int n = snprintf(line, sizeof(line), "%12llu %s %016llx %08x %9u SF%u/%s %4d %3d %3u ",
+                     static_cast<unsigned long long>(record.time),
+                     record.direction == sim::TraceDirection::uplink ? "up  " : "down",
+                     static_cast<unsigned long long>(record.dev_eui), record.dev_addr, record.frequency,
+                     record.modulation & 0x0F, bandwidths[(record.modulation >> 4) & 0x03],
+                     record.rssi, record.snr, record.size);
+
+    for (uint8_t i = 0; i < record.size; i++) {
+        n += snprintf(line + n, sizeof(line) - n, "%02x", payload[i]);
+    }
+    puts(line);
+}
+
+} // namespace
+
+int main(int ac, char* av[])
+{
+    po::variables_map vm;
+    vector<string> files;
+    sim::Time from = 0;
+    sim::Time to = UINT64_MAX;
+
+    try {
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h", "Help screen")
+            ("trace", po::value<vector<string>>(&files), "Trace files")
+            ("dev-addr", po::value<string>(), "Only the frames of this DevAddr, hex")
+            ("dev-eui", po::value<string>(), "Only the frames of this DevEUI, hex")
+            ("from", po::value<sim::Time>(&from), "Only the frames sent at or after [ms]")
+            ("to", po::value<sim::Time>(&to), "Only the frames sent at or before [ms]")
+            ("direction", po::value<string>(), "Only the uplinks (up) or the downlinks (down)")
+            ("pcap", po::value<string>(), "Write the frames to a pcap file (LoRaTap) instead of printing them")
+            ("count", "Only count the frames");
+
+        po::positional_options_description positional;
+        positional.add("trace", -1);
+
+        po::store(po::command_line_parser(ac, av).options(desc).positional(positional).run(), vm);
+        po::notify(vm);
+
+        if (vm.count("help") || files.empty()) {
+            cout << "Usage: trace_dump [options] trace...\n" << desc << "\n";
+            return 1;
+        }
+    }
+    catch(exception& e) {
+        cerr << "error: " << e.what() << "\n";
+        return 1;
+    }
+
+    bool byDevAddr = vm.count("dev-addr") > 0;
+    uint32_t devAddr = byDevAddr ? stoul(vm["dev-addr"].as<string>(), nullptr, 16) : 0;
+    bool byDevEui = vm.count("dev-eui") > 0;
+    uint64_t devEui = byDevEui ? stoull(vm["dev-eui"].as<string>(), nullptr, 16) : 0;
+    bool byDirection = vm.count("direction") > 0;
+    sim::TraceDirection direction = sim::TraceDirection::uplink;
+    bool count = vm.count("count") > 0;
+    uint64_t frames = 0;
+    PcapWriter pcap;
+
+    if (byDirection) {
+        if (vm["direction"].as<string>() == "down") {
+            direction = sim::TraceDirection::downlink;
+        }
+        else if (vm["direction"].as<string>() != "up") {
+            cerr << "Direction is up or down\n";
+            return 1;
+        }
+    }
+    if (vm.count("pcap") && !pcap.open(vm["pcap"].as<string>())) {
+        cerr << "Can not create " << vm["pcap"].as<string>() << "\n";
+        return 1;
+    }
+    bool toPcap = vm.count("pcap") > 0;
+
+    auto handler = [&](const sim::TraceRecord& record, const uint8_t* payload) {
+        // Blocks overlapping the range also hold frames outside of it
+        if (record.time < from || record.time > to ||
+            (byDevAddr && record.dev_addr != devAddr) ||
+            (byDevEui && record.dev_eui != devEui) ||
+            (byDirection && record.direction != direction)) {
+            return;
+        }
+        frames++;
+        if (count) {
+            return;
+        }
+        if (toPcap) {
+            pcap.write(record, payload);
+        }
+        else {
+            print(record, payload);
+        }
+    };
+
+    int status = 0;
+    for (const string& file : files) {
+        if (!sim::read_trace(file, from, to, handler)) {
+            cerr << file << ": not a trace, truncated or corrupt\n";
+            status = 2;
+        }
+    }
+    pcap.close();
+
+    if (count || toPcap) {
+        cout << frames << " frames\n";
+    }
+    return status;
+}
@@ -0,0 +1,25 @@
+/*!
+ * \file      board.c
+ *
+ * \brief     Host board implementation
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ */
+#include <stdint.h>
+#include "utilities.h"
+#include "board.h"
+
+/*
+ * The host has no interrupts: the radio and timer events are raised from
+ * the thread running the MAC, so the critical sections have nothing to
+ * mask.
+ */
+void BoardCriticalSectionBegin( uint32_t *mask )
+{
+    *mask = 0;
+}
+
+void BoardCriticalSectionEnd( uint32_t *mask )
+{
+    ( void )mask;
+}
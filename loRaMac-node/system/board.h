@@ -0,0 +1,29 @@
+/*!
+ * \file      board.h
+ *
+ * \brief     Host board definitions
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ */
+#ifndef __BOARD_H__
+#define __BOARD_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/*!
+ * No operation, stands in for the CMSIS intrinsic used by busy wait loops
+ */
+static inline void __NOP( void )
+{
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __BOARD_H__
@@ -24,6 +24,7 @@
  */
 #include <math.h>
 #include <time.h>
+#include "board.h"
 #include "timer.h"
 #include "rtc.h"
 
@@ -73,6 +74,16 @@ typedef struct
     // RTC_DateTypeDef CalendarDate; // Reference date in calendar format
 }RtcTimerContext_t;
 
+/*!
+ * Keep the value of the RTC timer when the RTC alarm is set
+ */
+static RtcTimerContext_t RtcTimerContext;
+
+/*!
+ * Virtual RTC counter of the hosted device, driven by the simulation
+ */
+static uint32_t RtcTimerValue = 0;
+
 /*!
  * Number of days in each month on a normal year
  */
@@ -122,6 +133,8 @@ void RtcInit( void )
  */
 uint32_t RtcSetTimerContext( void )
 {
+    RtcTimerContext.Time = RtcTimerValue;
+    return RtcTimerContext.Time;
 #if 0
     RtcTimerContext.Time = ( uint32_t )RtcGetCalendarValue( &RtcTimerContext.CalendarDate, &RtcTimerContext.CalendarTime );
     return ( uint32_t )RtcTimerContext.Time;
@@ -136,10 +149,7 @@ uint32_t RtcSetTimerContext( void )
  */
 uint32_t RtcGetTimerContext( void )
 {
-#if 0
     return RtcTimerContext.Time;
-#endif
-    return 0;
 }
 
 /*!
@@ -160,7 +170,8 @@ uint32_t RtcGetMinimumTimeout( void )
  */
 uint32_t RtcMs2Tick( uint32_t milliseconds )
 {
-    return ( uint32_t )( ( ( ( uint64_t )milliseconds ) * CONV_DENOM ) / CONV_NUMER );
+    // The virtual RTC counts milliseconds, like RtcTick2Ms assumes
+    return milliseconds;
 }
 
 /*!
@@ -306,7 +317,7 @@ void RtcStartAlarm( uint32_t timeout )
 
 uint32_t RtcGetTimerValue( void )
 {
-    return 0;
+    return RtcTimerValue;
 #if 0
     RTC_DateTypeDef date;
 
@@ -318,7 +329,7 @@ uint32_t RtcGetTimerValue( void )
 
 uint32_t RtcGetTimerElapsedTime( void )
 {
-    return 0;
+    return RtcTimerValue - RtcTimerContext.Time;
 #if 0
   RTC_TimeTypeDef time;
   RTC_DateTypeDef date;
@@ -329,6 +340,12 @@ uint32_t RtcGetTimerElapsedTime( void )
 #endif
 }
 
+void RtcSetVirtualTime( uint32_t timerValue, uint32_t timerContext )
+{
+    RtcTimerValue = timerValue;
+    RtcTimerContext.Time = timerContext;
+}
+
 void RtcSetMcuWakeUpTime( void )
 {
 #if 0
@@ -120,6 +120,17 @@ uint32_t RtcSetTimerContext( void );
  */
 uint32_t RtcGetTimerContext( void );
 
+/*!
+ * \brief Sets the virtual RTC of the hosted device
+ *
+ * \remark The simulated device has no RTC peripheral, the simulation drives
+ *         the counter. Also used to restore a device snapshot.
+ *
+ * \param [IN] timerValue   RTC counter value in ticks
+ * \param [IN] timerContext Timer reference value in ticks, see RtcSetTimerContext
+ */
+void RtcSetVirtualTime( uint32_t timerValue, uint32_t timerContext );
+
 /*!
  * \brief Gets the system time with the number of seconds elapsed since epoch
  *
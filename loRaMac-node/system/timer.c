@@ -363,6 +363,20 @@ TimerTime_t TimerGetElapsedTime( TimerTime_t past )
     return RtcTick2Ms( nowInTicks - pastInTicks );
 }
 
+TimerTime_t TimerGetNextDeadline( void )
+{
+    TimerTime_t deadline = TIMERTIME_T_MAX;
+
+    CRITICAL_SECTION_BEGIN( );
+    if( TimerListHead != NULL )
+    {
+        // Timestamps are relative to the timer context, see TimerStart
+        deadline = RtcTick2Ms( RtcGetTimerContext( ) + TimerListHead->Timestamp );
+    }
+    CRITICAL_SECTION_END( );
+    return deadline;
+}
+
 static void TimerSetTimeout( TimerEvent_t *obj )
 {
     int32_t minTicks= RtcGetMinimumTimeout( );
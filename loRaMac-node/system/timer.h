@@ -134,6 +134,13 @@ TimerTime_t TimerGetCurrentTime( void );
  */
 TimerTime_t TimerGetElapsedTime( TimerTime_t past );
 
+/*!
+ * \brief Gets the time at which the next running timer expires
+ *
+ * \retval time             Expiry time, TIMERTIME_T_MAX if no timer is running
+ */
+TimerTime_t TimerGetNextDeadline( void );
+
 /*!
  * \brief Computes the temperature compensation for a period of time on a
  *        specific temperature.
@@ -28,26 +28,111 @@
  * Redefinition of rand() and srand() standard C functions.
  * These functions are redefined in order to get the same behavior across
  * different compiler toolchains implementations.
+ *
+ * The generator is xoshiro128** and its state lives in a RandCtx_t owned by
+ * the caller ( one per simulated device ). rand1/srand1/randr operate on the
+ * context selected with RandSetCtx.
  */
 // Standard random functions redefinition start
 #define RAND_LOCAL_MAX 2147483647L
 
-static uint32_t next = 1;
+/*!
+ * Generator used until a device selects its own context
+ */
+static RandCtx_t DefaultRandCtx = RAND_CTX_INIT;
+
+/*!
+ * Generator used by rand1, srand1 and randr
+ */
+static _Thread_local RandCtx_t* CurrentRandCtx = &DefaultRandCtx;
+
+static inline uint32_t RotateLeft( uint32_t x, int k )
+{
+    return ( x << k ) | ( x >> ( 32 - k ) );
+}
+
+static uint64_t SplitMix64( uint64_t* x )
+{
+    uint64_t z = ( *x += 0x9E3779B97F4A7C15ULL );
+
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    return z ^ ( z >> 31 );
+}
+
+uint64_t RandDeriveSeed( uint64_t masterSeed, uint64_t streamId )
+{
+    uint64_t x = masterSeed;
+    uint64_t seed = SplitMix64( &x );
+
+    x = streamId ^ seed;
+    return seed ^ SplitMix64( &x );
+}
+
+void RandCtxSeed( RandCtx_t* ctx, uint64_t seed )
+{
+    uint64_t x = seed;
+    uint64_t z = SplitMix64( &x );
+
+    ctx->State[0] = ( uint32_t )z;
+    ctx->State[1] = ( uint32_t )( z >> 32 );
+    z = SplitMix64( &x );
+    ctx->State[2] = ( uint32_t )z;
+    ctx->State[3] = ( uint32_t )( z >> 32 );
+}
+
+uint32_t RandCtxNext( RandCtx_t* ctx )
+{
+    uint32_t* s = ctx->State;
+    uint32_t result = RotateLeft( s[1] * 5, 7 ) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = RotateLeft( s[3], 11 );
+
+    return result;
+}
+
+int32_t RandCtxRange( RandCtx_t* ctx, int32_t min, int32_t max )
+{
+    uint32_t span = ( uint32_t )( max - min ) + 1;
+
+    if( span == 0 )
+    { // Full 32 bits range
+        return ( int32_t )RandCtxNext( ctx );
+    }
+    // Multiply-shift maps the 32 bits output onto [0, span) without a division
+    return min + ( int32_t )( ( ( uint64_t )RandCtxNext( ctx ) * span ) >> 32 );
+}
+
+void RandSetCtx( RandCtx_t* ctx )
+{
+    CurrentRandCtx = ( ctx != NULL ) ? ctx : &DefaultRandCtx;
+}
+
+RandCtx_t* RandGetCtx( void )
+{
+    return CurrentRandCtx;
+}
 
 int32_t rand1( void )
 {
-    return ( ( next = next * 1103515245L + 12345L ) % RAND_LOCAL_MAX );
+    return ( int32_t )( ( RandCtxNext( CurrentRandCtx ) >> 1 ) % RAND_LOCAL_MAX );
 }
 
 void srand1( uint32_t seed )
 {
-    next = seed;
+    RandCtxSeed( CurrentRandCtx, seed );
 }
 // Standard random functions redefinition end
 
 int32_t randr( int32_t min, int32_t max )
 {
-    return ( int32_t )rand1( ) % ( max - min + 1 ) + min;
+    return RandCtxRange( CurrentRandCtx, min, max );
 }
 
 void memcpy1( uint8_t *dst, const uint8_t *src, uint16_t size )
@@ -86,6 +86,76 @@ typedef union Version_u
     uint32_t Value;
 }Version_t;
 
+/*!
+ * Pseudo random generator context (xoshiro128**)
+ *
+ * \remark The context is aligned on a cache line so that generators owned by
+ *         different devices never share one.
+ */
+typedef struct sRandCtx
+{
+    uint32_t State[4];
+}__attribute__( ( aligned( 64 ) ) ) RandCtx_t;
+
+/*!
+ * Static initializer of a pseudo random generator context ( seed 1 )
+ */
+#define RAND_CTX_INIT                               { { 0x89025CC1, 0x910A2DEC, 0x658EEC67, 0xBEEB8DA1 } }
+
+/*!
+ * \brief Derives a generator seed from a master seed and a stream identifier
+ *
+ * \remark Used to give every device its own reproducible sequence out of a
+ *         single simulation master seed.
+ *
+ * \param [IN] masterSeed Simulation master seed
+ * \param [IN] streamId   Stream identifier, e.g. the device EUI
+ * \retval seed           Derived seed
+ */
+uint64_t RandDeriveSeed( uint64_t masterSeed, uint64_t streamId );
+
+/*!
+ * \brief Seeds a pseudo random generator context
+ *
+ * \param [OUT] ctx  Generator context
+ * \param [IN]  seed Generator seed
+ */
+void RandCtxSeed( RandCtx_t* ctx, uint64_t seed );
+
+/*!
+ * \brief Computes the next 32 bits random value of the given generator
+ *
+ * \param [IN] ctx Generator context
+ * \retval random  32 bits random value
+ */
+uint32_t RandCtxNext( RandCtx_t* ctx );
+
+/*!
+ * \brief Computes a random number between min and max with the given generator
+ *
+ * \param [IN] ctx Generator context
+ * \param [IN] min range minimum value
+ * \param [IN] max range maximum value
+ * \retval random random value in range min..max
+ */
+int32_t RandCtxRange( RandCtx_t* ctx, int32_t min, int32_t max );
+
+/*!
+ * \brief Selects the generator used by srand1, rand1 and randr on the
+ *        calling thread
+ *
+ * \param [IN] ctx Generator context. NULL selects the module default one.
+ */
+void RandSetCtx( RandCtx_t* ctx );
+
+/*!
+ * \brief Returns the generator used by srand1, rand1 and randr on the
+ *        calling thread
+ *
+ * \retval ctx Generator context
+ */
+RandCtx_t* RandGetCtx( void );
+
 /*!
  * \brief Initializes the pseudo random generator initial value
  *